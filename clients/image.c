@@ -43,6 +43,38 @@
 
 #include "window.h"
 #include "shared/cairo-util.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "presentation-time-client-protocol.h"
+#include "viewporter-client-protocol.h"
+
+/* Larger images may not be importable as a single texture by the
+ * compositor's renderer, so they are split into tiles of at most this
+ * size, each shown by its own sub-surface. */
+#define IMAGE_MAX_TILE_SIZE 8192
+
+#define BENCHMARK_STEPS 120
+
+static bool option_benchmark;
+static bool option_help;
+
+struct viewer {
+	struct wp_viewporter *viewporter;
+	struct wp_presentation *presentation;
+	clockid_t clk_id;
+	int benchmarks_running;
+};
+
+struct image_tile {
+	struct image *image;
+	struct widget *widget;
+	struct wp_viewport *viewport;
+	cairo_surface_t *buffer;
+	bool attached;
+
+	/* The part of the image held by this tile, in image pixels */
+	int32_t x, y, width, height;
+};
 
 struct image {
 	struct window *window;
@@ -62,6 +94,25 @@ struct image {
 
 	bool initialized;
 	cairo_matrix_t matrix;
+
+	/* With wp_viewporter, the image is uploaded once into the buffers
+	 * of its tiles and zooming and panning only update their
+	 * viewports; otherwise it is repainted through cairo. */
+	struct viewer *viewer;
+	struct image_tile *tiles;
+	int n_tiles;
+	bool view_shown;
+	struct wl_callback *view_frame_cb;
+	bool view_dirty;
+
+	struct {
+		struct wp_presentation_feedback *feedback;
+		struct timespec commit;
+		int step;
+		int presented;
+		int discarded;
+		double min, max, sum;
+	} benchmark;
 };
 
 static double
@@ -112,7 +163,7 @@ redraw_handler(struct widget *widget, void *data)
 	struct rectangle allocation;
 	cairo_t *cr;
 	cairo_surface_t *surface;
-	double width, height, doc_aspect, window_aspect, scale;
+	double doc_aspect, window_aspect, scale;
 	cairo_matrix_t matrix;
 	cairo_matrix_t translate;
 
@@ -131,31 +182,31 @@ redraw_handler(struct widget *widget, void *data)
 
 	if (!image->initialized) {
 		image->initialized = true;
-		width = cairo_image_surface_get_width(image->image);
-		height = cairo_image_surface_get_height(image->image);
 
-		doc_aspect = width / height;
+		doc_aspect = (double) image->width / image->height;
 		window_aspect = (double) allocation.width / allocation.height;
 		if (doc_aspect < window_aspect)
-			scale = allocation.height / height;
+			scale = (double) allocation.height / image->height;
 		else
-			scale = allocation.width / width;
+			scale = (double) allocation.width / image->width;
 
-		image->width = width;
-		image->height = height;
 		cairo_matrix_init_scale(&image->matrix, scale, scale);
 
 		clamp_view(image);
 	}
 
-	matrix = image->matrix;
-	cairo_matrix_init_translate(&translate, allocation.x, allocation.y);
-	cairo_matrix_multiply(&matrix, &matrix, &translate);
-	cairo_set_matrix(cr, &matrix);
-
-	cairo_set_source_surface(cr, image->image, 0, 0);
-	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-	cairo_paint(cr);
+	/* Otherwise the image is shown by the sub-surfaces on top. */
+	if (!image->tiles) {
+		matrix = image->matrix;
+		cairo_matrix_init_translate(&translate,
+					    allocation.x, allocation.y);
+		cairo_matrix_multiply(&matrix, &matrix, &translate);
+		cairo_set_matrix(cr, &matrix);
+
+		cairo_set_source_surface(cr, image->image, 0, 0);
+		cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+		cairo_paint(cr);
+	}
 
 	cairo_pop_group_to_source(cr);
 	cairo_paint(cr);
@@ -169,8 +220,177 @@ resize_handler(struct widget *widget,
 	       int32_t width, int32_t height, void *data)
 {
 	struct image *image = data;
+	struct rectangle allocation;
+	int i;
 
 	clamp_view(image);
+
+	widget_get_allocation(image->widget, &allocation);
+	for (i = 0; i < image->n_tiles; i++)
+		widget_set_allocation(image->tiles[i].widget,
+				      allocation.x, allocation.y,
+				      allocation.width, allocation.height);
+}
+
+static void
+image_update_tile(struct image *image, struct image_tile *tile)
+{
+	struct rectangle allocation;
+	double scale = get_scale(image);
+	struct wl_surface *surface = widget_get_wl_surface(tile->widget);
+	struct wl_buffer *buffer;
+	wl_fixed_t src_x, src_y, src_w, src_h;
+	wl_fixed_t max_w, max_h;
+	int32_t x1, y1, x2, y2;
+
+	widget_get_allocation(image->widget, &allocation);
+
+	/* The part of the tile that is visible in the widget, snapped
+	 * to whole surface coordinates as the destination requires.
+	 * Neighbouring tiles snap their shared edge the same way, so
+	 * they meet without a gap. */
+	x1 = round(MAX(image->matrix.x0 + tile->x * scale, 0.0));
+	y1 = round(MAX(image->matrix.y0 + tile->y * scale, 0.0));
+	x2 = round(MIN(image->matrix.x0 + (tile->x + tile->width) * scale,
+		       (double) allocation.width));
+	y2 = round(MIN(image->matrix.y0 + (tile->y + tile->height) * scale,
+		       (double) allocation.height));
+
+	/* Sub-surfaces are not clipped to their parent, so a tile out of
+	 * view must be unmapped rather than just left where it is. */
+	if (x2 <= x1 || y2 <= y1) {
+		if (tile->attached) {
+			wl_surface_attach(surface, NULL, 0, 0);
+			tile->attached = false;
+		}
+		return;
+	}
+
+	if (!tile->attached) {
+		buffer = display_get_buffer_for_surface(image->display,
+							tile->buffer);
+		wl_surface_attach(surface, buffer, 0, 0);
+		wl_surface_damage(surface, 0, 0, INT32_MAX, INT32_MAX);
+		tile->attached = true;
+	}
+
+	src_x = wl_fixed_from_double((x1 - image->matrix.x0) / scale -
+				     tile->x);
+	src_y = wl_fixed_from_double((y1 - image->matrix.y0) / scale -
+				     tile->y);
+	src_w = wl_fixed_from_double((x2 - x1) / scale);
+	src_h = wl_fixed_from_double((y2 - y1) / scale);
+
+	/* Rounding must never push the source outside of the buffer,
+	 * the compositor treats that as a protocol error. */
+	max_w = wl_fixed_from_int(tile->width);
+	max_h = wl_fixed_from_int(tile->height);
+	src_x = MIN(MAX(src_x, 0), max_w - 1);
+	src_y = MIN(MAX(src_y, 0), max_h - 1);
+	src_w = MIN(MAX(src_w, 1), max_w - src_x);
+	src_h = MIN(MAX(src_h, 1), max_h - src_y);
+
+	wp_viewport_set_source(tile->viewport, src_x, src_y, src_w, src_h);
+	wp_viewport_set_destination(tile->viewport, x2 - x1, y2 - y1);
+	wl_subsurface_set_position(widget_get_wl_subsurface(tile->widget),
+				   allocation.x + x1, allocation.y + y1);
+}
+
+static void
+image_update_view(struct image *image)
+{
+	int i;
+
+	for (i = 0; i < image->n_tiles; i++)
+		image_update_tile(image, &image->tiles[i]);
+}
+
+static void
+image_commit_view(struct image *image)
+{
+	int i;
+
+	image_update_view(image);
+	for (i = 0; i < image->n_tiles; i++)
+		wl_surface_commit(widget_get_wl_surface(image->tiles[i].widget));
+
+	/* The sub-surfaces are synchronized and their positions are
+	 * parent state, so nothing shows up before the parent commits
+	 * too. */
+	wl_surface_commit(window_get_wl_surface(image->window));
+}
+
+static void
+image_schedule_view(struct image *image);
+
+static void
+view_frame_callback(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct image *image = data;
+
+	wl_callback_destroy(callback);
+	image->view_frame_cb = NULL;
+
+	if (image->view_dirty)
+		image_schedule_view(image);
+}
+
+static const struct wl_callback_listener view_frame_listener = {
+	view_frame_callback
+};
+
+static void
+image_schedule_view(struct image *image)
+{
+	struct wl_surface *surface;
+
+	if (!image->tiles) {
+		window_schedule_redraw(image->window);
+		return;
+	}
+
+	/* Until the first frame is up, view_redraw_handler() applies the
+	 * current matrix anyway. */
+	if (!image->view_shown)
+		return;
+
+	if (image->view_frame_cb) {
+		image->view_dirty = true;
+		return;
+	}
+
+	image->view_dirty = false;
+	/* Tiles out of view are unmapped and would never get a frame
+	 * callback, the parent always does. */
+	surface = window_get_wl_surface(image->window);
+	image->view_frame_cb = wl_surface_frame(surface);
+	wl_callback_add_listener(image->view_frame_cb,
+				 &view_frame_listener, image);
+	image_commit_view(image);
+}
+
+static void
+benchmark_request_feedback(struct image *image);
+
+static void
+view_redraw_handler(struct widget *widget, void *data)
+{
+	struct image_tile *tile = data;
+	struct image *image = tile->image;
+
+	if (!image->initialized)
+		return;
+
+	if (!image->view_shown) {
+		image->view_shown = true;
+
+		/* The benchmark starts once the first frame is shown. */
+		if (option_benchmark)
+			benchmark_request_feedback(image);
+	}
+
+	image_update_tile(image, tile);
+	wl_surface_commit(widget_get_wl_surface(widget));
 }
 
 static void
@@ -211,7 +431,7 @@ move_viewport(struct image *image, double dx, double dy)
 	cairo_matrix_translate(&image->matrix, -dx/scale, -dy/scale);
 	clamp_view(image);
 
-	window_schedule_redraw(image->window);
+	image_schedule_view(image);
 }
 
 static int
@@ -292,12 +512,12 @@ key_handler(struct window *window, struct input *input, uint32_t time,
 	switch (sym) {
 	case XKB_KEY_minus:
 		zoom(image, 0.8);
-		window_schedule_redraw(image->window);
+		image_schedule_view(image);
 		break;
 	case XKB_KEY_equal:
 	case XKB_KEY_plus:
 		zoom(image, 1.2);
-		window_schedule_redraw(image->window);
+		image_schedule_view(image);
 		break;
 	case XKB_KEY_1:
 		image->matrix.xx = 1.0;
@@ -305,7 +525,7 @@ key_handler(struct window *window, struct input *input, uint32_t time,
 		image->matrix.yx = 0.0;
 		image->matrix.yy = 1.0;
 		clamp_view(image);
-		window_schedule_redraw(image->window);
+		image_schedule_view(image);
 		break;
 	}
 }
@@ -321,7 +541,7 @@ axis_handler(struct widget *widget, struct input *input, uint32_t time,
 		/* set zoom level to 2% per 10 axis units */
 		zoom(image, (1.0 - wl_fixed_to_double(value) / 500.0));
 
-		window_schedule_redraw(image->window);
+		image_schedule_view(image);
 	} else if (input_get_modifiers(input) == 0) {
 		if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL)
 			move_viewport(image, 0, wl_fixed_to_double(value));
@@ -330,6 +550,127 @@ axis_handler(struct widget *widget, struct input *input, uint32_t time,
 	}
 }
 
+static void
+benchmark_report(struct image *image)
+{
+	if (image->benchmark.presented == 0) {
+		printf("%s: no zoom step was presented, %d discarded\n",
+		       image->filename, image->benchmark.discarded);
+		return;
+	}
+
+	printf("%s: %d zoom steps, commit-to-present latency "
+	       "min %.3f ms, avg %.3f ms, max %.3f ms, %d discarded\n",
+	       image->filename, image->benchmark.presented,
+	       image->benchmark.min,
+	       image->benchmark.sum / image->benchmark.presented,
+	       image->benchmark.max, image->benchmark.discarded);
+}
+
+static void
+benchmark_step(struct image *image)
+{
+	struct rectangle allocation;
+
+	if (image->benchmark.step == BENCHMARK_STEPS) {
+		benchmark_report(image);
+		if (--image->viewer->benchmarks_running == 0)
+			display_exit(image->display);
+		return;
+	}
+
+	/* Zoom in around the center, then back out again. */
+	widget_get_allocation(image->widget, &allocation);
+	image->pointer.x = allocation.width / 2.0;
+	image->pointer.y = allocation.height / 2.0;
+	if (image->benchmark.step < BENCHMARK_STEPS / 2)
+		zoom(image, 1.05);
+	else
+		zoom(image, 1.0 / 1.05);
+	image->benchmark.step++;
+
+	benchmark_request_feedback(image);
+	clock_gettime(image->viewer->clk_id, &image->benchmark.commit);
+	image_commit_view(image);
+}
+
+static void
+benchmark_sync_output(void *data,
+		      struct wp_presentation_feedback *feedback,
+		      struct wl_output *output)
+{
+}
+
+static void
+benchmark_presented(void *data,
+		    struct wp_presentation_feedback *feedback,
+		    uint32_t tv_sec_hi,
+		    uint32_t tv_sec_lo,
+		    uint32_t tv_nsec,
+		    uint32_t refresh_nsec,
+		    uint32_t seq_hi,
+		    uint32_t seq_lo,
+		    uint32_t flags)
+{
+	struct image *image = data;
+	struct timespec present;
+	double latency;
+
+	wp_presentation_feedback_destroy(feedback);
+	image->benchmark.feedback = NULL;
+
+	/* Step 0 is the initial frame, which only starts the run. */
+	if (image->benchmark.step > 0) {
+		timespec_from_proto(&present, tv_sec_hi, tv_sec_lo, tv_nsec);
+		latency = timespec_sub_to_nsec(&present,
+					       &image->benchmark.commit) / 1e6;
+
+		if (image->benchmark.presented == 0 ||
+		    latency < image->benchmark.min)
+			image->benchmark.min = latency;
+		if (image->benchmark.presented == 0 ||
+		    latency > image->benchmark.max)
+			image->benchmark.max = latency;
+		image->benchmark.sum += latency;
+		image->benchmark.presented++;
+	}
+
+	benchmark_step(image);
+}
+
+static void
+benchmark_discarded(void *data,
+		    struct wp_presentation_feedback *feedback)
+{
+	struct image *image = data;
+
+	wp_presentation_feedback_destroy(feedback);
+	image->benchmark.feedback = NULL;
+
+	if (image->benchmark.step > 0)
+		image->benchmark.discarded++;
+
+	benchmark_step(image);
+}
+
+static const struct wp_presentation_feedback_listener benchmark_feedback_listener = {
+	benchmark_sync_output,
+	benchmark_presented,
+	benchmark_discarded
+};
+
+static void
+benchmark_request_feedback(struct image *image)
+{
+	struct wl_surface *surface = window_get_wl_surface(image->window);
+
+	image->benchmark.feedback =
+		wp_presentation_feedback(image->viewer->presentation, surface);
+	wp_presentation_feedback_add_listener(image->benchmark.feedback,
+					      &benchmark_feedback_listener,
+					      image);
+}
+
 static void
 fullscreen_handler(struct window *window, void *data)
 {
@@ -343,21 +684,147 @@ static void
 close_handler(void *data)
 {
 	struct image *image = data;
+	struct image_tile *tile;
+	int i;
 
 	*image->image_counter -= 1;
 
 	if (*image->image_counter == 0)
 		display_exit(image->display);
 
+	if (image->benchmark.feedback)
+		wp_presentation_feedback_destroy(image->benchmark.feedback);
+	if (image->view_frame_cb)
+		wl_callback_destroy(image->view_frame_cb);
+	for (i = 0; i < image->n_tiles; i++) {
+		tile = &image->tiles[i];
+		wp_viewport_destroy(tile->viewport);
+		widget_destroy(tile->widget);
+	}
 	widget_destroy(image->widget);
 	window_destroy(image->window);
 
+	for (i = 0; i < image->n_tiles; i++)
+		cairo_surface_destroy(image->tiles[i].buffer);
+	free(image->tiles);
+	if (image->image)
+		cairo_surface_destroy(image->image);
+	free(image->filename);
 	free(image);
 }
 
+static bool
+image_create_tile_buffer(struct image *image, struct image_tile *tile)
+{
+	struct rectangle rectangle;
+	cairo_t *cr;
+
+	rectangle.x = 0;
+	rectangle.y = 0;
+	rectangle.width = tile->width;
+	rectangle.height = tile->height;
+
+	tile->buffer = display_create_surface(image->display, NULL,
+					      &rectangle, SURFACE_SHM);
+	if (!tile->buffer)
+		return false;
+
+	cr = cairo_create(tile->buffer);
+	cairo_set_source_surface(cr, image->image, -tile->x, -tile->y);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_surface_flush(tile->buffer);
+
+	return true;
+}
+
+static bool
+image_create_tiles(struct image *image)
+{
+	int columns, rows, i;
+	struct image_tile *tile;
+
+	columns = (image->width + IMAGE_MAX_TILE_SIZE - 1) /
+		  IMAGE_MAX_TILE_SIZE;
+	rows = (image->height + IMAGE_MAX_TILE_SIZE - 1) /
+	       IMAGE_MAX_TILE_SIZE;
+
+	image->tiles = zalloc(columns * rows * sizeof *image->tiles);
+	if (!image->tiles)
+		return false;
+
+	for (i = 0; i < columns * rows; i++) {
+		tile = &image->tiles[i];
+		tile->image = image;
+		tile->x = (i % columns) * IMAGE_MAX_TILE_SIZE;
+		tile->y = (i / columns) * IMAGE_MAX_TILE_SIZE;
+		tile->width = MIN(image->width - tile->x, IMAGE_MAX_TILE_SIZE);
+		tile->height = MIN(image->height - tile->y,
+				   IMAGE_MAX_TILE_SIZE);
+
+		if (!image_create_tile_buffer(image, tile))
+			goto err;
+	}
+
+	image->n_tiles = columns * rows;
+
+	return true;
+
+err:
+	while (i-- > 0)
+		cairo_surface_destroy(image->tiles[i].buffer);
+	free(image->tiles);
+	image->tiles = NULL;
+
+	return false;
+}
+
+static void
+image_create_view(struct image *image)
+{
+	struct wp_viewporter *viewporter = image->viewer->viewporter;
+	struct wl_compositor *compositor;
+	struct wl_region *region;
+	struct wl_surface *surface;
+	struct image_tile *tile;
+	int i;
+
+	if (!viewporter)
+		return;
+
+	if (!image_create_tiles(image))
+		return;
+
+	/* The decoded image is only needed for the cairo fallback. */
+	cairo_surface_destroy(image->image);
+	image->image = NULL;
+
+	/* Let all pointer input go to the main surface's widget. */
+	compositor = display_get_compositor(image->display);
+	region = wl_compositor_create_region(compositor);
+
+	for (i = 0; i < image->n_tiles; i++) {
+		tile = &image->tiles[i];
+		tile->widget = window_add_subsurface(image->window, tile,
+						     SUBSURFACE_SYNCHRONIZED);
+		widget_set_use_cairo(tile->widget, 0);
+		widget_set_redraw_handler(tile->widget, view_redraw_handler);
+
+		surface = widget_get_wl_surface(tile->widget);
+		tile->viewport = wp_viewporter_get_viewport(viewporter,
+							    surface);
+		wl_surface_set_input_region(surface, region);
+	}
+
+	wl_region_destroy(region);
+	if (option_benchmark)
+		image->viewer->benchmarks_running++;
+}
+
 static struct image *
-image_create(struct display *display, const char *filename,
-	     int *image_counter)
+image_create(struct display *display, struct viewer *viewer,
+	     const char *filename, int *image_counter)
 {
 	struct image *image;
 	char *b, *copy, title[512];
@@ -380,11 +847,15 @@ image_create(struct display *display, const char *filename,
 		return NULL;
 	}
 
+	image->width = cairo_image_surface_get_width(image->image);
+	image->height = cairo_image_surface_get_height(image->image);
+
 	image->window = window_create(display);
 	image->widget = window_frame_create(image->window, image);
 	window_set_title(image->window, title);
 	window_set_appid(image->window, "org.freedesktop.weston.wayland-image");
 	image->display = display;
+	image->viewer = viewer;
 	image->image_counter = image_counter;
 	*image_counter += 1;
 	image->initialized = false;
@@ -404,19 +875,68 @@ image_create(struct display *display, const char *filename,
 	window_set_key_handler(image->window, key_handler);
 	widget_schedule_resize(image->widget, 500, 400);
 
+	image_create_view(image);
+
 	return image;
 }
 
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct viewer *viewer = data;
+
+	viewer->clk_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+global_handler(struct display *display, uint32_t name,
+	       const char *interface, uint32_t version, void *data)
+{
+	struct viewer *viewer = data;
+
+	if (strcmp(interface, "wp_viewporter") == 0) {
+		viewer->viewporter = display_bind(display, name,
+						  &wp_viewporter_interface, 1);
+	} else if (strcmp(interface, "wp_presentation") == 0) {
+		viewer->presentation = display_bind(display, name,
+						    &wp_presentation_interface,
+						    1);
+		wp_presentation_add_listener(viewer->presentation,
+					     &presentation_listener, viewer);
+	}
+}
+
+static const struct weston_option image_options[] = {
+	{ WESTON_OPTION_BOOLEAN, "benchmark", 0, &option_benchmark },
+	{ WESTON_OPTION_BOOLEAN, "help", 'h', &option_help },
+};
+
+static void
+print_help(const char *argv0)
+{
+	printf("Usage: %s [options] image...\n"
+	       "  --benchmark\tzoom in and out and report the "
+	       "commit-to-present latency\n"
+	       "  -h, --help\tshow this help\n", argv0);
+}
+
 int
 main(int argc, char *argv[])
 {
+	struct viewer viewer = { .clk_id = CLOCK_MONOTONIC };
 	struct display *d;
 	int i;
 	int image_counter = 0;
 
-	if (argc <= 1 || argv[1][0]=='-') {
-		printf("Usage: %s image...\n", argv[0]);
-		return 1;
+	parse_options(image_options, ARRAY_LENGTH(image_options), &argc, argv);
+	if (option_help || argc <= 1 || argv[1][0]=='-') {
+		print_help(argv[0]);
+		return option_help ? 0 : 1;
 	}
 
 	d = display_create(&argc, argv);
@@ -426,12 +946,25 @@ main(int argc, char *argv[])
 		return -1;
 	}
 
+	display_set_user_data(d, &viewer);
+	display_set_global_handler(d, global_handler);
+
+	if (option_benchmark && (!viewer.viewporter || !viewer.presentation)) {
+		fprintf(stderr, "--benchmark needs wp_viewporter and "
+			"wp_presentation, ignoring it\n");
+		option_benchmark = false;
+	}
+
 	for (i = 1; i < argc; i++)
-		image_create(d, argv[i], &image_counter);
+		image_create(d, &viewer, argv[i], &image_counter);
 
 	if (image_counter > 0)
 		display_run(d);
 
+	if (viewer.presentation)
+		wp_presentation_destroy(viewer.presentation);
+	if (viewer.viewporter)
+		wp_viewporter_destroy(viewer.viewporter);
 	display_destroy(d);
 
 	return 0;
@@ -0,0 +1,969 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Plays back a session recorded with weston --record-session, typically
+ * against a headless weston, and reports how often the replayed clients
+ * got their frame callbacks, i.e. the repaint timings of the compositor
+ * under that workload.
+ *
+ * Every recorded client gets its own connection. Object ids are remapped,
+ * globals are bound by interface name, fds are recreated from their
+ * recorded contents and shm buffer contents are restored before every
+ * attach. Requests on objects created by the compositor cannot be
+ * replayed and are skipped.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <wayland-client.h>
+
+#include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/session-record.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+#include "single-pixel-buffer-v1-client-protocol.h"
+#include "viewporter-client-protocol.h"
+#include "xdg-output-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#define MAX_ARGS 20
+
+/* Globals that can be bound; everything else is created through them */
+static const struct wl_interface *known_globals[] = {
+	&wl_compositor_interface,
+	&wl_subcompositor_interface,
+	&wl_shm_interface,
+	&wl_seat_interface,
+	&wl_output_interface,
+	&wl_data_device_manager_interface,
+	&xdg_wm_base_interface,
+	&wp_viewporter_interface,
+	&wp_presentation_interface,
+	&wp_single_pixel_buffer_manager_v1_interface,
+	&zwp_linux_dmabuf_v1_interface,
+	&zxdg_output_manager_v1_interface,
+};
+
+struct replay_pool {
+	struct wl_list link;
+	int fd;
+	void *data;
+	size_t size;
+};
+
+struct replay_object {
+	struct wl_proxy *proxy;
+	const struct wl_interface *interface;
+
+	/* wl_shm_pool and wl_buffer objects */
+	struct replay_pool *pool;
+	int32_t offset;
+};
+
+struct replay_global {
+	struct wl_list link;
+	uint32_t name;
+	char *interface;
+	uint32_t version;
+	/* the global name this one stands in for, 0 if none yet */
+	uint32_t recorded_name;
+};
+
+struct replay;
+
+struct replay_client {
+	struct replay *replay;
+	struct wl_list link;
+	uint32_t number;
+
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_list global_list;	/* replay_global::link */
+	struct wl_list pool_list;	/* replay_pool::link */
+	struct wl_array objects;	/* replay_object, by recorded id */
+
+	bool has_frame;
+	struct timespec last_frame;
+};
+
+struct replay {
+	struct {
+		bool help;
+		bool fast;
+	} opt;
+
+	FILE *fp;
+	struct wl_array payload;
+	struct wl_list client_list;	/* replay_client::link */
+
+	bool started;
+	uint64_t first_record_nsec;
+	struct timespec start;
+
+	unsigned int n_requests;
+	unsigned int n_skipped;
+	struct wl_array frame_intervals;	/* uint64_t nsec */
+};
+
+struct payload_reader {
+	const char *p;
+	const char *end;
+};
+
+static bool
+read_u32(struct payload_reader *r, uint32_t *value)
+{
+	if (r->end - r->p < 4)
+		return false;
+
+	memcpy(value, r->p, 4);
+	r->p += 4;
+	return true;
+}
+
+static const void *
+read_bytes(struct payload_reader *r, uint32_t size)
+{
+	size_t padded = ((size_t)size + 3) & ~(size_t)3;
+	const void *data = r->p;
+
+	if ((size_t)(r->end - r->p) < padded)
+		return NULL;
+
+	r->p += padded;
+	return data;
+}
+
+static bool
+read_string(struct payload_reader *r, const char **str)
+{
+	uint32_t len;
+
+	if (!read_u32(r, &len))
+		return false;
+
+	if (len == 0) {
+		*str = NULL;
+		return true;
+	}
+
+	*str = read_bytes(r, len);
+	return *str && (*str)[len - 1] == '\0';
+}
+
+static struct replay_object *
+replay_client_get_object(struct replay_client *rc, uint32_t id, bool create)
+{
+	size_t count = rc->objects.size / sizeof(struct replay_object);
+	struct replay_object *objects;
+
+	if (id >= count) {
+		size_t grow = (id + 1 - count) * sizeof(struct replay_object);
+
+		if (!create || id >= 0xff000000)
+			return NULL;
+
+		memset(abort_oom_if_null(wl_array_add(&rc->objects, grow)),
+		       0, grow);
+	}
+
+	objects = rc->objects.data;
+	if (!create && !objects[id].proxy)
+		return NULL;
+
+	return &objects[id];
+}
+
+static void
+registry_handle_global(void *data, struct wl_registry *registry,
+		       uint32_t name, const char *interface, uint32_t version)
+{
+	struct replay_client *rc = data;
+	struct replay_global *global;
+
+	global = xzalloc(sizeof *global);
+	global->name = name;
+	global->interface = xstrdup(interface);
+	global->version = version;
+	wl_list_insert(rc->global_list.prev, &global->link);
+}
+
+static void
+registry_handle_global_remove(void *data, struct wl_registry *registry,
+			      uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	registry_handle_global,
+	registry_handle_global_remove
+};
+
+static struct replay_global *
+replay_client_map_global(struct replay_client *rc, uint32_t recorded_name,
+			 const char *interface)
+{
+	struct replay_global *global;
+	struct replay_global *unused = NULL;
+
+	wl_list_for_each(global, &rc->global_list, link) {
+		if (strcmp(global->interface, interface) != 0)
+			continue;
+		if (global->recorded_name == recorded_name)
+			return global;
+		if (!unused && global->recorded_name == 0)
+			unused = global;
+	}
+
+	if (unused)
+		unused->recorded_name = recorded_name;
+
+	return unused;
+}
+
+static const struct wl_interface *
+find_global_interface(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(known_globals); i++)
+		if (strcmp(known_globals[i]->name, name) == 0)
+			return known_globals[i];
+
+	return NULL;
+}
+
+/* Callbacks are destroyed on done, by which time the recorded id may
+ * already stand for a new object */
+static void
+replay_client_destroy_callback(struct replay_client *rc,
+			       struct wl_callback *callback)
+{
+	struct replay_object *obj;
+
+	wl_array_for_each(obj, &rc->objects) {
+		if (obj->proxy == (struct wl_proxy *) callback) {
+			obj->proxy = NULL;
+			break;
+		}
+	}
+	wl_callback_destroy(callback);
+}
+
+static void
+frame_callback_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct replay_client *rc = data;
+	struct replay *replay = rc->replay;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (rc->has_frame) {
+		uint64_t *interval;
+
+		interval = abort_oom_if_null(wl_array_add(&replay->frame_intervals,
+							  sizeof *interval));
+		*interval = timespec_sub_to_nsec(&now, &rc->last_frame);
+	}
+	rc->has_frame = true;
+	rc->last_frame = now;
+
+	replay_client_destroy_callback(rc, callback);
+}
+
+static const struct wl_callback_listener frame_callback_listener = {
+	frame_callback_done
+};
+
+static void
+other_callback_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct replay_client *rc = data;
+
+	replay_client_destroy_callback(rc, callback);
+}
+
+static const struct wl_callback_listener other_callback_listener = {
+	other_callback_done
+};
+
+static int
+create_fd(const void *data, int32_t size)
+{
+	void *map;
+	int fd;
+
+	if (size < 0)
+		return open("/dev/null", O_RDWR | O_CLOEXEC);
+
+	fd = os_create_anonymous_file(size);
+	if (fd < 0 || size == 0)
+		return fd;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+	memcpy(map, data, size);
+	munmap(map, size);
+
+	return fd;
+}
+
+static struct replay_pool *
+replay_pool_create(struct replay_client *rc, int fd, int32_t size)
+{
+	struct replay_pool *pool;
+
+	pool = xzalloc(sizeof *pool);
+	pool->fd = fd;
+	pool->size = size;
+	pool->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			  fd, 0);
+	if (pool->data == MAP_FAILED) {
+		pool->data = NULL;
+		pool->size = 0;
+	}
+	wl_list_insert(&rc->pool_list, &pool->link);
+
+	return pool;
+}
+
+static void
+replay_pool_resize(struct replay_pool *pool, int32_t size)
+{
+	if (pool->data)
+		munmap(pool->data, pool->size);
+
+	pool->data = NULL;
+	pool->size = 0;
+
+	if (ftruncate(pool->fd, size) < 0)
+		return;
+
+	pool->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			  pool->fd, 0);
+	if (pool->data == MAP_FAILED)
+		pool->data = NULL;
+	else
+		pool->size = size;
+}
+
+static void
+replay_pool_destroy(struct replay_pool *pool)
+{
+	if (pool->data)
+		munmap(pool->data, pool->size);
+	close(pool->fd);
+	wl_list_remove(&pool->link);
+	free(pool);
+}
+
+static struct replay_client *
+replay_find_client(struct replay *replay, uint32_t number)
+{
+	struct replay_client *rc;
+
+	wl_list_for_each(rc, &replay->client_list, link)
+		if (rc->number == number)
+			return rc;
+
+	return NULL;
+}
+
+static int
+replay_client_create(struct replay *replay, uint32_t number)
+{
+	struct replay_client *rc;
+	struct replay_object *display;
+
+	rc = xzalloc(sizeof *rc);
+	rc->replay = replay;
+	rc->number = number;
+	wl_list_init(&rc->global_list);
+	wl_list_init(&rc->pool_list);
+	wl_array_init(&rc->objects);
+
+	rc->display = wl_display_connect(NULL);
+	if (!rc->display) {
+		fprintf(stderr, "Error: could not connect to Wayland display: "
+			"%s\n", strerror(errno));
+		free(rc);
+		return -1;
+	}
+
+	display = replay_client_get_object(rc, 1, true);
+	display->proxy = (struct wl_proxy *) rc->display;
+	display->interface = &wl_display_interface;
+
+	wl_list_insert(replay->client_list.prev, &rc->link);
+
+	return 0;
+}
+
+static void
+replay_client_destroy(struct replay_client *rc)
+{
+	struct replay_object *obj;
+	struct replay_global *global, *gtmp;
+	struct replay_pool *pool, *ptmp;
+
+	wl_array_for_each(obj, &rc->objects) {
+		if (obj->proxy && obj->interface != &wl_display_interface)
+			wl_proxy_destroy(obj->proxy);
+	}
+	wl_array_release(&rc->objects);
+
+	wl_list_for_each_safe(global, gtmp, &rc->global_list, link) {
+		free(global->interface);
+		free(global);
+	}
+
+	wl_list_for_each_safe(pool, ptmp, &rc->pool_list, link)
+		replay_pool_destroy(pool);
+
+	wl_display_disconnect(rc->display);
+	wl_list_remove(&rc->link);
+	free(rc);
+}
+
+static void
+replay_object_created(struct replay_client *rc, struct replay_object *parent,
+		      const struct wl_message *message,
+		      union wl_argument *args, struct replay_object *obj)
+{
+	const struct wl_interface *parent_iface = parent->interface;
+
+	if (obj->interface == &wl_callback_interface) {
+		if (parent_iface == &wl_surface_interface &&
+		    strcmp(message->name, "frame") == 0)
+			wl_proxy_add_listener(obj->proxy,
+					      (void (**)(void))
+					      &frame_callback_listener, rc);
+		else
+			wl_proxy_add_listener(obj->proxy,
+					      (void (**)(void))
+					      &other_callback_listener, rc);
+	} else if (obj->interface == &wl_registry_interface && !rc->registry) {
+		rc->registry = (struct wl_registry *) obj->proxy;
+		wl_registry_add_listener(rc->registry, &registry_listener, rc);
+		wl_display_roundtrip(rc->display);
+	} else if (parent_iface == &wl_shm_interface) {
+		/* create_pool(new_id, fd, size), the pool keeps the fd */
+		obj->pool = replay_pool_create(rc, args[1].h, args[2].i);
+		args[1].h = -1;
+	} else if (parent_iface == &wl_shm_pool_interface) {
+		/* create_buffer(new_id, offset, ...) */
+		obj->pool = parent->pool;
+		obj->offset = args[1].i;
+	}
+}
+
+static bool
+replay_request(struct replay *replay, struct replay_client *rc,
+	       struct payload_reader *r)
+{
+	uint32_t object_id, opcode, n_args;
+	const char *interface_name;
+	struct replay_object *obj, *new_obj;
+	const struct wl_message *message;
+	const struct wl_interface *new_iface = NULL;
+	struct wl_array arrays[MAX_ARGS];
+	union wl_argument args[MAX_ARGS] = { 0 };
+	const char *signature;
+	struct wl_proxy *proxy;
+	uint32_t new_id = 0;
+	uint32_t new_version = 0;
+	uint32_t bind_name = 0;
+	int fds[MAX_ARGS];
+	int n_fds = 0;
+	bool ok = false;
+	uint32_t i;
+
+	if (!read_u32(r, &object_id) || !read_u32(r, &opcode) ||
+	    !read_string(r, &interface_name) || !interface_name ||
+	    !read_u32(r, &n_args) || n_args > MAX_ARGS)
+		return false;
+
+	replay->n_requests++;
+
+	obj = replay_client_get_object(rc, object_id, false);
+	if (!obj || strcmp(obj->interface->name, interface_name) != 0 ||
+	    opcode >= (uint32_t) obj->interface->method_count)
+		goto skip;
+
+	message = &obj->interface->methods[opcode];
+	signature = message->signature;
+	new_version = wl_proxy_get_version(obj->proxy);
+
+	for (i = 0; i < n_args; i++) {
+		uint32_t type, value, size;
+		struct replay_object *arg_obj;
+		const void *data;
+
+		while (*signature && strchr("iufsonah", *signature) == NULL)
+			signature++;
+
+		if (!read_u32(r, &type) || type != (uint32_t) *signature)
+			goto skip;
+		signature++;
+
+		switch (type) {
+		case 'i':
+		case 'u':
+		case 'f':
+			if (!read_u32(r, &value))
+				goto skip;
+			args[i].u = value;
+			break;
+		case 'n':
+			if (!read_u32(r, &new_id))
+				goto skip;
+			new_iface = message->types[i];
+			break;
+		case 'o':
+			if (!read_u32(r, &value))
+				goto skip;
+			if (value == 0)
+				break;
+			arg_obj = replay_client_get_object(rc, value, false);
+			if (!arg_obj)
+				goto skip;
+			args[i].o = (struct wl_object *) arg_obj->proxy;
+			break;
+		case 's':
+			if (!read_string(r, &args[i].s))
+				goto skip;
+			break;
+		case 'a':
+			if (!read_u32(r, &size) || !(data = read_bytes(r, size)))
+				goto skip;
+			arrays[i].size = size;
+			arrays[i].alloc = 0;
+			arrays[i].data = (void *) data;
+			args[i].a = &arrays[i];
+			break;
+		case 'h':
+			if (!read_u32(r, &size))
+				goto skip;
+			if ((int32_t) size < 0)
+				data = NULL;
+			else if (!(data = read_bytes(r, size)))
+				goto skip;
+			args[i].h = create_fd(data, size);
+			if (args[i].h < 0)
+				goto skip;
+			fds[n_fds++] = i;
+			break;
+		default:
+			goto skip;
+		}
+	}
+
+	/* wl_registry.bind(name, interface, version, new_id) */
+	if (obj->interface == &wl_registry_interface && new_id) {
+		struct replay_global *global;
+
+		new_iface = find_global_interface(args[1].s);
+		global = replay_client_map_global(rc, args[0].u, args[1].s);
+		if (!new_iface || !global)
+			goto skip;
+
+		bind_name = global->name;
+		args[0].u = bind_name;
+		new_version = MIN(args[2].u, global->version);
+		args[2].u = new_version;
+	}
+
+	if (obj->interface == &wl_shm_pool_interface &&
+	    strcmp(message->name, "resize") == 0 && obj->pool)
+		replay_pool_resize(obj->pool, args[0].i);
+
+	proxy = wl_proxy_marshal_array_flags(obj->proxy, opcode, new_iface,
+					     new_version, 0, args);
+
+	if (new_id && proxy) {
+		new_obj = replay_client_get_object(rc, new_id, true);
+		/* get_object may have moved the array */
+		obj = replay_client_get_object(rc, object_id, false);
+		new_obj->proxy = proxy;
+		new_obj->interface = new_iface;
+		new_obj->pool = NULL;
+		replay_object_created(rc, obj, message, args, new_obj);
+	}
+
+	ok = true;
+
+skip:
+	for (i = 0; i < (uint32_t) n_fds; i++)
+		if (args[fds[i]].h >= 0)
+			close(args[fds[i]].h);
+
+	if (!ok)
+		replay->n_skipped++;
+
+	/* a skipped request only leaves the payload partially read */
+	return true;
+}
+
+static bool
+replay_object_destroyed(struct replay_client *rc, struct payload_reader *r)
+{
+	struct replay_object *obj;
+	uint32_t id;
+
+	if (!read_u32(r, &id))
+		return false;
+
+	obj = replay_client_get_object(rc, id, false);
+	if (!obj || obj->interface == &wl_display_interface)
+		return true;
+
+	/* callbacks destroy themselves when done, which during a fast
+	 * replay may well be after the recorded destruction */
+	if (obj->interface == &wl_callback_interface)
+		return true;
+
+	if (obj->interface == &wl_registry_interface &&
+	    obj->proxy == (struct wl_proxy *) rc->registry)
+		rc->registry = NULL;
+
+	wl_proxy_destroy(obj->proxy);
+	obj->proxy = NULL;
+	obj->pool = NULL;
+
+	return true;
+}
+
+static bool
+replay_buffer_contents(struct replay_client *rc, struct payload_reader *r)
+{
+	struct replay_object *obj;
+	const void *data;
+	uint32_t id, size;
+
+	if (!read_u32(r, &id) || !read_u32(r, &size) ||
+	    !(data = read_bytes(r, size)))
+		return false;
+
+	obj = replay_client_get_object(rc, id, false);
+	if (!obj || !obj->pool || !obj->pool->data || obj->offset < 0 ||
+	    (size_t) obj->offset + size > obj->pool->size)
+		return true;
+
+	memcpy((char *) obj->pool->data + obj->offset, data, size);
+
+	return true;
+}
+
+/* Dispatch events on all connections until the deadline has passed */
+static int
+replay_dispatch_until(struct replay *replay, const struct timespec *deadline)
+{
+	struct pollfd pfds[64];
+	struct replay_client *clients[64];
+	struct replay_client *rc;
+	struct timespec now;
+	int64_t remaining;
+	int n, i;
+
+	do {
+		n = 0;
+		wl_list_for_each(rc, &replay->client_list, link) {
+			if (wl_display_flush(rc->display) < 0 &&
+			    errno != EAGAIN)
+				return -1;
+
+			while (wl_display_prepare_read(rc->display) != 0)
+				wl_display_dispatch_pending(rc->display);
+
+			if (n == ARRAY_LENGTH(pfds)) {
+				wl_display_cancel_read(rc->display);
+				continue;
+			}
+
+			clients[n] = rc;
+			pfds[n].fd = wl_display_get_fd(rc->display);
+			pfds[n].events = POLLIN;
+			pfds[n].revents = 0;
+			n++;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining = timespec_sub_to_nsec(deadline, &now);
+		if (remaining < 0)
+			remaining = 0;
+
+		poll(pfds, n, (remaining + 999999) / 1000000);
+
+		for (i = 0; i < n; i++) {
+			rc = clients[i];
+			if (pfds[i].revents & POLLIN)
+				wl_display_read_events(rc->display);
+			else
+				wl_display_cancel_read(rc->display);
+
+			if (wl_display_dispatch_pending(rc->display) < 0)
+				return -1;
+		}
+	} while (remaining > 0);
+
+	return 0;
+}
+
+static int
+replay_run(struct replay *replay)
+{
+	struct session_record_header header;
+	struct replay_client *rc;
+	struct payload_reader r;
+	struct timespec deadline;
+	bool ok;
+
+	while (fread(&header, sizeof header, 1, replay->fp) == 1) {
+		replay->payload.size = 0;
+		if (header.size > 0) {
+			if (!wl_array_add(&replay->payload, header.size) ||
+			    fread(replay->payload.data, header.size, 1,
+				  replay->fp) != 1)
+				goto truncated;
+		}
+		r.p = replay->payload.data;
+		r.end = r.p + header.size;
+
+		if (!replay->started) {
+			replay->started = true;
+			replay->first_record_nsec = header.time_nsec;
+			clock_gettime(CLOCK_MONOTONIC, &replay->start);
+		}
+
+		if (replay->opt.fast)
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+		else
+			timespec_add_nsec(&deadline, &replay->start,
+					  header.time_nsec -
+					  replay->first_record_nsec);
+
+		if (replay_dispatch_until(replay, &deadline) < 0) {
+			fprintf(stderr, "Error: lost connection to the "
+				"compositor\n");
+			return -1;
+		}
+
+		if (header.type == SESSION_RECORD_CLIENT_CREATED) {
+			if (replay_client_create(replay, header.client) < 0)
+				return -1;
+			continue;
+		}
+
+		rc = replay_find_client(replay, header.client);
+		if (!rc)
+			continue;
+
+		switch (header.type) {
+		case SESSION_RECORD_CLIENT_DESTROYED:
+			replay_client_destroy(rc);
+			ok = true;
+			break;
+		case SESSION_RECORD_REQUEST:
+			ok = replay_request(replay, rc, &r);
+			break;
+		case SESSION_RECORD_OBJECT_DESTROYED:
+			ok = replay_object_destroyed(rc, &r);
+			break;
+		case SESSION_RECORD_BUFFER_CONTENTS:
+			ok = replay_buffer_contents(rc, &r);
+			break;
+		default:
+			ok = true;
+			break;
+		}
+
+		if (!ok)
+			goto truncated;
+	}
+
+	if (!feof(replay->fp))
+		goto truncated;
+
+	wl_list_for_each(rc, &replay->client_list, link)
+		wl_display_roundtrip(rc->display);
+
+	return 0;
+
+truncated:
+	fprintf(stderr, "Error: recording is truncated or corrupt\n");
+	return -1;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+print_results(struct replay *replay)
+{
+	uint64_t *intervals = replay->frame_intervals.data;
+	size_t n = replay->frame_intervals.size / sizeof *intervals;
+	struct timespec now;
+	uint64_t sum = 0;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	printf("replayed %u requests (%u skipped) in %.3f s\n",
+	       replay->n_requests, replay->n_skipped,
+	       timespec_sub_to_nsec(&now, &replay->start) / 1e9);
+
+	if (n == 0) {
+		printf("no frame callbacks completed\n");
+		return;
+	}
+
+	qsort(intervals, n, sizeof *intervals, compare_u64);
+	for (i = 0; i < n; i++)
+		sum += intervals[i];
+
+	printf("frame callback intervals over %zu frames (ms): "
+	       "min %.3f, mean %.3f, median %.3f, p99 %.3f, max %.3f\n",
+	       n, intervals[0] / 1e6, sum / (double) n / 1e6,
+	       intervals[n / 2] / 1e6, intervals[(n * 99) / 100] / 1e6,
+	       intervals[n - 1] / 1e6);
+}
+
+static void
+print_help(void)
+{
+	fprintf(stderr,
+		"Usage: weston-session-replay [options] FILE\n"
+		"Plays back a session recorded with weston --record-session.\n"
+		"Where options may be:\n"
+		"  -h, --help\n"
+		"     This help text, and exit with success.\n"
+		"  -f, --fast\n"
+		"     Send requests as fast as possible instead of at the\n"
+		"     recorded pace.\n"
+		);
+}
+
+static int
+parse_cmdline(struct replay *replay, int argc, char **argv)
+{
+	static const struct option opts[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "fast", no_argument, NULL, 'f' },
+		{ 0 }
+	};
+	static const char optstr[] = "hf";
+	int c;
+
+	while ((c = getopt_long(argc, argv, optstr, opts, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			replay->opt.help = true;
+			break;
+		case 'f':
+			replay->opt.fast = true;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	return optind;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct session_record_file_header header;
+	struct replay replay = {};
+	struct replay_client *rc, *tmp;
+	int ret = 1;
+	int arg;
+
+	wl_list_init(&replay.client_list);
+	wl_array_init(&replay.payload);
+	wl_array_init(&replay.frame_intervals);
+
+	arg = parse_cmdline(&replay, argc, argv);
+	if (arg < 0 || replay.opt.help || arg != argc - 1) {
+		print_help();
+		return replay.opt.help ? 0 : 1;
+	}
+
+	replay.fp = fopen(argv[arg], "re");
+	if (!replay.fp) {
+		fprintf(stderr, "Error: cannot open %s: %s\n",
+			argv[arg], strerror(errno));
+		return 1;
+	}
+
+	if (fread(&header, sizeof header, 1, replay.fp) != 1 ||
+	    memcmp(header.magic, SESSION_RECORD_MAGIC,
+		   sizeof header.magic) != 0 ||
+	    header.version != SESSION_RECORD_VERSION) {
+		fprintf(stderr, "Error: %s is not a session recording\n",
+			argv[arg]);
+		goto out;
+	}
+
+	if (replay_run(&replay) == 0) {
+		print_results(&replay);
+		ret = 0;
+	}
+
+out:
+	wl_list_for_each_safe(rc, tmp, &replay.client_list, link)
+		replay_client_destroy(rc);
+	wl_array_release(&replay.payload);
+	wl_array_release(&replay.frame_intervals);
+	fclose(replay.fp);
+
+	return ret;
+}
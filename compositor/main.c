@@ -711,6 +711,8 @@ usage(int error_code)
 		"  -f, --flight-rec-scopes=SCOPE\n\t\t\tSpecify log scopes to "
 			"subscribe to.\n\t\t\tCan specify multiple scopes, "
 			"each followed by comma\n"
+		"  --record-session=FILE\tRecord all client requests to FILE,\n"
+			"\t\t\tfor playback with weston-session-replay\n"
 		"  -h, --help\t\tThis help message\n\n");
 
 #if defined(BUILD_DRM_COMPOSITOR)
@@ -737,6 +739,9 @@ usage(int error_code)
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (deprecated alias for --renderer=pixman)\n"
 		"  --use-gl\t\tUse the GL renderer (deprecated alias for --renderer=gl)\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
+		"  --output-count=COUNT\tCreate multiple outputs\n"
+		"  --virtual-clock=MODE\tPace frames by a virtual clock, MODE is one of:\n"
+		"\tauto (run as fast as possible), manual (test suite control)\n"
 		"\n");
 #endif
 
@@ -3076,8 +3081,11 @@ load_headless_backend(struct weston_compositor *c,
 	bool force_pixman;
 	bool force_gl;
 	bool no_outputs = false;
+	int output_count = 1;
 	int ret = 0;
+	int i;
 	char *transform = NULL;
+	char *virtual_clock = NULL;
 
 	struct wet_output_config *parsed_options = wet_init_parsed_options(c);
 	if (!parsed_options)
@@ -3099,6 +3107,8 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &force_gl },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
+		{ WESTON_OPTION_INTEGER, "output-count", 0, &output_count },
+		{ WESTON_OPTION_STRING, "virtual-clock", 0, &virtual_clock },
 	};
 
 	parse_options(options, ARRAY_LENGTH(options), argc, argv);
@@ -3123,6 +3133,20 @@ load_headless_backend(struct weston_compositor *c,
 		free(transform);
 	}
 
+	if (virtual_clock) {
+		if (strcmp(virtual_clock, "auto") == 0) {
+			config.virtual_clock = WESTON_VIRTUAL_CLOCK_AUTO;
+		} else if (strcmp(virtual_clock, "manual") == 0) {
+			config.virtual_clock = WESTON_VIRTUAL_CLOCK_MANUAL;
+		} else {
+			weston_log("Invalid virtual clock mode \"%s\"\n",
+				   virtual_clock);
+			free(virtual_clock);
+			return -1;
+		}
+		free(virtual_clock);
+	}
+
 	config.base.struct_version = WESTON_HEADLESS_BACKEND_CONFIG_VERSION;
 	config.base.struct_size = sizeof(struct weston_headless_backend_config);
 
@@ -3145,6 +3169,14 @@ load_headless_backend(struct weston_compositor *c,
 
 		if (api->create_head(c->backend, "headless") < 0)
 			return -1;
+
+		for (i = 1; i < output_count; i++) {
+			char name[32];
+
+			snprintf(name, sizeof name, "headless-%d", i);
+			if (api->create_head(c->backend, name) < 0)
+				return -1;
+		}
 	}
 
 	return 0;
@@ -3955,6 +3987,8 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	char *option_modules = NULL;
 	char *log = NULL;
 	char *log_scopes = NULL;
+	char *record_session = NULL;
+	struct session_recorder *session_recorder = NULL;
 	char *flight_rec_scopes = NULL;
 	char *server_socket = NULL;
 	int32_t idle_time = -1;
@@ -3999,6 +4033,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 		{ WESTON_OPTION_BOOLEAN, "debug", 0, &debug_protocol },
 		{ WESTON_OPTION_STRING, "logger-scopes", 'l', &log_scopes },
 		{ WESTON_OPTION_STRING, "flight-rec-scopes", 'f', &flight_rec_scopes },
+		{ WESTON_OPTION_STRING, "record-session", 0, &record_session },
 	};
 
 	wl_list_init(&wet.layoutput_list);
@@ -4143,6 +4178,13 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	protologger = wl_display_add_protocol_logger(display,
 						     protocol_log_fn,
 						     NULL);
+
+	if (record_session) {
+		session_recorder = wet_session_recorder_create(display,
+							       record_session);
+		if (!session_recorder)
+			goto out;
+	}
 	if (debug_protocol) {
 		weston_compositor_enable_debug_protocol(wet.compositor);
 		weston_compositor_add_screenshot_authority(wet.compositor,
@@ -4282,6 +4324,9 @@ out:
 	if (protologger)
 		wl_protocol_logger_destroy(protologger);
 
+	if (session_recorder)
+		wet_session_recorder_destroy(session_recorder);
+
 	weston_compositor_destroy(wet.compositor);
 	wet_compositor_destroy_layout(&wet);
 	weston_log_scope_destroy(protocol_scope);
@@ -4313,6 +4358,7 @@ out_display:
 	free(option_modules);
 	free(log);
 	free(log_scopes);
+	free(record_session);
 	free(modules);
 
 	return ret;
@@ -0,0 +1,492 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libweston/libweston.h>
+#include "weston-private.h"
+#include "shared/helpers.h"
+#include "shared/session-record.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+
+/*
+ * Records every request sent by every client, together with the contents
+ * of the fds they pass and of the shm buffers they attach, so that the
+ * session can be played back later with weston-session-replay. See
+ * shared/session-record.h for the file format.
+ */
+
+struct session_recorder {
+	struct wl_display *display;
+	FILE *fp;
+	bool failed;
+
+	struct wl_protocol_logger *logger;
+	struct wl_listener client_created_listener;
+
+	uint32_t next_client;
+	struct wl_list client_list;	/* recorded_client::link */
+	struct wl_list resource_list;	/* recorded_resource::link */
+
+	/* payload of the record being built */
+	struct wl_array record;
+};
+
+struct recorded_client {
+	struct session_recorder *recorder;
+	struct wl_list link;
+	uint32_t number;
+
+	struct wl_listener destroy_listener;
+	struct wl_listener resource_created_listener;
+};
+
+/* Resources are destroyed after their client's destroy signal, so these
+ * carry the client number rather than a recorded_client pointer. */
+struct recorded_resource {
+	struct session_recorder *recorder;
+	struct wl_list link;
+	uint32_t client;
+	uint32_t id;
+
+	struct wl_listener destroy_listener;
+};
+
+static void
+record_add_u32(struct session_recorder *recorder, uint32_t value)
+{
+	uint32_t *p;
+
+	p = wl_array_add(&recorder->record, sizeof *p);
+	if (p)
+		*p = value;
+	else
+		recorder->failed = true;
+}
+
+static void
+record_add_bytes(struct session_recorder *recorder,
+		 const void *data, size_t size)
+{
+	size_t padded = (size + 3) & ~(size_t)3;
+	char *p;
+
+	p = wl_array_add(&recorder->record, padded);
+	if (!p) {
+		recorder->failed = true;
+		return;
+	}
+
+	memcpy(p, data, size);
+	memset(p + size, 0, padded - size);
+}
+
+static void
+record_add_string(struct session_recorder *recorder, const char *str)
+{
+	size_t len;
+
+	if (!str) {
+		record_add_u32(recorder, 0);
+		return;
+	}
+
+	len = strlen(str) + 1;
+	record_add_u32(recorder, len);
+	record_add_bytes(recorder, str, len);
+}
+
+/* Snapshot whatever the fd refers to: shm pools, keymaps, dmabufs which
+ * can be mapped by the CPU. Pipes and sockets cannot be replayed and are
+ * recorded with size -1. */
+static void
+record_add_fd(struct session_recorder *recorder, int fd)
+{
+	struct stat st;
+	off_t size = -1;
+	void *data;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		size = st.st_size;
+	} else {
+		/* dmabufs report their size through lseek; restore the
+		 * offset, the file description is shared with the client */
+		off_t cur = lseek(fd, 0, SEEK_CUR);
+
+		if (cur >= 0) {
+			size = lseek(fd, 0, SEEK_END);
+			lseek(fd, cur, SEEK_SET);
+		}
+	}
+
+	if (size < 0 || size > INT32_MAX) {
+		record_add_u32(recorder, (uint32_t)-1);
+		return;
+	}
+
+	if (size == 0) {
+		record_add_u32(recorder, 0);
+		return;
+	}
+
+	data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		record_add_u32(recorder, (uint32_t)-1);
+		return;
+	}
+
+	record_add_u32(recorder, size);
+	record_add_bytes(recorder, data, size);
+	munmap(data, size);
+}
+
+static void
+record_write(struct session_recorder *recorder,
+	     enum session_record_type type, uint32_t client)
+{
+	struct session_record_header header = { 0 };
+	struct timespec now;
+
+	if (recorder->failed)
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	header.type = type;
+	header.client = client;
+	header.time_nsec = timespec_to_nsec(&now);
+	header.size = recorder->record.size;
+
+	if (fwrite(&header, sizeof header, 1, recorder->fp) != 1 ||
+	    (header.size > 0 &&
+	     fwrite(recorder->record.data, header.size, 1,
+		    recorder->fp) != 1)) {
+		weston_log("session recorder: write failed: %s, "
+			   "recording stopped\n", strerror(errno));
+		recorder->failed = true;
+	}
+
+out:
+	recorder->record.size = 0;
+}
+
+static const char *
+next_argument_type(const char *signature, char *type)
+{
+	for (; *signature; ++signature) {
+		switch (*signature) {
+		case 'i':
+		case 'u':
+		case 'f':
+		case 's':
+		case 'o':
+		case 'n':
+		case 'a':
+		case 'h':
+			*type = *signature;
+			return signature + 1;
+		}
+	}
+	*type = '\0';
+	return signature;
+}
+
+static struct recorded_client *
+recorded_client_get(struct wl_client *client);
+
+static void
+record_buffer_contents(struct session_recorder *recorder,
+		       struct recorded_client *rc,
+		       struct wl_resource *buffer_resource)
+{
+	struct wl_shm_buffer *shm;
+	uint32_t size;
+
+	shm = wl_shm_buffer_get(buffer_resource);
+	if (!shm)
+		return;
+
+	size = wl_shm_buffer_get_stride(shm) * wl_shm_buffer_get_height(shm);
+
+	record_add_u32(recorder, wl_resource_get_id(buffer_resource));
+	record_add_u32(recorder, size);
+	wl_shm_buffer_begin_access(shm);
+	record_add_bytes(recorder, wl_shm_buffer_get_data(shm), size);
+	wl_shm_buffer_end_access(shm);
+
+	record_write(recorder, SESSION_RECORD_BUFFER_CONTENTS, rc->number);
+}
+
+static void
+session_recorder_log(void *user_data,
+		     enum wl_protocol_logger_type direction,
+		     const struct wl_protocol_logger_message *message)
+{
+	struct session_recorder *recorder = user_data;
+	struct wl_resource *res = message->resource;
+	const char *signature = message->message->signature;
+	struct recorded_client *rc;
+	struct wl_resource *obj;
+	int i;
+	char type;
+
+	if (direction != WL_PROTOCOL_LOGGER_REQUEST || recorder->failed)
+		return;
+
+	rc = recorded_client_get(wl_resource_get_client(res));
+	if (!rc)
+		return;
+
+	if (strcmp(wl_resource_get_class(res), "wl_surface") == 0 &&
+	    strcmp(message->message->name, "attach") == 0 &&
+	    message->arguments[0].o)
+		record_buffer_contents(recorder, rc,
+				       (struct wl_resource *)
+				       message->arguments[0].o);
+
+	record_add_u32(recorder, wl_resource_get_id(res));
+	record_add_u32(recorder, message->message_opcode);
+	record_add_string(recorder, wl_resource_get_class(res));
+	record_add_u32(recorder, message->arguments_count);
+
+	for (i = 0; i < message->arguments_count; i++) {
+		signature = next_argument_type(signature, &type);
+		record_add_u32(recorder, type);
+
+		switch (type) {
+		case 'i':
+		case 'u':
+		case 'f':
+			record_add_u32(recorder, message->arguments[i].u);
+			break;
+		case 'n':
+			record_add_u32(recorder, message->arguments[i].n);
+			break;
+		case 'o':
+			obj = (struct wl_resource *) message->arguments[i].o;
+			record_add_u32(recorder,
+				       obj ? wl_resource_get_id(obj) : 0);
+			break;
+		case 's':
+			record_add_string(recorder, message->arguments[i].s);
+			break;
+		case 'a':
+			record_add_u32(recorder, message->arguments[i].a->size);
+			record_add_bytes(recorder,
+					 message->arguments[i].a->data,
+					 message->arguments[i].a->size);
+			break;
+		case 'h':
+			record_add_fd(recorder, message->arguments[i].h);
+			break;
+		}
+	}
+
+	record_write(recorder, SESSION_RECORD_REQUEST, rc->number);
+}
+
+static void
+recorded_resource_destroy(struct recorded_resource *rr)
+{
+	wl_list_remove(&rr->destroy_listener.link);
+	wl_list_remove(&rr->link);
+	free(rr);
+}
+
+static void
+recorded_resource_handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct recorded_resource *rr =
+		container_of(listener, struct recorded_resource,
+			     destroy_listener);
+	struct session_recorder *recorder = rr->recorder;
+
+	record_add_u32(recorder, rr->id);
+	record_write(recorder, SESSION_RECORD_OBJECT_DESTROYED, rr->client);
+
+	recorded_resource_destroy(rr);
+}
+
+static void
+recorded_client_handle_resource_created(struct wl_listener *listener,
+					void *data)
+{
+	struct recorded_client *rc =
+		container_of(listener, struct recorded_client,
+			     resource_created_listener);
+	struct wl_resource *resource = data;
+	struct recorded_resource *rr;
+
+	rr = xzalloc(sizeof *rr);
+	rr->recorder = rc->recorder;
+	rr->client = rc->number;
+	rr->id = wl_resource_get_id(resource);
+	rr->destroy_listener.notify = recorded_resource_handle_destroy;
+	wl_resource_add_destroy_listener(resource, &rr->destroy_listener);
+	wl_list_insert(&rc->recorder->resource_list, &rr->link);
+}
+
+static void
+recorded_client_destroy(struct recorded_client *rc)
+{
+	wl_list_remove(&rc->destroy_listener.link);
+	wl_list_remove(&rc->resource_created_listener.link);
+	wl_list_remove(&rc->link);
+	free(rc);
+}
+
+static void
+recorded_client_handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct recorded_client *rc =
+		container_of(listener, struct recorded_client,
+			     destroy_listener);
+	struct session_recorder *recorder = rc->recorder;
+
+	record_write(recorder, SESSION_RECORD_CLIENT_DESTROYED, rc->number);
+	fflush(recorder->fp);
+
+	recorded_client_destroy(rc);
+}
+
+static struct recorded_client *
+recorded_client_get(struct wl_client *client)
+{
+	struct wl_listener *listener;
+
+	listener = wl_client_get_destroy_listener(client,
+						  recorded_client_handle_destroy);
+	if (!listener)
+		return NULL;
+
+	return container_of(listener, struct recorded_client,
+			    destroy_listener);
+}
+
+static void
+session_recorder_handle_client_created(struct wl_listener *listener,
+				       void *data)
+{
+	struct session_recorder *recorder =
+		container_of(listener, struct session_recorder,
+			     client_created_listener);
+	struct wl_client *client = data;
+	struct recorded_client *rc;
+
+	rc = xzalloc(sizeof *rc);
+	rc->recorder = recorder;
+	rc->number = ++recorder->next_client;
+	rc->destroy_listener.notify = recorded_client_handle_destroy;
+	wl_client_add_destroy_listener(client, &rc->destroy_listener);
+	rc->resource_created_listener.notify =
+		recorded_client_handle_resource_created;
+	wl_client_add_resource_created_listener(client,
+						&rc->resource_created_listener);
+	wl_list_insert(&recorder->client_list, &rc->link);
+
+	record_write(recorder, SESSION_RECORD_CLIENT_CREATED, rc->number);
+}
+
+/** Start recording all client requests to a file
+ *
+ * \param display The display whose clients to record.
+ * \param path The file to write the recording to, truncated if it exists.
+ * \return The recorder, or NULL if the file could not be opened.
+ *
+ * Only clients connecting after this call are recorded.
+ */
+struct session_recorder *
+wet_session_recorder_create(struct wl_display *display, const char *path)
+{
+	struct session_recorder *recorder;
+	struct session_record_file_header header = { 0 };
+
+	recorder = xzalloc(sizeof *recorder);
+	recorder->display = display;
+	wl_list_init(&recorder->client_list);
+	wl_list_init(&recorder->resource_list);
+	wl_array_init(&recorder->record);
+
+	recorder->fp = fopen(path, "we");
+	if (!recorder->fp) {
+		weston_log("session recorder: cannot open %s: %s\n",
+			   path, strerror(errno));
+		free(recorder);
+		return NULL;
+	}
+
+	memcpy(header.magic, SESSION_RECORD_MAGIC, sizeof header.magic);
+	header.version = SESSION_RECORD_VERSION;
+	if (fwrite(&header, sizeof header, 1, recorder->fp) != 1) {
+		weston_log("session recorder: cannot write %s: %s\n",
+			   path, strerror(errno));
+		fclose(recorder->fp);
+		free(recorder);
+		return NULL;
+	}
+
+	recorder->logger = wl_display_add_protocol_logger(display,
+							  session_recorder_log,
+							  recorder);
+	recorder->client_created_listener.notify =
+		session_recorder_handle_client_created;
+	wl_display_add_client_created_listener(display,
+					       &recorder->client_created_listener);
+
+	weston_log("Recording client session to %s\n", path);
+
+	return recorder;
+}
+
+void
+wet_session_recorder_destroy(struct session_recorder *recorder)
+{
+	struct recorded_resource *rr, *rr_tmp;
+	struct recorded_client *rc, *rc_tmp;
+
+	wl_protocol_logger_destroy(recorder->logger);
+	wl_list_remove(&recorder->client_created_listener.link);
+
+	wl_list_for_each_safe(rr, rr_tmp, &recorder->resource_list, link)
+		recorded_resource_destroy(rr);
+
+	wl_list_for_each_safe(rc, rc_tmp, &recorder->client_list, link)
+		recorded_client_destroy(rc);
+
+	fclose(recorder->fp);
+	wl_array_release(&recorder->record);
+	free(recorder);
+}
@@ -46,6 +46,17 @@ struct input_method;
 struct input_method_context;
 struct text_backend;
 
+/* Text input state that is only forwarded to input methods on commit */
+struct text_input_state {
+	char *surrounding_text;	/* NULL until set */
+	uint32_t cursor;
+	uint32_t anchor;
+
+	bool has_content_type;
+	uint32_t hint;
+	uint32_t purpose;
+};
+
 struct text_input {
 	struct wl_resource *resource;
 
@@ -57,6 +68,9 @@ struct text_input {
 
 	pixman_box32_t cursor_rectangle;
 
+	/* as last set by the client */
+	struct text_input_state state;
+
 	bool input_panel_visible;
 
 	struct text_input_manager *manager;
@@ -97,6 +111,9 @@ struct input_method_context {
 	struct input_method *input_method;
 
 	struct wl_resource *keyboard;
+
+	/* as last forwarded to the input method */
+	struct text_input_state sent;
 };
 
 struct text_backend {
@@ -124,6 +141,46 @@ input_method_context_end_keyboard_grab(struct input_method_context *context);
 static void
 input_method_init_seat(struct weston_seat *seat);
 
+static void
+text_input_state_fini(struct text_input_state *state)
+{
+	free(state->surrounding_text);
+	memset(state, 0, sizeof *state);
+}
+
+/* Forward only what changed since the input method last heard of it */
+static void
+input_method_context_send_state(struct input_method_context *context,
+				const struct text_input_state *state)
+{
+	struct text_input_state *sent = &context->sent;
+
+	if (state->surrounding_text &&
+	    (!sent->surrounding_text ||
+	     strcmp(state->surrounding_text, sent->surrounding_text) != 0 ||
+	     state->cursor != sent->cursor ||
+	     state->anchor != sent->anchor)) {
+		zwp_input_method_context_v1_send_surrounding_text(
+			context->resource, state->surrounding_text,
+			state->cursor, state->anchor);
+		free(sent->surrounding_text);
+		sent->surrounding_text = xstrdup(state->surrounding_text);
+		sent->cursor = state->cursor;
+		sent->anchor = state->anchor;
+	}
+
+	if (state->has_content_type &&
+	    (!sent->has_content_type ||
+	     state->hint != sent->hint ||
+	     state->purpose != sent->purpose)) {
+		zwp_input_method_context_v1_send_content_type(
+			context->resource, state->hint, state->purpose);
+		sent->has_content_type = true;
+		sent->hint = state->hint;
+		sent->purpose = state->purpose;
+	}
+}
+
 static void
 deactivate_input_method(struct input_method *input_method)
 {
@@ -171,6 +228,7 @@ destroy_text_input(struct wl_resource *resource)
 			      &text_input->input_methods, link)
 		deactivate_input_method(input_method);
 
+	text_input_state_fini(&text_input->state);
 	free(text_input);
 }
 
@@ -182,15 +240,17 @@ text_input_set_surrounding_text(struct wl_client *client,
 				uint32_t anchor)
 {
 	struct text_input *text_input = wl_resource_get_user_data(resource);
-	struct input_method *input_method, *next;
-
-	wl_list_for_each_safe(input_method, next,
-			      &text_input->input_methods, link) {
-		if (!input_method->context)
-			continue;
-		zwp_input_method_context_v1_send_surrounding_text(
-			input_method->context->resource, text, cursor, anchor);
+	struct text_input_state *state = &text_input->state;
+
+	/* Editors resend the whole text with every change, keep the copy
+	 * when it is the same */
+	if (!state->surrounding_text ||
+	    strcmp(state->surrounding_text, text) != 0) {
+		free(state->surrounding_text);
+		state->surrounding_text = xstrdup(text);
 	}
+	state->cursor = cursor;
+	state->anchor = anchor;
 }
 
 static void
@@ -264,6 +324,8 @@ text_input_reset(struct wl_client *client,
 			      &text_input->input_methods, link) {
 		if (!input_method->context)
 			continue;
+		/* The input method may drop what it knew, resend it all */
+		text_input_state_fini(&input_method->context->sent);
 		zwp_input_method_context_v1_send_reset(
 			input_method->context->resource);
 	}
@@ -280,6 +342,12 @@ text_input_set_cursor_rectangle(struct wl_client *client,
 	struct text_input *text_input = wl_resource_get_user_data(resource);
 	struct weston_compositor *ec = text_input->ec;
 
+	if (text_input->cursor_rectangle.x1 == x &&
+	    text_input->cursor_rectangle.y1 == y &&
+	    text_input->cursor_rectangle.x2 == x + width &&
+	    text_input->cursor_rectangle.y2 == y + height)
+		return;
+
 	text_input->cursor_rectangle.x1 = x;
 	text_input->cursor_rectangle.y1 = y;
 	text_input->cursor_rectangle.x2 = x + width;
@@ -296,15 +364,10 @@ text_input_set_content_type(struct wl_client *client,
 			    uint32_t purpose)
 {
 	struct text_input *text_input = wl_resource_get_user_data(resource);
-	struct input_method *input_method, *next;
 
-	wl_list_for_each_safe(input_method, next,
-			      &text_input->input_methods, link) {
-		if (!input_method->context)
-			continue;
-		zwp_input_method_context_v1_send_content_type(
-			input_method->context->resource, hint, purpose);
-	}
+	text_input->state.has_content_type = true;
+	text_input->state.hint = hint;
+	text_input->state.purpose = purpose;
 }
 
 static void
@@ -337,6 +400,8 @@ text_input_commit_state(struct wl_client *client,
 			      &text_input->input_methods, link) {
 		if (!input_method->context)
 			continue;
+		input_method_context_send_state(input_method->context,
+						&text_input->state);
 		zwp_input_method_context_v1_send_commit_state(
 			input_method->context->resource, serial);
 	}
@@ -798,6 +863,7 @@ destroy_input_method_context(struct wl_resource *resource)
 	if (context->input_method && context->input_method->context == context)
 		context->input_method->context = NULL;
 
+	text_input_state_fini(&context->sent);
 	free(context);
 }
 
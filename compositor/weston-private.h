@@ -40,3 +40,11 @@ int
 wet_output_set_color_characteristics(struct weston_output *output,
 				     struct weston_config *wc,
 				     struct weston_config_section *section);
+
+struct session_recorder;
+
+struct session_recorder *
+wet_session_recorder_create(struct wl_display *display, const char *path);
+
+void
+wet_session_recorder_destroy(struct session_recorder *recorder);
@@ -105,6 +105,23 @@ recorder_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 	}
 }
 
+static void
+recorder_all_binding(struct weston_keyboard *keyboard,
+		     const struct timespec *time, uint32_t key, void *data)
+{
+	struct weston_compositor *ec = keyboard->seat->compositor;
+	struct screenshooter *shooter = data;
+	static const char filename[] = "capture.wcap";
+
+	if (shooter->recorder) {
+		weston_recorder_stop(shooter->recorder);
+		shooter->recorder = NULL;
+	} else {
+		shooter->recorder =
+			weston_recorder_start_all_outputs(ec, filename);
+	}
+}
+
 static void
 authorize_screenshooter(struct wl_listener *l,
 			struct weston_output_capture_attempt *att)
@@ -144,6 +161,9 @@ screenshooter_create(struct weston_compositor *ec)
 					  screenshooter_binding, shooter);
 	weston_compositor_add_key_binding(ec, KEY_R, MODIFIER_SUPER,
 					  recorder_binding, shooter);
+	weston_compositor_add_key_binding(ec, KEY_R,
+					  MODIFIER_SUPER | MODIFIER_SHIFT,
+					  recorder_all_binding, shooter);
 
 	shooter->compositor_destroy_listener.notify = screenshooter_destroy;
 	wl_signal_add(&ec->destroy_signal,
@@ -32,12 +32,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <inttypes.h>
 
 #include <libweston/libweston.h>
 #include "compositor/weston.h"
 #include "fullscreen-shell-unstable-v1-server-protocol.h"
 #include "shared/helpers.h"
 #include <libweston/shell-utils.h>
+#include <libweston/weston-log.h>
 
 struct fullscreen_shell {
 	struct wl_client *client;
@@ -51,6 +54,8 @@ struct fullscreen_shell {
 
 	struct wl_listener seat_created_listener;
 
+	struct weston_log_scope *debug;
+
 	/* List of one surface per client, presented for the NULL output
 	 *
 	 * This is implemented as a list in case someone fixes the shell
@@ -59,12 +64,34 @@ struct fullscreen_shell {
 	struct wl_list default_surface_list; /* struct fs_client_surface::link */
 };
 
+/* How the presented surface ends up on the output */
+enum fs_output_fit {
+	/* No surface is presented */
+	FS_FIT_NONE = 0,
+	/* The surface covers the output 1:1 and opaquely: no curtain, and
+	 * nothing left to composite beyond a single copy or a scanout */
+	FS_FIT_DIRECT,
+	/* Unscaled, with curtain bars around or behind it */
+	FS_FIT_LETTERBOX,
+	/* Scaled through fs_output::transform */
+	FS_FIT_SCALED,
+	FS_FIT_COUNT
+};
+
+static const char *const fs_output_fit_names[FS_FIT_COUNT] = {
+	[FS_FIT_NONE] = "none",
+	[FS_FIT_DIRECT] = "direct",
+	[FS_FIT_LETTERBOX] = "letterbox",
+	[FS_FIT_SCALED] = "scaled",
+};
+
 struct fs_output {
 	struct fullscreen_shell *shell;
 	struct wl_list link;
 
 	struct weston_output *output;
 	struct wl_listener output_destroyed;
+	struct wl_listener output_presented;
 
 	struct {
 		struct weston_surface *surface;
@@ -85,6 +112,11 @@ struct fs_output {
 	int presented_for_mode;
 	enum zwp_fullscreen_shell_v1_present_method method;
 	uint32_t framerate;
+
+	enum fs_output_fit fit;
+	bool curtain_visible;
+	/* output frames presented per fit */
+	uint64_t frames[FS_FIT_COUNT];
 };
 
 struct pointer_focus_listener {
@@ -257,6 +289,8 @@ static void
 fs_output_apply_pending(struct fs_output *fsout);
 static void
 fs_output_clear_pending(struct fs_output *fsout);
+static void
+fs_output_update_fit(struct fs_output *fsout);
 
 static void
 fs_output_destroy(struct fs_output *fsout)
@@ -267,8 +301,10 @@ fs_output_destroy(struct fs_output *fsout)
 	weston_shell_utils_curtain_destroy(fsout->curtain);
 	wl_list_remove(&fsout->link);
 
-	if (fsout->output)
+	if (fsout->output) {
 		wl_list_remove(&fsout->output_destroyed.link);
+		wl_list_remove(&fsout->output_presented.link);
+	}
 }
 
 static void
@@ -280,6 +316,16 @@ output_destroyed(struct wl_listener *listener, void *data)
 	fs_output_destroy(output);
 }
 
+static void
+output_presented(struct wl_listener *listener, void *data)
+{
+	struct fs_output *fsout = container_of(listener,
+					       struct fs_output,
+					       output_presented);
+
+	fsout->frames[fsout->fit]++;
+}
+
 static void
 surface_destroyed(struct wl_listener *listener, void *data)
 {
@@ -290,6 +336,7 @@ surface_destroyed(struct wl_listener *listener, void *data)
 	fsout->view = NULL;
 	wl_list_remove(&fsout->transform.link);
 	wl_list_init(&fsout->transform.link);
+	fs_output_update_fit(fsout);
 }
 
 static void
@@ -320,6 +367,8 @@ fs_output_create(struct fullscreen_shell *shell, struct weston_output *output)
 	fsout->output = output;
 	fsout->output_destroyed.notify = output_destroyed;
 	wl_signal_add(&output->destroy_signal, &fsout->output_destroyed);
+	fsout->output_presented.notify = output_presented;
+	wl_signal_add(&output->present_signal, &fsout->output_presented);
 
 	fsout->surface_destroyed.notify = surface_destroyed;
 	fsout->pending.surface_destroyed.notify = pending_surface_destroyed;
@@ -329,6 +378,7 @@ fs_output_create(struct fullscreen_shell *shell, struct weston_output *output)
 	fsout->curtain->view->is_mapped = true;
 	weston_layer_entry_insert(&shell->layer.view_list,
 			          &fsout->curtain->view->layer_link);
+	fsout->curtain_visible = true;
 	wl_list_init(&fsout->transform.link);
 
 	if (!wl_list_empty(&shell->default_surface_list)) {
@@ -388,8 +438,11 @@ fs_output_scale_view(struct fs_output *fsout, float width, float height)
 		wl_list_insert(&fsout->view->geometry.transformation_list,
 			       &fsout->transform.link);
 
-		x = output->x + (output->width - width) / 2 - surf_x;
-		y = output->y + (output->height - height) / 2 - surf_y;
+		/* Keep the scaled image on whole output pixels, so that an
+		 * integer scale maps every buffer pixel to exactly n*n
+		 * output pixels instead of blending across the edges. */
+		x = output->x + floorf((output->width - width) / 2) - surf_x;
+		y = output->y + floorf((output->height - height) / 2) - surf_y;
 
 		weston_view_set_position(view, x, y);
 	}
@@ -541,6 +594,56 @@ fs_output_configure_for_mode(struct fs_output *fsout,
 				 fsout->output->y - surf_y);
 }
 
+static void
+fs_output_set_curtain_visible(struct fs_output *fsout, bool visible)
+{
+	struct weston_layer_entry *bottom;
+	struct weston_view *view = fsout->curtain->view;
+
+	if (fsout->curtain_visible == visible)
+		return;
+
+	if (visible) {
+		/* Back to the bottom of the layer, below any presented view */
+		bottom = container_of(fsout->shell->layer.view_list.link.prev,
+				      struct weston_layer_entry, link);
+		weston_layer_entry_insert(bottom, &view->layer_link);
+		view->is_mapped = true;
+		weston_view_geometry_dirty(view);
+	} else {
+		weston_view_damage_below(view);
+		weston_layer_entry_remove(&view->layer_link);
+		view->is_mapped = false;
+	}
+
+	fsout->curtain_visible = visible;
+}
+
+/* Classify the configured view, and drop the curtain when the view alone
+ * already covers the output opaquely: the curtain would only add a view
+ * the backend has to look at and the renderer has to clip away. */
+static void
+fs_output_update_fit(struct fs_output *fsout)
+{
+	struct weston_view *view = fsout->view;
+
+	if (!view) {
+		fsout->fit = FS_FIT_NONE;
+	} else if (!wl_list_empty(&fsout->transform.link)) {
+		fsout->fit = FS_FIT_SCALED;
+	} else {
+		weston_view_update_transform(view);
+
+		if (weston_view_matches_output_entirely(view, fsout->output) &&
+		    weston_view_is_opaque(view, &view->transform.boundingbox))
+			fsout->fit = FS_FIT_DIRECT;
+		else
+			fsout->fit = FS_FIT_LETTERBOX;
+	}
+
+	fs_output_set_curtain_visible(fsout, fsout->fit != FS_FIT_DIRECT);
+}
+
 static void
 fs_output_configure(struct fs_output *fsout,
 		    struct weston_surface *surface)
@@ -557,6 +660,7 @@ fs_output_configure(struct fs_output *fsout,
 			fs_output_configure_simple(fsout, surface);
 	}
 
+	fs_output_update_fit(fsout);
 	weston_output_schedule_repaint(fsout->output);
 }
 
@@ -678,6 +782,7 @@ fs_output_set_surface(struct fs_output *fsout, struct weston_surface *surface,
 
 		fsout->surface = NULL;
 
+		fs_output_update_fit(fsout);
 		weston_output_schedule_repaint(fsout->output);
 	}
 }
@@ -796,6 +901,27 @@ struct zwp_fullscreen_shell_v1_interface fullscreen_shell_implementation = {
 	fullscreen_shell_present_surface_for_mode,
 };
 
+static void
+fullscreen_shell_debug_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct fullscreen_shell *shell = data;
+	struct fs_output *fsout;
+	int i;
+
+	wl_list_for_each(fsout, &shell->output_list, link) {
+		weston_log_subscription_printf(sub, "output %s: fit %s,",
+					       fsout->output->name,
+					       fs_output_fit_names[fsout->fit]);
+		for (i = FS_FIT_DIRECT; i < FS_FIT_COUNT; i++)
+			weston_log_subscription_printf(sub, " %s %" PRIu64,
+						       fs_output_fit_names[i],
+						       fsout->frames[i]);
+		weston_log_subscription_printf(sub, " frames\n");
+	}
+
+	weston_log_subscription_complete(sub);
+}
+
 static void
 output_created(struct wl_listener *listener, void *data)
 {
@@ -864,6 +990,7 @@ fullscreen_shell_destroy(struct wl_listener *listener, void *data)
 		remove_default_surface(surf);
 	}
 
+	weston_log_scope_destroy(shell->debug);
 	weston_layer_fini(&shell->layer);
 	free(shell);
 }
@@ -894,6 +1021,12 @@ wet_shell_init(struct weston_compositor *compositor,
 
 	shell->client_destroyed.notify = client_destroyed;
 
+	shell->debug =
+		weston_compositor_add_log_scope(compositor, "fullscreen-shell",
+						"Presentation statistics per output\n",
+						fullscreen_shell_debug_cb,
+						NULL, shell);
+
 	weston_layer_init(&shell->layer, compositor);
 	weston_layer_set_position(&shell->layer,
 				  WESTON_LAYER_POSITION_FULLSCREEN);
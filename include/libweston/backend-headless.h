@@ -44,6 +44,9 @@ struct weston_headless_backend_config {
 
 	/** Use output decorations, requires use_gl = true */
 	bool decorate;
+
+	/** Pace frames by a virtual presentation clock instead of wall time */
+	enum weston_virtual_clock_mode virtual_clock;
 };
 
 #ifdef  __cplusplus
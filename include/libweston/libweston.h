@@ -87,6 +87,7 @@ struct weston_pointer;
 struct linux_dmabuf_buffer;
 struct weston_recorder;
 struct weston_pointer_constraint;
+struct weston_confine_region;
 struct ro_anonymous_file;
 struct weston_color_profile;
 struct weston_color_transform;
@@ -129,6 +130,73 @@ enum weston_surface_protection_mode {
 	WESTON_SURFACE_PROTECTION_MODE_ENFORCED
 };
 
+/** A set of outputs, keyed by weston_output::id
+ *
+ * IDs 0 to 31 live in the inline word, so the common case never
+ * allocates. Higher IDs go to the extra words, which grow on demand.
+ * A zero-initialized set is a valid empty set; release it with
+ * weston_output_set_fini().
+ *
+ * \ingroup output
+ */
+struct weston_output_set {
+	uint32_t bits;		/* IDs 0 to 31 */
+	uint32_t *extra;	/* IDs from 32 on, 32 per word */
+	uint32_t n_extra;	/* number of words in extra */
+};
+
+/** Test whether an output ID is in the set
+ *
+ * \ingroup output
+ */
+static inline bool
+weston_output_set_has(const struct weston_output_set *set, uint32_t id)
+{
+	uint32_t word;
+
+	if (id < 32)
+		return (set->bits & (1u << id)) != 0;
+
+	word = id / 32 - 1;
+	if (word >= set->n_extra)
+		return false;
+
+	return (set->extra[word] & (1u << (id % 32))) != 0;
+}
+
+void
+weston_output_set_add(struct weston_output_set *set, uint32_t id);
+
+void
+weston_output_set_remove(struct weston_output_set *set, uint32_t id);
+
+void
+weston_output_set_clear(struct weston_output_set *set);
+
+void
+weston_output_set_fini(struct weston_output_set *set);
+
+bool
+weston_output_set_is_empty(const struct weston_output_set *set);
+
+bool
+weston_output_set_is_single(const struct weston_output_set *set, uint32_t id);
+
+bool
+weston_output_set_equal(const struct weston_output_set *a,
+			const struct weston_output_set *b);
+
+void
+weston_output_set_copy(struct weston_output_set *dst,
+		       const struct weston_output_set *src);
+
+void
+weston_output_set_union(struct weston_output_set *dst,
+			const struct weston_output_set *src);
+
+uint32_t
+weston_output_set_first_free(const struct weston_output_set *set);
+
 struct weston_mode {
 	uint32_t flags;
 	enum weston_mode_aspect_ratio aspect_ratio;
@@ -466,8 +534,21 @@ struct weston_output {
 	struct weston_matrix matrix;
 	/** From output buffer to global coordinates. */
 	struct weston_matrix inverse_matrix;
+	/** When matrix is only an integer scale and translation, the
+	 * cheaper equivalent: output = global * scale + (dx, dy). */
+	struct {
+		bool valid;
+		int32_t scale;
+		int32_t dx, dy;
+	} matrix_integer;
 
 	struct wl_list animation_list;
+
+	/** Frame callbacks of the last repaint, sent once the whole repaint
+	 * pass is done, with frame_callback_msec as timestamp. */
+	struct wl_list frame_callback_list;
+	uint32_t frame_callback_msec;
+
 	int32_t x, y, width, height;
 
 	/** List of paint nodes in z-order, from top to bottom, maybe pruned
@@ -479,6 +560,10 @@ struct weston_output {
 	/** Output area in global coordinates, simple rect */
 	pixman_region32_t region;
 
+	/** The damage passed to weston_output::repaint, in output
+	 * coordinates. Only valid during repaint. */
+	pixman_region32_t repaint_damage;
+
 	/** True if damage has occurred since the last repaint for this output;
 	 *  if set, a repaint will eventually occur. */
 	bool repaint_needed;
@@ -502,8 +587,15 @@ struct weston_output {
 	struct wl_event_source *idle_repaint_source;
 
 	struct wl_signal frame_signal;
+	struct wl_signal present_signal;	/**< sent when a repaint is presented */
 	struct wl_signal destroy_signal;	/**< sent when disabled */
 	int move_x, move_y;
+
+	/* Changes held back by an output layout transaction, see
+	 * weston_compositor_begin_output_layout() */
+	uint32_t layout_pending;
+	int layout_move_x, layout_move_y;
+
 	struct timespec frame_time; /* presentation timestamp */
 	uint64_t msc;        /* media stream counter */
 	int disable_planes;
@@ -1358,6 +1450,21 @@ struct weston_color_manager;
 struct weston_dmabuf_feedback;
 struct weston_dmabuf_feedback_format_table;
 struct weston_renderer;
+struct weston_virtual_timer;
+
+/** Presentation clock pacing mode
+ *
+ * A virtual presentation clock does not follow wall time. It either jumps
+ * straight to the next timer deadline once the compositor has handled the
+ * work already pending (AUTO), or only advances when explicitly told to
+ * (MANUAL, e.g. by the test suite).
+ * Only backends without real display timing can offer it.
+ */
+enum weston_virtual_clock_mode {
+	WESTON_VIRTUAL_CLOCK_DISABLED = 0,
+	WESTON_VIRTUAL_CLOCK_AUTO,
+	WESTON_VIRTUAL_CLOCK_MANUAL,
+};
 
 /** Main object, container-like structure which aggregates all other objects.
  *
@@ -1414,6 +1521,12 @@ struct weston_compositor {
 	struct wl_list tablet_tool_binding_list;
 	struct wl_list axis_binding_list;
 	struct wl_list debug_binding_list;
+	struct weston_binding_index *key_binding_index;
+	struct weston_binding_index *button_binding_index;
+	struct weston_binding_index *axis_binding_index;
+
+	/* compositor-created solid buffers, shared by color */
+	struct wl_list solid_buffer_list; /* weston_solid_buffer_entry::link */
 
 	uint32_t state;
 	struct wl_event_source *idle_source;
@@ -1439,9 +1552,14 @@ struct weston_compositor {
 
 	struct wl_list plugin_api_list; /* struct weston_plugin_api::link */
 
-	uint32_t output_id_pool;
+	struct weston_output_set output_id_pool;
 	bool output_flow_dirty;
 
+	/* Open output layout transactions, and whether committing them
+	 * needs every view re-assigned to outputs */
+	int output_layout_depth;
+	bool output_layout_views_dirty;
+
 	struct xkb_rule_names xkb_names;
 	struct xkb_context *xkb_context;
 	struct weston_xkb_info *xkb_info;
@@ -1455,6 +1573,19 @@ struct weston_compositor {
 	int32_t repaint_msec;
 	struct timespec last_repaint_start;
 
+	/** Virtual presentation clock, see
+	 * weston_compositor_set_presentation_clock_virtual() */
+	struct {
+		enum weston_virtual_clock_mode mode;
+		struct timespec now;
+		struct wl_list timer_list; /* weston_virtual_timer::link */
+		uint32_t dispatch_serial;
+		int kick_fd;
+		struct wl_event_source *kick_source;
+		struct wl_event_source *advance_source;
+		struct weston_virtual_timer *repaint_timer;
+	} virtual_clock;
+
 	unsigned int activate_serial;
 
 	struct wl_global *pointer_constraints;
@@ -1717,7 +1848,7 @@ struct weston_view {
 	 * A more complete representation of all outputs this surface is
 	 * displayed on.
 	 */
-	uint32_t output_mask;
+	struct weston_output_set output_mask;
 
 	/* Per-surface Presentation feedback flags, controlled by backend. */
 	uint32_t psf_flags;
@@ -1796,6 +1927,9 @@ struct weston_pointer_constraint {
 	wl_fixed_t hint_y_pending;
 	bool hint_is_pending;
 
+	/* input region ∩ region and its outline, see input.c */
+	struct weston_confine_region *confine;
+
 	struct wl_listener pointer_destroy_listener;
 	struct wl_listener view_unmap_listener;
 	struct wl_listener surface_commit_listener;
@@ -1840,7 +1974,7 @@ struct weston_surface {
 	 * A more complete representation of all outputs this surface is
 	 * displayed on.
 	 */
-	uint32_t output_mask;
+	struct weston_output_set output_mask;
 
 	struct wl_list frame_callback_list;
 	struct wl_list feedback_list;
@@ -2169,6 +2303,13 @@ weston_view_set_mask_infinite(struct weston_view *view);
 bool
 weston_view_is_mapped(struct weston_view *view);
 
+bool
+weston_view_is_opaque(struct weston_view *ev, pixman_region32_t *region);
+
+bool
+weston_view_matches_output_entirely(struct weston_view *ev,
+				    struct weston_output *output);
+
 void
 weston_view_schedule_repaint(struct weston_view *view);
 
@@ -2324,6 +2465,9 @@ weston_screenshooter_shoot(struct weston_output *output, struct weston_buffer *b
 			   weston_screenshooter_done_func_t done, void *data);
 struct weston_recorder *
 weston_recorder_start(struct weston_output *output, const char *filename);
+struct weston_recorder *
+weston_recorder_start_all_outputs(struct weston_compositor *compositor,
+				  const char *filename);
 void
 weston_recorder_stop(struct weston_recorder *recorder);
 
@@ -2522,6 +2666,12 @@ void
 weston_output_move(struct weston_output *output,
 		   struct weston_coord_global pos);
 
+void
+weston_compositor_begin_output_layout(struct weston_compositor *compositor);
+
+void
+weston_compositor_commit_output_layout(struct weston_compositor *compositor);
+
 int
 weston_output_enable(struct weston_output *output);
 
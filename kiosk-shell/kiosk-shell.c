@@ -27,11 +27,13 @@
 #include <linux/input.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "kiosk-shell.h"
 #include "kiosk-shell-grab.h"
 #include "compositor/weston.h"
+#include "shared/hash.h"
 #include "shared/helpers.h"
 #include <libweston/shell-utils.h>
 
@@ -151,9 +153,8 @@ kiosk_shell_surface_get_parent_root(struct kiosk_shell_surface *shsurf)
 	return root;
 }
 
-static bool
-kiosk_shell_output_has_app_id(struct kiosk_shell_output *shoutput,
-			      const char *app_id);
+static struct kiosk_shell_output *
+kiosk_shell_find_app_id_output(struct kiosk_shell *shell, const char *app_id);
 
 static struct weston_output *
 kiosk_shell_surface_find_best_output(struct kiosk_shell_surface *shsurf)
@@ -170,11 +171,10 @@ kiosk_shell_surface_find_best_output(struct kiosk_shell_surface *shsurf)
 	/* Check if we have a designated output for this app. */
 	app_id = weston_desktop_surface_get_app_id(shsurf->desktop_surface);
 	if (app_id) {
-		wl_list_for_each(shoutput, &shsurf->shell->output_list, link) {
-			if (kiosk_shell_output_has_app_id(shoutput, app_id)) {
-				shsurf->appid_output_assigned = true;
-				return shoutput->output;
-			}
+		shoutput = kiosk_shell_find_app_id_output(shsurf->shell, app_id);
+		if (shoutput) {
+			shsurf->appid_output_assigned = true;
+			return shoutput->output;
 		}
 	}
 
@@ -526,9 +526,152 @@ kiosk_shell_output_recreate_background(struct kiosk_shell_output *shoutput)
 	weston_view_set_output(shoutput->curtain->view, output);
 }
 
+/* One app-id from the app-ids list of an output */
+struct kiosk_shell_app_id {
+	char *app_id;
+	uint32_t hash;
+	struct kiosk_shell_output *shoutput;
+	struct wl_list link;		/** kiosk_shell_app_id_bucket::entry_list */
+	struct wl_list output_link;	/** kiosk_shell_output::app_id_list */
+};
+
+/* The app-ids sharing one hash, in the order their outputs were created,
+ * so the first configured output keeps winning when an app-id is listed
+ * for several outputs. */
+struct kiosk_shell_app_id_bucket {
+	struct wl_list entry_list;	/** kiosk_shell_app_id::link */
+};
+
+/* FNV-1a */
+static uint32_t
+kiosk_shell_app_id_hash(const char *app_id, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) app_id[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct kiosk_shell_output *
+kiosk_shell_find_app_id_output(struct kiosk_shell *shell, const char *app_id)
+{
+	struct kiosk_shell_app_id_bucket *bucket;
+	struct kiosk_shell_app_id *entry;
+	uint32_t hash;
+
+	hash = kiosk_shell_app_id_hash(app_id, strlen(app_id));
+	bucket = hash_table_lookup(shell->app_id_table, hash);
+	if (!bucket)
+		return NULL;
+
+	wl_list_for_each(entry, &bucket->entry_list, link) {
+		if (strcmp(entry->app_id, app_id) == 0)
+			return entry->shoutput;
+	}
+
+	return NULL;
+}
+
+static void
+kiosk_shell_app_id_destroy(struct kiosk_shell *shell,
+			   struct kiosk_shell_app_id *entry)
+{
+	struct kiosk_shell_app_id_bucket *bucket;
+
+	bucket = hash_table_lookup(shell->app_id_table, entry->hash);
+	assert(bucket);
+
+	wl_list_remove(&entry->link);
+	wl_list_remove(&entry->output_link);
+
+	if (wl_list_empty(&bucket->entry_list)) {
+		hash_table_remove(shell->app_id_table, entry->hash);
+		free(bucket);
+	}
+
+	free(entry->app_id);
+	free(entry);
+}
+
+static int
+kiosk_shell_output_add_app_id(struct kiosk_shell_output *shoutput,
+			      const char *app_id, size_t len)
+{
+	struct kiosk_shell *shell = shoutput->shell;
+	struct kiosk_shell_app_id_bucket *bucket;
+	struct kiosk_shell_app_id *entry;
+
+	entry = zalloc(sizeof *entry);
+	if (!entry)
+		return -1;
+
+	entry->app_id = strndup(app_id, len);
+	if (!entry->app_id) {
+		free(entry);
+		return -1;
+	}
+	entry->hash = kiosk_shell_app_id_hash(app_id, len);
+	entry->shoutput = shoutput;
+
+	bucket = hash_table_lookup(shell->app_id_table, entry->hash);
+	if (!bucket) {
+		bucket = zalloc(sizeof *bucket);
+		if (!bucket ||
+		    hash_table_insert(shell->app_id_table,
+				      entry->hash, bucket) < 0) {
+			free(bucket);
+			free(entry->app_id);
+			free(entry);
+			return -1;
+		}
+		wl_list_init(&bucket->entry_list);
+	}
+
+	wl_list_insert(bucket->entry_list.prev, &entry->link);
+	wl_list_insert(shoutput->app_id_list.prev, &entry->output_link);
+
+	return 0;
+}
+
+/* Parse the comma-separated app-ids of the output into the shell's app-id
+ * table, so surfaces can be routed without scanning the string again. */
+static void
+kiosk_shell_output_add_app_ids(struct kiosk_shell_output *shoutput)
+{
+	const char *cur = shoutput->app_ids;
+	size_t len;
+
+	if (!cur)
+		return;
+
+	while (*cur) {
+		len = strcspn(cur, ",");
+		if (len > 0 &&
+		    kiosk_shell_output_add_app_id(shoutput, cur, len) < 0) {
+			weston_log("kiosk-shell: out of memory adding app-ids "
+				   "of output %s\n", shoutput->output->name);
+			return;
+		}
+
+		cur += len;
+		if (*cur == ',')
+			cur++;
+	}
+}
+
 static void
 kiosk_shell_output_destroy(struct kiosk_shell_output *shoutput)
 {
+	struct kiosk_shell_app_id *entry, *tmp;
+
+	wl_list_for_each_safe(entry, tmp, &shoutput->app_id_list, output_link)
+		kiosk_shell_app_id_destroy(shoutput->shell, entry);
+
 	shoutput->output = NULL;
 	shoutput->output_destroy_listener.notify = NULL;
 
@@ -543,30 +686,6 @@ kiosk_shell_output_destroy(struct kiosk_shell_output *shoutput)
 	free(shoutput);
 }
 
-static bool
-kiosk_shell_output_has_app_id(struct kiosk_shell_output *shoutput,
-			      const char *app_id)
-{
-	char *cur;
-	size_t app_id_len;
-
-	if (!shoutput->app_ids)
-		return false;
-
-	cur = shoutput->app_ids;
-	app_id_len = strlen(app_id);
-
-	while ((cur = strstr(cur, app_id))) {
-		/* Check whether we have found a complete match of app_id. */
-		if ((cur[app_id_len] == ',' || cur[app_id_len] == '\0') &&
-		    (cur == shoutput->app_ids || cur[-1] == ','))
-			return true;
-		cur++;
-	}
-
-	return false;
-}
-
 static void
 kiosk_shell_output_configure(struct kiosk_shell_output *shoutput)
 {
@@ -580,6 +699,8 @@ kiosk_shell_output_configure(struct kiosk_shell_output *shoutput)
 		weston_config_section_get_string(section, "app-ids",
 						 &shoutput->app_ids, NULL);
 	}
+
+	kiosk_shell_output_add_app_ids(shoutput);
 }
 
 static void
@@ -603,6 +724,7 @@ kiosk_shell_output_create(struct kiosk_shell *shell, struct weston_output *outpu
 
 	shoutput->output = output;
 	shoutput->shell = shell;
+	wl_list_init(&shoutput->app_id_list);
 
 	shoutput->output_destroy_listener.notify =
 		kiosk_shell_output_notify_output_destroy;
@@ -993,14 +1115,15 @@ static struct kiosk_shell_output *
 kiosk_shell_find_shell_output(struct kiosk_shell *shell,
 			      struct weston_output *output)
 {
-	struct kiosk_shell_output *shoutput;
+	struct wl_listener *listener;
 
-	wl_list_for_each(shoutput, &shell->output_list, link) {
-		if (shoutput->output == output)
-			return shoutput;
-	}
+	listener = wl_signal_get(&output->destroy_signal,
+				 kiosk_shell_output_notify_output_destroy);
+	if (!listener)
+		return NULL;
 
-	return NULL;
+	return container_of(listener, struct kiosk_shell_output,
+			    output_destroy_listener);
 }
 
 static void
@@ -1190,6 +1313,7 @@ kiosk_shell_destroy(struct wl_listener *listener, void *data)
 	wl_list_for_each_safe(shoutput, tmp, &shell->output_list, link) {
 		kiosk_shell_output_destroy(shoutput);
 	}
+	hash_table_destroy(shell->app_id_table);
 
 	/* bg layer doesn't contain a weston_desktop_surface, and
 	 * kiosk_shell_output_destroy() takes care of destroying it, we're just
@@ -1259,6 +1383,10 @@ wet_shell_init(struct weston_compositor *ec,
 	shell->seat_created_listener.notify = kiosk_shell_handle_seat_created;
 	wl_signal_add(&ec->seat_created_signal, &shell->seat_created_listener);
 
+	shell->app_id_table = hash_table_create();
+	if (!shell->app_id_table)
+		return -1;
+
 	wl_list_init(&shell->output_list);
 	wl_list_for_each(output, &ec->output_list, link)
 		kiosk_shell_output_create(shell, output);
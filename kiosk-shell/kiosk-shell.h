@@ -46,6 +46,9 @@ struct kiosk_shell {
 	struct wl_list output_list;
 	struct wl_list seat_list;
 
+	/* hash of an app-id -> struct kiosk_shell_app_id_bucket */
+	struct hash_table *app_id_table;
+
 	const struct weston_xwayland_surface_api *xwayland_surface_api;
 	struct weston_config *config;
 };
@@ -94,6 +97,7 @@ struct kiosk_shell_output {
 	struct wl_list link;
 
 	char *app_ids;
+	struct wl_list app_id_list;	/** kiosk_shell_app_id::output_link */
 };
 
 #endif /* WESTON_KIOSK_SHELL_H */
@@ -54,13 +54,129 @@ weston_spring_init(struct weston_spring *spring,
 	spring->max = 1.0;
 }
 
+#define SPRING_STEP_MSEC 4
+#define SPRING_STEP 0.01
+
+static void
+weston_spring_step(struct weston_spring *spring)
+{
+	double force, v, current, step;
+
+	step = SPRING_STEP;
+	current = spring->current;
+	v = current - spring->previous;
+	force = spring->k * (spring->target - current) / 10.0 +
+		(spring->previous - current) - v * spring->friction;
+
+	spring->current =
+		current + (current - spring->previous) +
+		force * step * step;
+	spring->previous = current;
+
+	switch (spring->clip) {
+	case WESTON_SPRING_OVERSHOOT:
+		break;
+
+	case WESTON_SPRING_CLAMP:
+		if (spring->current > spring->max) {
+			spring->current = spring->max;
+			spring->previous = spring->max;
+		} else if (spring->current < 0.0) {
+			spring->current = spring->min;
+			spring->previous = spring->min;
+		}
+		break;
+
+	case WESTON_SPRING_BOUNCE:
+		if (spring->current > spring->max) {
+			spring->current =
+				2 * spring->max - spring->current;
+			spring->previous =
+				2 * spring->max - spring->previous;
+		} else if (spring->current < spring->min) {
+			spring->current =
+				2 * spring->min - spring->current;
+			spring->previous =
+				2 * spring->min - spring->previous;
+		}
+		break;
+	}
+}
+
+/* Without clipping, a step of the integrator is the linear recurrence
+ *
+ *	e[n+1] = p * e[n] - q * e[n-1]
+ *
+ * on the distance e to the target, so any number of steps can be taken at
+ * once from the roots of r^2 - p * r + q. Returns false, leaving the spring
+ * untouched, when the spring could hit its clip limits on the way or the
+ * roots are too close to each other to be of use.
+ */
+static bool
+weston_spring_advance(struct weston_spring *spring, int64_t steps)
+{
+	const double h2 = SPRING_STEP * SPRING_STEP;
+	double p = 2.0 - h2 * (spring->k / 10.0 + 1.0 + spring->friction);
+	double q = 1.0 - h2 * (1.0 + spring->friction);
+	double disc = p * p - 4.0 * q;
+	double e0 = spring->previous - spring->target;
+	double e1 = spring->current - spring->target;
+	double n = steps;
+	double r1, r2, rho, theta, a, b, bound, lower, previous, current;
+	bool stable;
+
+	if (fabs(disc) < 1e-12)
+		return false;
+
+	if (disc > 0.0) {
+		/* e[n] = a * r1^n + b * r2^n */
+		r1 = (p + sqrt(disc)) / 2.0;
+		r2 = (p - sqrt(disc)) / 2.0;
+		b = (e1 - r1 * e0) / (r2 - r1);
+		a = e0 - b;
+		bound = fabs(a) + fabs(b);
+		stable = fabs(r1) <= 1.0 && fabs(r2) <= 1.0;
+
+		previous = a * pow(r1, n) + b * pow(r2, n);
+		current = a * pow(r1, n + 1) + b * pow(r2, n + 1);
+	} else {
+		/* e[n] = rho^n * (a * cos(n * theta) + b * sin(n * theta)) */
+		rho = sqrt(q);
+		theta = acos(p / (2.0 * rho));
+		a = e0;
+		b = (e1 / rho - a * cos(theta)) / sin(theta);
+		bound = hypot(a, b);
+		stable = rho <= 1.0;
+
+		previous = pow(rho, n) *
+			(a * cos(n * theta) + b * sin(n * theta));
+		current = pow(rho, n + 1) *
+			(a * cos((n + 1) * theta) + b * sin((n + 1) * theta));
+	}
+
+	/* Decaying, the spring never gets further from the target than
+	 * bound, so the limits are only a concern if that reaches them. */
+	if (spring->clip != WESTON_SPRING_OVERSHOOT) {
+		lower = spring->clip == WESTON_SPRING_CLAMP ? 0.0 : spring->min;
+		if (!stable ||
+		    spring->target + bound > spring->max ||
+		    spring->target - bound < lower)
+			return false;
+	}
+
+	spring->previous = spring->target + previous;
+	spring->current = spring->target + current;
+
+	return true;
+}
+
 WL_EXPORT void
 weston_spring_update(struct weston_spring *spring, const struct timespec *time)
 {
-	double force, v, current, step;
+	int64_t elapsed, steps, i;
 
-	/* Limit the number of executions of the loop below by ensuring that
-	 * the timestamp for last update of the spring is no more than 1s ago.
+	/* Limit the number of steps taken below by ensuring that the
+	 * timestamp for last update of the spring is no more than 1s ago.
 	 * This handles the case where time moves backwards or forwards in
 	 * large jumps.
 	 */
@@ -72,49 +188,20 @@ weston_spring_update(struct weston_spring *spring, const struct timespec *time)
 		timespec_add_msec(&spring->timestamp, time, -1000);
 	}
 
-	step = 0.01;
-	while (4 < timespec_sub_to_msec(time, &spring->timestamp)) {
-		current = spring->current;
-		v = current - spring->previous;
-		force = spring->k * (spring->target - current) / 10.0 +
-			(spring->previous - current) - v * spring->friction;
-
-		spring->current =
-			current + (current - spring->previous) +
-			force * step * step;
-		spring->previous = current;
-
-		switch (spring->clip) {
-		case WESTON_SPRING_OVERSHOOT:
-			break;
-
-		case WESTON_SPRING_CLAMP:
-			if (spring->current > spring->max) {
-				spring->current = spring->max;
-				spring->previous = spring->max;
-			} else if (spring->current < 0.0) {
-				spring->current = spring->min;
-				spring->previous = spring->min;
-			}
-			break;
-
-		case WESTON_SPRING_BOUNCE:
-			if (spring->current > spring->max) {
-				spring->current =
-					2 * spring->max - spring->current;
-				spring->previous =
-					2 * spring->max - spring->previous;
-			} else if (spring->current < spring->min) {
-				spring->current =
-					2 * spring->min - spring->current;
-				spring->previous =
-					2 * spring->min - spring->previous;
-			}
-			break;
-		}
+	/* Step in fixed increments for as long as more than one step of
+	 * time is left, like the integrator always has. */
+	elapsed = timespec_sub_to_msec(time, &spring->timestamp);
+	if (elapsed <= SPRING_STEP_MSEC)
+		return;
+	steps = (elapsed - 1) / SPRING_STEP_MSEC;
 
-		timespec_add_msec(&spring->timestamp, &spring->timestamp, 4);
+	if (!weston_spring_advance(spring, steps)) {
+		for (i = 0; i < steps; i++)
+			weston_spring_step(spring);
 	}
+
+	timespec_add_msec(&spring->timestamp, &spring->timestamp,
+			  steps * SPRING_STEP_MSEC);
 }
 
 WL_EXPORT int
@@ -192,13 +279,13 @@ weston_view_animation_frame(struct weston_animation *base,
 	weston_view_geometry_dirty(animation->view);
 	weston_view_schedule_repaint(animation->view);
 
-	/* The view's output_mask will be zero if its position is
+	/* The view's output_mask will be empty if its position is
 	 * offscreen. Animations should always run but as they are also
 	 * run off the repaint cycle, if there's nothing to repaint
 	 * the animation stops running. Therefore if we catch this situation
 	 * and schedule a repaint on all outputs it will be avoided.
 	 */
-	if (animation->view->output_mask == 0)
+	if (weston_output_set_is_empty(&animation->view->output_mask))
 		weston_compositor_schedule_repaint(compositor);
 }
 
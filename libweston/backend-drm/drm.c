@@ -461,10 +461,7 @@ drm_output_render(struct drm_output_state *state, pixman_region32_t *damage)
 		return;
 
 	pixman_region32_init(&scanout_damage);
-
-	weston_region_global_to_output(&scanout_damage,
-				       &output->base,
-				       damage);
+	pixman_region32_copy(&scanout_damage, &output->base.repaint_damage);
 
 	assert(scanout_state->damage_blob_id == 0);
 
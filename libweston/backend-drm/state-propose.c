@@ -783,7 +783,7 @@ drm_output_propose_state(struct weston_output *output_base,
 		/* If this view doesn't touch our output at all, there's no
 		 * reason to do anything with it. */
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if (!(ev->output_mask & (1u << output->base.id))) {
+		if (!weston_output_set_has(&ev->output_mask, output->base.id)) {
 			drm_debug(b, "\t\t\t\t[view] ignoring view %p "
 			             "(not on our output)\n", ev);
 			continue;
@@ -819,7 +819,8 @@ drm_output_propose_state(struct weston_output *output_base,
 
 		/* We only assign planes to views which are exclusively present
 		 * on our output. */
-		if (ev->output_mask != (1u << output->base.id)) {
+		if (!weston_output_set_is_single(&ev->output_mask,
+						 output->base.id)) {
 			drm_debug(b, "\t\t\t\t[view] not assigning view %p to plane "
 			             "(on multiple outputs)\n", ev);
 			force_renderer = true;
@@ -1042,7 +1043,7 @@ drm_assign_planes(struct weston_output *output_base)
 		/* If this view doesn't touch our output at all, there's no
 		 * reason to do anything with it. */
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if (!(ev->output_mask & (1u << output->base.id)))
+		if (!weston_output_set_has(&ev->output_mask, output->base.id))
 			continue;
 
 		/* Update dmabuf-feedback if needed */
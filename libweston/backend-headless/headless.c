@@ -47,6 +47,7 @@
 #include "shared/weston-egl-ext.h"
 #include "shared/cairo-util.h"
 #include "shared/xalloc.h"
+#include "shared/timespec-util.h"
 #include "linux-dmabuf.h"
 #include "output-capture.h"
 #include "presentation-time-server-protocol.h"
@@ -61,6 +62,8 @@ struct headless_backend {
 	bool decorate;
 	struct theme *theme;
 
+	bool virtual_clock;
+
 	const struct pixel_format_info **formats;
 	unsigned int formats_count;
 };
@@ -75,6 +78,7 @@ struct headless_output {
 
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
+	struct weston_virtual_timer *finish_frame_virtual_timer;
 	struct weston_renderbuffer *renderbuffer;
 
 	struct frame *frame;
@@ -139,6 +143,18 @@ finish_frame_handler(void *data)
 	return 1;
 }
 
+static void
+headless_output_remove_finish_frame_timer(struct headless_output *output)
+{
+	if (output->finish_frame_virtual_timer) {
+		weston_virtual_timer_destroy(output->finish_frame_virtual_timer);
+		output->finish_frame_virtual_timer = NULL;
+	} else {
+		wl_event_source_remove(output->finish_frame_timer);
+		output->finish_frame_timer = NULL;
+	}
+}
+
 static void
 headless_output_update_gl_border(struct headless_output *output)
 {
@@ -170,7 +186,17 @@ headless_output_repaint(struct weston_output *output_base,
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	if (output->finish_frame_virtual_timer) {
+		struct timespec deadline;
+
+		weston_compositor_read_presentation_clock(ec, &deadline);
+		timespec_add_nsec(&deadline, &deadline,
+				  millihz_to_nsec(output->mode.refresh));
+		weston_virtual_timer_arm(output->finish_frame_virtual_timer,
+					 &deadline);
+	} else {
+		wl_event_source_timer_update(output->finish_frame_timer, 16);
+	}
 
 	return 0;
 }
@@ -214,7 +240,7 @@ headless_output_disable(struct weston_output *base)
 
 	b = output->backend;
 
-	wl_event_source_remove(output->finish_frame_timer);
+	headless_output_remove_finish_frame_timer(output);
 
 	switch (b->compositor->renderer->type) {
 	case WESTON_RENDERER_GL:
@@ -340,11 +366,20 @@ headless_output_enable(struct weston_output *base)
 
 	b = output->backend;
 
-	loop = wl_display_get_event_loop(b->compositor->wl_display);
-	output->finish_frame_timer =
-		wl_event_loop_add_timer(loop, finish_frame_handler, output);
+	if (b->virtual_clock) {
+		output->finish_frame_virtual_timer =
+			weston_compositor_add_virtual_timer(b->compositor,
+							    finish_frame_handler,
+							    output);
+	} else {
+		loop = wl_display_get_event_loop(b->compositor->wl_display);
+		output->finish_frame_timer =
+			wl_event_loop_add_timer(loop, finish_frame_handler,
+						output);
+	}
 
-	if (output->finish_frame_timer == NULL) {
+	if (output->finish_frame_timer == NULL &&
+	    output->finish_frame_virtual_timer == NULL) {
 		weston_log("failed to add finish frame timer\n");
 		return -1;
 	}
@@ -363,7 +398,7 @@ headless_output_enable(struct weston_output *base)
 	}
 
 	if (ret < 0) {
-		wl_event_source_remove(output->finish_frame_timer);
+		headless_output_remove_finish_frame_timer(output);
 		return -1;
 	}
 
@@ -530,8 +565,14 @@ headless_backend_create(struct weston_compositor *compositor,
 	b->compositor = compositor;
 	compositor->backend = &b->base;
 
-	if (weston_compositor_set_presentation_clock_software(compositor) < 0)
+	if (config->virtual_clock != WESTON_VIRTUAL_CLOCK_DISABLED) {
+		if (weston_compositor_set_presentation_clock_virtual(compositor,
+					config->virtual_clock) < 0)
+			goto err_free;
+		b->virtual_clock = true;
+	} else if (weston_compositor_set_presentation_clock_software(compositor) < 0) {
 		goto err_free;
+	}
 
 	b->base.destroy = headless_destroy;
 	b->base.create_output = headless_output_create;
@@ -31,6 +31,7 @@
 #include <string.h>
 #include <errno.h>
 #include <linux/input.h>
+#include <math.h>
 #include <unistd.h>
 
 #include "rdp.h"
@@ -262,13 +263,144 @@ rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
 		rdp_peer_refresh_raw(region, image, peer);
 }
 
+/* The part of the output a peer still shows, in output coordinates */
+static void
+rdp_peer_get_visible_area(struct rdp_peers_item *peer,
+			  struct rdp_output *output,
+			  pixman_region32_t *area)
+{
+	pixman_region32_init_rect(area, 0, 0,
+				  output->base.current_mode->width,
+				  output->base.current_mode->height);
+
+	if (peer->has_visible_area)
+		pixman_region32_intersect_rect(area, area,
+					       peer->visible_area.x1,
+					       peer->visible_area.y1,
+					       peer->visible_area.x2 -
+					       peer->visible_area.x1,
+					       peer->visible_area.y2 -
+					       peer->visible_area.y1);
+}
+
+static bool
+rdp_peer_wants_output(struct rdp_peers_item *peer)
+{
+	return (peer->flags & RDP_PEER_ACTIVATED) &&
+	       (peer->flags & RDP_PEER_OUTPUT_ENABLED);
+}
+
+/* Union of what the peers still show, in global coordinates.
+ * Returns false when no peer is connected, so that everything is rendered
+ * as usual, e.g. for screenshots. */
+static bool
+rdp_output_get_visible_region(struct rdp_output *output,
+			      pixman_region32_t *visible)
+{
+	struct rdp_backend *b = output->backend;
+	struct rdp_peers_item *peer;
+	bool any_peer = false;
+
+	pixman_region32_init(visible);
+
+	wl_list_for_each(peer, &b->peers, link) {
+		pixman_region32_t area;
+		pixman_box32_t *extents;
+		struct weston_coord_global tl, br;
+
+		if (!(peer->flags & RDP_PEER_ACTIVATED))
+			continue;
+
+		any_peer = true;
+		if (!(peer->flags & RDP_PEER_OUTPUT_ENABLED))
+			continue;
+
+		rdp_peer_get_visible_area(peer, output, &area);
+		extents = pixman_region32_extents(&area);
+		tl = weston_coord_global_from_output_point(extents->x1,
+							   extents->y1,
+							   &output->base);
+		br = weston_coord_global_from_output_point(extents->x2,
+							   extents->y2,
+							   &output->base);
+		pixman_region32_union_rect(visible, visible,
+					   floor(tl.c.x), floor(tl.c.y),
+					   ceil(br.c.x) - floor(tl.c.x),
+					   ceil(br.c.y) - floor(tl.c.y));
+		pixman_region32_fini(&area);
+	}
+
+	return any_peer;
+}
+
+/* Stop repainting while every connected peer has suppressed output, and
+ * restart with a full refresh once one of them allows it again. */
+static void
+rdp_output_update_suppressed(struct rdp_backend *b)
+{
+	struct rdp_output *output = rdp_get_first_output(b);
+	struct rdp_peers_item *peer;
+	struct timespec ts;
+	bool any_peer = false;
+	bool any_wants_output = false;
+
+	if (!output || !output->base.enabled)
+		return;
+
+	wl_list_for_each(peer, &b->peers, link) {
+		if (!(peer->flags & RDP_PEER_ACTIVATED))
+			continue;
+
+		any_peer = true;
+		if (rdp_peer_wants_output(peer))
+			any_wants_output = true;
+	}
+
+	if (any_peer && !any_wants_output) {
+		if (!output->suppressed)
+			rdp_debug(b, "all peers suppressed output, pausing repaint\n");
+		output->suppressed = true;
+		return;
+	}
+
+	if (!output->suppressed)
+		return;
+
+	rdp_debug(b, "output allowed again, resuming repaint\n");
+	output->suppressed = false;
+
+	/* Nothing was rendered meanwhile, so peers get the whole visible
+	 * area from the first frame after resuming. */
+	wl_list_for_each(peer, &b->peers, link) {
+		if (rdp_peer_wants_output(peer))
+			peer->flags |= RDP_PEER_NEEDS_REFRESH;
+	}
+	weston_output_schedule_repaint(&output->base);
+
+	/* The skipped frame was never shown, but the repaint loop waits
+	 * for it before it can go on. */
+	if (output->frame_deferred) {
+		output->frame_deferred = false;
+		weston_compositor_read_presentation_clock(b->compositor, &ts);
+		weston_output_finish_frame(&output->base, &ts,
+					   WP_PRESENTATION_FEEDBACK_INVALID);
+	}
+}
+
 static int
-rdp_output_start_repaint_loop(struct weston_output *output)
+rdp_output_start_repaint_loop(struct weston_output *output_base)
 {
+	struct rdp_output *output = container_of(output_base, struct rdp_output, base);
 	struct timespec ts;
 
-	weston_compositor_read_presentation_clock(output->compositor, &ts);
-	weston_output_finish_frame(output, &ts, WP_PRESENTATION_FEEDBACK_INVALID);
+	/* Left waiting until rdp_output_update_suppressed() resumes it */
+	if (output->suppressed) {
+		output->frame_deferred = true;
+		return 0;
+	}
+
+	weston_compositor_read_presentation_clock(output_base->compositor, &ts);
+	weston_output_finish_frame(output_base, &ts, WP_PRESENTATION_FEEDBACK_INVALID);
 
 	return 0;
 }
@@ -284,6 +416,8 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage)
 	int refresh_nsec = millihz_to_nsec(output_base->current_mode->refresh);
 	int refresh_msec = refresh_nsec / 1000000;
 	int next_frame_delta;
+	pixman_region32_t visible;
+	pixman_region32_t render_damage;
 
 	/* Calculate the time we should complete this frame such that frames
 	   are spaced out by the specified monitor refresh. Note that our timer
@@ -301,26 +435,48 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage)
 
 	assert(output);
 
-	ec->renderer->repaint_output(&output->base, damage,
+	/* Keep all damage for the full refresh once a peer allows output
+	 * again, and hold the frame until then. */
+	if (output->suppressed) {
+		output->frame_deferred = true;
+		return 0;
+	}
+
+	/* Only render what some peer can see. The rest stays in the primary
+	 * plane damage until a peer shows it again. */
+	pixman_region32_init(&render_damage);
+	if (rdp_output_get_visible_region(output, &visible))
+		pixman_region32_intersect(&render_damage, damage, &visible);
+	else
+		pixman_region32_copy(&render_damage, damage);
+	pixman_region32_fini(&visible);
+
+	ec->renderer->repaint_output(&output->base, &render_damage,
 				     output->renderbuffer);
 
-	if (pixman_region32_not_empty(damage)) {
-		pixman_region32_t transformed_damage;
-		pixman_region32_init(&transformed_damage);
-		weston_region_global_to_output(&transformed_damage,
-					       output_base,
-					       damage);
-		wl_list_for_each(peer, &b->peers, link) {
-			if ((peer->flags & RDP_PEER_ACTIVATED) &&
-			    (peer->flags & RDP_PEER_OUTPUT_ENABLED)) {
-				rdp_peer_refresh_region(&transformed_damage, peer->peer);
-			}
-		}
-		pixman_region32_fini(&transformed_damage);
+	/* repaint_damage also covers what was left unrendered above, but
+	 * that lies outside every peer's visible area. */
+	wl_list_for_each(peer, &b->peers, link) {
+		pixman_region32_t area;
+
+		if (!rdp_peer_wants_output(peer))
+			continue;
+
+		rdp_peer_get_visible_area(peer, output, &area);
+		if (peer->flags & RDP_PEER_NEEDS_REFRESH)
+			peer->flags &= ~RDP_PEER_NEEDS_REFRESH;
+		else
+			pixman_region32_intersect(&area, &area,
+						  &output_base->repaint_damage);
+
+		if (pixman_region32_not_empty(&area))
+			rdp_peer_refresh_region(&area, peer->peer);
+		pixman_region32_fini(&area);
 	}
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
-				 &ec->primary_plane.damage, damage);
+				 &ec->primary_plane.damage, &render_damage);
+	pixman_region32_fini(&render_damage);
 
 	wl_event_source_timer_update(output->finish_frame_timer, next_frame_delta);
 	return 0;
@@ -479,6 +635,10 @@ rdp_output_disable(struct weston_output *base)
 
 	wl_event_source_remove(output->finish_frame_timer);
 
+	/* The repaint loop goes away with the output */
+	output->suppressed = false;
+	output->frame_deferred = false;
+
 	return 0;
 }
 
@@ -715,6 +875,7 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 	b = context->rdpBackend;
 
 	wl_list_remove(&context->item.link);
+	rdp_output_update_suppressed(b);
 
 	for (i = 0; i < ARRAY_LENGTH(context->events); i++) {
 		if (context->events[i])
@@ -1089,6 +1250,7 @@ xf_peer_activate(freerdp_peer* client)
 			goto error_exit;
 
 	peersItem->flags |= RDP_PEER_ACTIVATED;
+	rdp_output_update_suppressed(b);
 
 	/* disable pointer on the client side */
 	pointer = client->context->update->pointer;
@@ -1517,11 +1679,37 @@ static BOOL
 xf_suppress_output(rdpContext *context, BYTE allow, const RECTANGLE_16 *area)
 {
 	RdpPeerContext *peerContext = (RdpPeerContext *)context;
+	struct rdp_backend *b = peerContext->rdpBackend;
+	struct rdp_peers_item *peer = &peerContext->item;
+	struct rdp_output *output;
 
-	if (allow)
-		peerContext->item.flags |= RDP_PEER_OUTPUT_ENABLED;
-	else
-		peerContext->item.flags &= (~RDP_PEER_OUTPUT_ENABLED);
+	if (allow) {
+		rdp_debug(b, "peer allowed output (area %s)\n",
+			  area ? "given" : "whole desktop");
+
+		/* The rectangle is inclusive */
+		peer->has_visible_area = area != NULL;
+		if (area) {
+			peer->visible_area.x1 = area->left;
+			peer->visible_area.y1 = area->top;
+			peer->visible_area.x2 = area->right + 1;
+			peer->visible_area.y2 = area->bottom + 1;
+		}
+
+		/* The client dropped what it did not show, so it gets one
+		 * consolidated update of everything visible now. */
+		peer->flags |= RDP_PEER_OUTPUT_ENABLED | RDP_PEER_NEEDS_REFRESH;
+
+		output = rdp_get_first_output(b);
+		if (output)
+			weston_output_schedule_repaint(&output->base);
+	} else {
+		rdp_debug(b, "peer suppressed output\n");
+		peer->flags &= ~(RDP_PEER_OUTPUT_ENABLED |
+				 RDP_PEER_NEEDS_REFRESH);
+	}
+
+	rdp_output_update_suppressed(b);
 
 	return TRUE;
 }
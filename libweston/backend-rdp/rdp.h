@@ -104,6 +104,7 @@ struct rdp_backend {
 enum peer_item_flags {
 	RDP_PEER_ACTIVATED      = (1 << 0),
 	RDP_PEER_OUTPUT_ENABLED = (1 << 1),
+	RDP_PEER_NEEDS_REFRESH  = (1 << 2),
 };
 
 struct rdp_peers_item {
@@ -111,6 +112,11 @@ struct rdp_peers_item {
 	freerdp_peer *peer;
 	struct weston_seat *seat;
 
+	/* Suppress Output may leave part of the desktop visible, in output
+	 * framebuffer coordinates. Without it the whole output is. */
+	bool has_visible_area;
+	pixman_box32_t visible_area;
+
 	struct wl_list link;
 };
 
@@ -126,6 +132,11 @@ struct rdp_output {
 	struct rdp_backend *backend;
 	struct wl_event_source *finish_frame_timer;
 	struct weston_renderbuffer *renderbuffer;
+
+	/* Every connected peer has suppressed output */
+	bool suppressed;
+	/* A frame skipped while suppressed still has to be finished */
+	bool frame_deferred;
 };
 
 struct rdp_peer_context {
@@ -166,6 +177,15 @@ struct rdp_peer_context {
 
 	struct wl_listener clipboard_selection_listener;
 
+	/* Server to client clipboard data is transcoded and sent on this
+	 * thread, so large transfers don't stall the display loop. */
+	bool clipboard_worker_running;
+	bool clipboard_worker_exit;
+	pthread_t clipboard_worker_thread;
+	pthread_mutex_t clipboard_worker_mutex;
+	pthread_cond_t clipboard_worker_cond;
+	struct wl_list clipboard_worker_list; /* rdp_clipboard_data_chunk::link */
+
 	/* Multiple monitor support (monitor topology) */
 	int32_t desktop_top, desktop_left;
 	int32_t desktop_width, desktop_height;
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "rdpclip-transcode.h"
+#include "shared/helpers.h"
+
+/* Input is transcoded this many bytes at a time, so the space reserved for
+ * the worst case expansion stays small no matter the size of the data. */
+#define RDP_CLIPBOARD_TRANSCODE_CHUNK_SIZE (64 * 1024)
+
+#define REPLACEMENT_CHARACTER 0xfffd
+
+static bool
+is_surrogate(uint32_t c)
+{
+	return c >= 0xd800 && c <= 0xdfff;
+}
+
+static uint8_t *
+put_utf16le(uint8_t *p, uint32_t c)
+{
+	if (c >= 0x10000) {
+		c -= 0x10000;
+		p = put_utf16le(p, 0xd800 | (c >> 10));
+		c = 0xdc00 | (c & 0x3ff);
+	}
+
+	p[0] = c & 0xff;
+	p[1] = c >> 8;
+
+	return p + 2;
+}
+
+static uint8_t *
+put_utf8(uint8_t *p, uint32_t c)
+{
+	if (c < 0x80) {
+		*p++ = c;
+	} else if (c < 0x800) {
+		*p++ = 0xc0 | (c >> 6);
+		*p++ = 0x80 | (c & 0x3f);
+	} else if (c < 0x10000) {
+		*p++ = 0xe0 | (c >> 12);
+		*p++ = 0x80 | ((c >> 6) & 0x3f);
+		*p++ = 0x80 | (c & 0x3f);
+	} else {
+		*p++ = 0xf0 | (c >> 18);
+		*p++ = 0x80 | ((c >> 12) & 0x3f);
+		*p++ = 0x80 | ((c >> 6) & 0x3f);
+		*p++ = 0x80 | (c & 0x3f);
+	}
+
+	return p;
+}
+
+static uint8_t *
+transcode_utf8_to_utf16(struct rdp_clipboard_transcoder *transcoder,
+			const uint8_t *in, size_t size, uint8_t *p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		uint8_t b = in[i];
+
+		if (transcoder->continuation_bytes) {
+			if ((b & 0xc0) == 0x80) {
+				transcoder->codepoint <<= 6;
+				transcoder->codepoint |= b & 0x3f;
+				if (--transcoder->continuation_bytes)
+					continue;
+
+				/* reject overlong forms, surrogates and
+				 * anything beyond the Unicode range */
+				if (transcoder->codepoint < transcoder->codepoint_min ||
+				    transcoder->codepoint > 0x10ffff ||
+				    is_surrogate(transcoder->codepoint))
+					transcoder->codepoint = REPLACEMENT_CHARACTER;
+				p = put_utf16le(p, transcoder->codepoint);
+				continue;
+			}
+
+			/* truncated sequence, this byte starts over */
+			transcoder->continuation_bytes = 0;
+			p = put_utf16le(p, REPLACEMENT_CHARACTER);
+		}
+
+		if (b < 0x80) {
+			p = put_utf16le(p, b);
+		} else if (b >= 0xc2 && b <= 0xdf) {
+			transcoder->codepoint = b & 0x1f;
+			transcoder->codepoint_min = 0x80;
+			transcoder->continuation_bytes = 1;
+		} else if (b >= 0xe0 && b <= 0xef) {
+			transcoder->codepoint = b & 0x0f;
+			transcoder->codepoint_min = 0x800;
+			transcoder->continuation_bytes = 2;
+		} else if (b >= 0xf0 && b <= 0xf4) {
+			transcoder->codepoint = b & 0x07;
+			transcoder->codepoint_min = 0x10000;
+			transcoder->continuation_bytes = 3;
+		} else {
+			p = put_utf16le(p, REPLACEMENT_CHARACTER);
+		}
+	}
+
+	return p;
+}
+
+static uint8_t *
+transcode_utf16_to_utf8(struct rdp_clipboard_transcoder *transcoder,
+			const uint8_t *in, size_t size, uint8_t *p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		uint16_t unit;
+
+		if (!transcoder->has_pending_byte) {
+			transcoder->pending_byte = in[i];
+			transcoder->has_pending_byte = true;
+			continue;
+		}
+
+		transcoder->has_pending_byte = false;
+		unit = transcoder->pending_byte | (in[i] << 8);
+
+		if (transcoder->high_surrogate) {
+			if (unit >= 0xdc00 && unit <= 0xdfff) {
+				uint32_t c = 0x10000;
+
+				c += (transcoder->high_surrogate - 0xd800) << 10;
+				c += unit - 0xdc00;
+				transcoder->high_surrogate = 0;
+				p = put_utf8(p, c);
+				continue;
+			}
+
+			/* unpaired high surrogate */
+			transcoder->high_surrogate = 0;
+			p = put_utf8(p, REPLACEMENT_CHARACTER);
+		}
+
+		if (unit >= 0xd800 && unit <= 0xdbff)
+			transcoder->high_surrogate = unit;
+		else if (is_surrogate(unit))
+			p = put_utf8(p, REPLACEMENT_CHARACTER);
+		else
+			p = put_utf8(p, unit);
+	}
+
+	return p;
+}
+
+/* Grows @out so that @size more bytes can be written at its end, without
+ * accounting for them yet. */
+static uint8_t *
+reserve(struct wl_array *out, size_t size)
+{
+	uint8_t *p;
+
+	p = wl_array_add(out, size);
+	if (!p)
+		return NULL;
+	out->size -= size;
+
+	return p;
+}
+
+WESTON_EXPORT_FOR_TESTS void
+rdp_clipboard_transcoder_init(struct rdp_clipboard_transcoder *transcoder,
+			      enum rdp_clipboard_transcode_direction direction)
+{
+	*transcoder = (struct rdp_clipboard_transcoder) {
+		.direction = direction,
+	};
+}
+
+/** Transcode a chunk of input, appending the result to @out
+ *
+ * Sequences split at the end of @data are completed by the next call.
+ * Returns false if @out could not be grown, in which case @out is left
+ * as it was.
+ */
+WESTON_EXPORT_FOR_TESTS bool
+rdp_clipboard_transcoder_feed(struct rdp_clipboard_transcoder *transcoder,
+			      const void *data, size_t size,
+			      struct wl_array *out)
+{
+	uint8_t *p;
+
+	/* Either direction writes at most 4 bytes per input byte, plus
+	 * whatever completes a sequence left over from the previous call. */
+	if (size > (SIZE_MAX - 8) / 4)
+		return false;
+
+	p = reserve(out, size * 4 + 8);
+	if (!p)
+		return false;
+
+	switch (transcoder->direction) {
+	case RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16:
+		p = transcode_utf8_to_utf16(transcoder, data, size, p);
+		break;
+	case RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8:
+		p = transcode_utf16_to_utf8(transcoder, data, size, p);
+		break;
+	}
+
+	out->size = p - (uint8_t *)out->data;
+	assert(out->size <= out->alloc);
+
+	return true;
+}
+
+/** Flush the end of the input, replacing incomplete sequences
+ *
+ * The transcoder is reset and can be fed a new stream afterwards.
+ */
+WESTON_EXPORT_FOR_TESTS bool
+rdp_clipboard_transcoder_finish(struct rdp_clipboard_transcoder *transcoder,
+				struct wl_array *out)
+{
+	uint8_t *p;
+
+	p = reserve(out, 8);
+	if (!p)
+		return false;
+
+	switch (transcoder->direction) {
+	case RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16:
+		if (transcoder->continuation_bytes)
+			p = put_utf16le(p, REPLACEMENT_CHARACTER);
+		break;
+	case RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8:
+		if (transcoder->high_surrogate)
+			p = put_utf8(p, REPLACEMENT_CHARACTER);
+		if (transcoder->has_pending_byte)
+			p = put_utf8(p, REPLACEMENT_CHARACTER);
+		break;
+	}
+
+	out->size = p - (uint8_t *)out->data;
+	rdp_clipboard_transcoder_init(transcoder, transcoder->direction);
+
+	return true;
+}
+
+/** Transcode a whole buffer, appending the result to @out */
+WESTON_EXPORT_FOR_TESTS bool
+rdp_clipboard_transcode(enum rdp_clipboard_transcode_direction direction,
+			const void *data, size_t size, struct wl_array *out)
+{
+	struct rdp_clipboard_transcoder transcoder;
+	const uint8_t *in = data;
+	size_t chunk;
+
+	rdp_clipboard_transcoder_init(&transcoder, direction);
+
+	while (size) {
+		chunk = MIN(size, RDP_CLIPBOARD_TRANSCODE_CHUNK_SIZE);
+		if (!rdp_clipboard_transcoder_feed(&transcoder, in, chunk, out))
+			return false;
+		in += chunk;
+		size -= chunk;
+	}
+
+	return rdp_clipboard_transcoder_finish(&transcoder, out);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RDPCLIP_TRANSCODE_H
+#define RDPCLIP_TRANSCODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <wayland-util.h>
+
+/* Text transcoding between the Linux side of the clipboard (UTF-8) and the
+ * Windows side (CF_UNICODETEXT, UTF-16 little endian). The transcoder keeps
+ * partial sequences across calls, so data can be fed in arbitrary chunks
+ * as it arrives. Malformed input is replaced with U+FFFD, as Windows'
+ * MultiByteToWideChar() and WideCharToMultiByte() do.
+ */
+
+enum rdp_clipboard_transcode_direction {
+	RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16 = 0,
+	RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+};
+
+struct rdp_clipboard_transcoder {
+	enum rdp_clipboard_transcode_direction direction;
+
+	/* UTF-8 decoder: partially decoded code point */
+	uint32_t codepoint;
+	uint32_t codepoint_min;
+	int continuation_bytes;
+
+	/* UTF-16 decoder: odd byte and pending high surrogate */
+	bool has_pending_byte;
+	uint8_t pending_byte;
+	uint16_t high_surrogate;
+};
+
+void
+rdp_clipboard_transcoder_init(struct rdp_clipboard_transcoder *transcoder,
+			      enum rdp_clipboard_transcode_direction direction);
+
+bool
+rdp_clipboard_transcoder_feed(struct rdp_clipboard_transcoder *transcoder,
+			      const void *data, size_t size,
+			      struct wl_array *out);
+
+bool
+rdp_clipboard_transcoder_finish(struct rdp_clipboard_transcoder *transcoder,
+				struct wl_array *out);
+
+bool
+rdp_clipboard_transcode(enum rdp_clipboard_transcode_direction direction,
+			const void *data, size_t size, struct wl_array *out);
+
+#endif /* RDPCLIP_TRANSCODE_H */
@@ -33,9 +33,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <linux/input.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "rdp.h"
+#include "rdpclip-transcode.h"
 
 #include "libweston-internal.h"
 
@@ -44,6 +46,10 @@
 #define CF_PRIVATE_RTF  49309 /* fake format ID for "Rich Text Format". */
 #define CF_PRIVATE_HTML 49405 /* fake format ID for "HTML Format".*/
 
+/* Largest amount of clipboard data moved through a pipe per dispatch of the
+ * display loop, so a large transfer doesn't starve other event sources. */
+#define RDP_CLIPBOARD_CHUNK_SIZE (64 * 1024)
+
 					       /*          1           2           3           4         5         6           7         8      */
 					       /*01234567890 1 2345678901234 5 67890123456 7 89012345678901234567890 1 234567890123456789012 3 4*/
 static const char rdp_clipboard_html_header[] = "Version:0.9\r\nStartHTML:-1\r\nEndHTML:-1\r\nStartFragment:00000000\r\nEndFragment:00000000\r\n";
@@ -109,9 +115,20 @@ enum rdp_clipboard_data_source_state {
 	RDP_CLIPBOARD_SOURCE_FAILED, /* failure occured */
 };
 
+/* A piece of server clipboard data on its way to the worker. The source's
+ * own end_of_data chunk comes last and hands the source over. */
+struct rdp_clipboard_data_chunk {
+	struct wl_list link; /* RdpPeerContext::clipboard_worker_list */
+	struct rdp_clipboard_data_source *source;
+	void *data;
+	size_t size;
+	bool failed; /* only set on end_of_data */
+};
+
 struct rdp_clipboard_data_source {
 	struct weston_data_source base;
 	struct rdp_loop_task task_base;
+	struct rdp_clipboard_data_chunk end_of_data;
 	struct wl_event_source *transfer_event_source; /* used for read/write with pipe */
 	struct wl_array data_contents;
 	void *context;
@@ -129,6 +146,13 @@ struct rdp_clipboard_data_source {
 	bool processed_data_is_send;
 	bool is_canceled;
 	uint32_t client_format_id_table[RDP_NUM_CLIPBOARD_FORMATS];
+
+	/* UTF-8 text is transcoded by the worker as it is read, the other
+	 * formats need all of their data at once. */
+	bool is_streamed;
+	size_t streamed_size; /* read so far, display loop only */
+	struct rdp_clipboard_transcoder transcoder; /* worker only */
+	bool transcode_failed; /* worker only */
 };
 
 struct rdp_clipboard_data_request {
@@ -185,7 +209,6 @@ clipboard_process_text_utf8(struct rdp_clipboard_data_source *source, bool is_se
 
 	if (is_send) {
 		char *data = source->data_contents.data;
-		size_t data_size, data_size_in_char;
 
 		/* Linux to Windows (convert utf-8 to UNICODE) */
 		/* Include terminating NULL in size */
@@ -193,28 +216,12 @@ clipboard_process_text_utf8(struct rdp_clipboard_data_source *source, bool is_se
 		data[source->data_contents.size] = '\0';
 		source->data_contents.size++;
 
-		/* obtain size in UNICODE */
-		data_size = MultiByteToWideChar(CP_UTF8, 0,
-						data,
-						source->data_contents.size,
-						NULL, 0);
-		if (data_size < 1)
+		if (!rdp_clipboard_transcode(RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+					     data, source->data_contents.size,
+					     &data_contents))
 			goto error_return;
-
-		data_size *= 2; /* convert to size in bytes. */
-		if (!wl_array_add(&data_contents, data_size))
-			goto error_return;
-
-		/* convert to UNICODE */
-		data_size_in_char = MultiByteToWideChar(CP_UTF8, 0,
-							data,
-							source->data_contents.size,
-							data_contents.data,
-							data_size);
-		assert(data_contents.size == (data_size_in_char * 2));
 	} else {
 		/* Windows to Linux (UNICODE to utf-8) */
-		size_t data_size;
 		LPWSTR data = source->data_contents.data;
 		size_t data_size_in_char = source->data_contents.size / 2;
 
@@ -225,26 +232,10 @@ clipboard_process_text_utf8(struct rdp_clipboard_data_source *source, bool is_se
 		if (!data_size_in_char)
 			goto error_return;
 
-		/* obtain size in utf-8 */
-		data_size = WideCharToMultiByte(CP_UTF8, 0,
-						source->data_contents.data,
-						data_size_in_char,
-						NULL, 0,
-						NULL, NULL);
-		if (data_size < 1)
-			goto error_return;
-
-		if (!wl_array_add(&data_contents, data_size))
+		if (!rdp_clipboard_transcode(RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+					     data, data_size_in_char * 2,
+					     &data_contents))
 			goto error_return;
-
-		/* convert to utf-8 */
-		data_size = WideCharToMultiByte(CP_UTF8, 0,
-						source->data_contents.data,
-						data_size_in_char,
-						data_contents.data,
-						data_size,
-						NULL, NULL);
-		assert(data_contents.size == data_size);
 	}
 
 	/* swap the data_contents with new one */
@@ -753,10 +744,259 @@ clipboard_client_send_format_data_response_fail(RdpPeerContext *ctx, struct rdp_
 	/* if here failed to send response, what can we do ? */
 }
 
+/*******************************\
+ * Clipboard transcoding worker *
+\*******************************/
+
+/* The worker has sent the data to client, release the source on display loop */
+static void
+clipboard_data_source_transcoded(bool freeOnly, void *arg)
+{
+	struct rdp_clipboard_data_source *source = wl_container_of(arg, source, task_base);
+	freerdp_peer *client = (freerdp_peer *)source->context;
+	RdpPeerContext *ctx = (RdpPeerContext *)client->context;
+	struct rdp_backend *b = ctx->rdpBackend;
+
+	rdp_debug_clipboard_verbose(b, "RDP %s (%p:%s)\n",
+				    __func__, source,
+				    clipboard_data_source_state_to_string(source));
+
+	assert_compositor_thread(b);
+
+	/* nothing else refers to a source sent to client */
+	assert(source->refcount == 1);
+	clipboard_data_source_unref(source);
+}
+
+/* Transcode the last of a streamed source, runs on the worker */
+static bool
+clipboard_process_streamed_source(struct rdp_clipboard_data_source *source)
+{
+	freerdp_peer *client = (freerdp_peer *)source->context;
+	RdpPeerContext *ctx = (RdpPeerContext *)client->context;
+	struct rdp_backend *b = ctx->rdpBackend;
+	static const char terminator = '\0';
+
+	assert(!source->is_data_processed);
+
+	if (source->end_of_data.failed || source->transcode_failed ||
+	    !source->streamed_size)
+		goto error_return;
+
+	/* Include terminating NULL in size */
+	if (!rdp_clipboard_transcoder_feed(&source->transcoder, &terminator, 1,
+					   &source->data_contents) ||
+	    !rdp_clipboard_transcoder_finish(&source->transcoder,
+					     &source->data_contents))
+		goto error_return;
+
+	source->is_data_processed = true;
+	source->processed_data_is_send = true;
+	source->processed_data_start = source->data_contents.data;
+	source->processed_data_size = source->data_contents.size;
+	rdp_debug_clipboard_verbose(b, "RDP %s (%p:%s): send (%u bytes)\n",
+				    __func__, source,
+				    clipboard_data_source_state_to_string(source),
+				    (uint32_t)source->data_contents.size);
+
+	return true;
+
+error_return:
+	source->state = RDP_CLIPBOARD_SOURCE_FAILED;
+	weston_log("RDP %s FAILED (%p:%s): send (%zu bytes read)\n",
+		   __func__, source,
+		   clipboard_data_source_state_to_string(source),
+		   source->streamed_size);
+
+	return false;
+}
+
+static void *
+clipboard_worker_thread(void *arg)
+{
+	RdpPeerContext *ctx = arg;
+	struct rdp_clipboard_data_chunk *chunk;
+	struct rdp_clipboard_data_source *source;
+	bool processed;
+
+	pthread_mutex_lock(&ctx->clipboard_worker_mutex);
+	for (;;) {
+		while (wl_list_empty(&ctx->clipboard_worker_list) &&
+		       !ctx->clipboard_worker_exit)
+			pthread_cond_wait(&ctx->clipboard_worker_cond,
+					  &ctx->clipboard_worker_mutex);
+		if (ctx->clipboard_worker_exit)
+			break;
+
+		/* chunks are queued at head, so take the oldest from tail */
+		chunk = wl_container_of(ctx->clipboard_worker_list.prev,
+					chunk, link);
+		wl_list_remove(&chunk->link);
+		pthread_mutex_unlock(&ctx->clipboard_worker_mutex);
+
+		source = chunk->source;
+		if (chunk != &source->end_of_data) {
+			/* the source is still being read, only transcode */
+			if (!source->transcode_failed &&
+			    !rdp_clipboard_transcoder_feed(&source->transcoder,
+							   chunk->data,
+							   chunk->size,
+							   &source->data_contents))
+				source->transcode_failed = true;
+			free(chunk);
+
+			pthread_mutex_lock(&ctx->clipboard_worker_mutex);
+			continue;
+		}
+
+		/* process data before sending to client */
+		if (source->is_streamed)
+			processed = clipboard_process_streamed_source(source);
+		else
+			processed = clipboard_process_source(source, true);
+
+		if (processed)
+			clipboard_client_send_format_data_response(ctx, source);
+		else
+			clipboard_client_send_format_data_response_fail(ctx, source);
+
+		rdp_dispatch_task_to_display_loop(ctx, clipboard_data_source_transcoded,
+						  &source->task_base);
+
+		pthread_mutex_lock(&ctx->clipboard_worker_mutex);
+	}
+	pthread_mutex_unlock(&ctx->clipboard_worker_mutex);
+
+	return NULL;
+}
+
+/* Hand a chunk read from the server side over to the worker. Queuing the
+ * source's end_of_data also hands over the source itself, which the worker
+ * owns until clipboard_data_source_transcoded(). */
+static void
+clipboard_worker_queue(RdpPeerContext *ctx, struct rdp_clipboard_data_chunk *chunk)
+{
+	struct rdp_clipboard_data_source *source = chunk->source;
+	struct rdp_backend *b = ctx->rdpBackend;
+
+	assert_compositor_thread(b);
+	assert(source->refcount == 1);
+
+	/* the client went away while the source was still being read */
+	if (!ctx->clipboard_worker_running) {
+		if (chunk == &source->end_of_data)
+			clipboard_data_source_unref(source);
+		else
+			free(chunk);
+		return;
+	}
+
+	if (chunk == &source->end_of_data)
+		assert(!source->transfer_event_source);
+
+	pthread_mutex_lock(&ctx->clipboard_worker_mutex);
+	wl_list_insert(&ctx->clipboard_worker_list, &chunk->link);
+	pthread_cond_signal(&ctx->clipboard_worker_cond);
+	pthread_mutex_unlock(&ctx->clipboard_worker_mutex);
+}
+
+static bool
+clipboard_worker_start(RdpPeerContext *ctx)
+{
+	wl_list_init(&ctx->clipboard_worker_list);
+	ctx->clipboard_worker_exit = false;
+
+	if (pthread_mutex_init(&ctx->clipboard_worker_mutex, NULL) != 0)
+		goto error_mutex;
+
+	if (pthread_cond_init(&ctx->clipboard_worker_cond, NULL) != 0)
+		goto error_cond;
+
+	if (pthread_create(&ctx->clipboard_worker_thread, NULL,
+			   clipboard_worker_thread, ctx) != 0)
+		goto error_thread;
+
+	ctx->clipboard_worker_running = true;
+
+	return true;
+
+error_thread:
+	pthread_cond_destroy(&ctx->clipboard_worker_cond);
+error_cond:
+	pthread_mutex_destroy(&ctx->clipboard_worker_mutex);
+error_mutex:
+	weston_log("%s: failed to start clipboard worker\n", __func__);
+	return false;
+}
+
+static void
+clipboard_worker_stop(RdpPeerContext *ctx)
+{
+	struct rdp_clipboard_data_chunk *chunk, *tmp;
+
+	if (!ctx->clipboard_worker_running)
+		return;
+
+	pthread_mutex_lock(&ctx->clipboard_worker_mutex);
+	ctx->clipboard_worker_exit = true;
+	pthread_cond_signal(&ctx->clipboard_worker_cond);
+	pthread_mutex_unlock(&ctx->clipboard_worker_mutex);
+
+	/* a source being processed is finished first, and its completion
+	   is cleaned up along with the rest of the display loop tasks. */
+	pthread_join(ctx->clipboard_worker_thread, NULL);
+	ctx->clipboard_worker_running = false;
+
+	/* the client is going away, drop what it never got to see */
+	wl_list_for_each_safe(chunk, tmp, &ctx->clipboard_worker_list, link) {
+		wl_list_remove(&chunk->link);
+		if (chunk == &chunk->source->end_of_data)
+			clipboard_data_source_unref(chunk->source);
+		else
+			free(chunk);
+	}
+
+	pthread_cond_destroy(&ctx->clipboard_worker_cond);
+	pthread_mutex_destroy(&ctx->clipboard_worker_mutex);
+}
+
 /***************************************\
  * Compositor file descritor callbacks *
 \***************************************/
 
+/* Read the next chunk of a streamed source and pass it on to the worker */
+static int
+clipboard_data_source_read_chunk(RdpPeerContext *ctx,
+				 struct rdp_clipboard_data_source *source, int fd)
+{
+	struct rdp_clipboard_data_chunk *chunk;
+	int len;
+
+	chunk = malloc(sizeof *chunk + RDP_CLIPBOARD_CHUNK_SIZE);
+	if (!chunk) {
+		errno = ENOMEM;
+		return -1;
+	}
+	chunk->source = source;
+	chunk->data = chunk + 1;
+	chunk->failed = false;
+
+	do {
+		len = read(fd, chunk->data, RDP_CLIPBOARD_CHUNK_SIZE);
+	} while (len == -1 && errno == EINTR);
+
+	if (len <= 0) {
+		free(chunk);
+		return len;
+	}
+
+	chunk->size = len;
+	source->streamed_size += len;
+	clipboard_worker_queue(ctx, chunk);
+
+	return len;
+}
+
 /* Send server clipboard data to client when server side application sent them via pipe. */
 static int
 clipboard_data_source_read(int fd, uint32_t mask, void *arg)
@@ -766,7 +1006,6 @@ clipboard_data_source_read(int fd, uint32_t mask, void *arg)
 	RdpPeerContext *ctx = (RdpPeerContext *)client->context;
 	struct rdp_backend *b = ctx->rdpBackend;
 	int len;
-	bool failed = true;
 
 	rdp_debug_clipboard_verbose(b, "RDP %s (%p:%s) fd:%d\n",
 				    __func__, source,
@@ -784,7 +1023,10 @@ clipboard_data_source_read(int fd, uint32_t mask, void *arg)
 
 	source->state = RDP_CLIPBOARD_SOURCE_TRANSFERING;
 
-	len = rdp_wl_array_read_fd(&source->data_contents, fd);
+	if (source->is_streamed)
+		len = clipboard_data_source_read_chunk(ctx, source, fd);
+	else
+		len = rdp_wl_array_read_fd(&source->data_contents, fd);
 	if (len < 0) {
 		source->state = RDP_CLIPBOARD_SOURCE_FAILED;
 		weston_log("RDP %s (%p:%s) read failed (%s)\n",
@@ -798,29 +1040,48 @@ clipboard_data_source_read(int fd, uint32_t mask, void *arg)
 		rdp_debug_clipboard_verbose(b, "RDP %s (%p:%s) read (%zu bytes)\n",
 					    __func__, source,
 					    clipboard_data_source_state_to_string(source),
-					    source->data_contents.size);
+					    source->is_streamed ? source->streamed_size :
+								  source->data_contents.size);
 		/* continue to read next batch */
 		return 0;
 	}
 
 	/* len == 0, all data from source is read, so completed. */
 	source->state = RDP_CLIPBOARD_SOURCE_TRANSFERRED;
-	rdp_debug_clipboard(b, "RDP %s (%p:%s): read completed (%ld bytes)\n",
+	rdp_debug_clipboard(b, "RDP %s (%p:%s): read completed (%zu bytes)\n",
 			    __func__, source,
 			    clipboard_data_source_state_to_string(source),
-			    source->data_contents.size);
-	if (!source->data_contents.size)
-		goto error_exit;
-	/* process data before sending to client */
-	if (!clipboard_process_source(source, true))
+			    source->is_streamed ? source->streamed_size :
+						  source->data_contents.size);
+	if (!source->is_streamed && !source->data_contents.size)
 		goto error_exit;
 
-	clipboard_client_send_format_data_response(ctx, source);
-	failed = false;
+	/* all data is in, stop watching the pipe */
+	wl_event_source_remove(source->transfer_event_source);
+	source->transfer_event_source = NULL;
+	close(source->data_source_fd);
+	source->data_source_fd = -1;
+
+	/* process data and send it to client off the display loop,
+	   the worker hands the source back when done. */
+	clipboard_worker_queue(ctx, &source->end_of_data);
+	return 0;
 
 error_exit:
-	if (failed)
-		clipboard_client_send_format_data_response_fail(ctx, source);
+	if (source->is_streamed) {
+		/* the worker may still hold earlier chunks, let it fail
+		   the request once it is through them. */
+		wl_event_source_remove(source->transfer_event_source);
+		source->transfer_event_source = NULL;
+		close(source->data_source_fd);
+		source->data_source_fd = -1;
+
+		source->end_of_data.failed = true;
+		clipboard_worker_queue(ctx, &source->end_of_data);
+		return 0;
+	}
+
+	clipboard_client_send_format_data_response_fail(ctx, source);
 
 	/* make sure this is the last reference, so event source is removed at unref */
 	assert(source->refcount == 1);
@@ -936,7 +1197,8 @@ clipboard_data_source_write(int fd, uint32_t mask, void *arg)
 	while (data_to_write && data_size) {
 		source->state = RDP_CLIPBOARD_SOURCE_TRANSFERING;
 		do {
-			size = write(source->data_source_fd, data_to_write, data_size);
+			size = write(source->data_source_fd, data_to_write,
+				     MIN(data_size, RDP_CLIPBOARD_CHUNK_SIZE));
 		} while (size == -1 && errno == EINTR);
 
 		if (size <= 0) {
@@ -961,7 +1223,14 @@ clipboard_data_source_write(int fd, uint32_t mask, void *arg)
 						    __func__, source,
 						    clipboard_data_source_state_to_string(source),
 						    size, data_size);
-			if (!data_size) {
+			if (data_size) {
+				/* yield to the display loop, the rest is written
+				   when data_source_fd is dispatched again */
+				source->inflight_data_to_write = data_to_write;
+				source->inflight_data_size = data_size;
+				source->inflight_write_count++;
+				return 0;
+			} else {
 				source->state = RDP_CLIPBOARD_SOURCE_TRANSFERRED;
 				rdp_debug_clipboard(b, "RDP %s (%p:%s) write completed (%ld bytes)\n",
 						    __func__, source,
@@ -1281,6 +1550,12 @@ clipboard_data_source_request(bool freeOnly, void *arg)
 	source->refcount = 1; /* decremented when data sent to client. */
 	source->data_source_fd = -1;
 	source->format_index = index;
+	source->end_of_data.source = source;
+	source->is_streamed =
+		clipboard_supported_formats[index].format_id == CF_UNICODETEXT;
+	if (source->is_streamed)
+		rdp_clipboard_transcoder_init(&source->transcoder,
+					      RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16);
 
 	if (pipe2(p, O_CLOEXEC) == -1)
 		goto error_exit_free_source;
@@ -1583,9 +1858,17 @@ clipboard_client_format_data_response(CliprdrServerContext *context, const CLIPR
 			source->data_contents.size = formatDataResponse->dataLen;
 			/* regardless data type, make sure it ends with NULL */
 			((char *)source->data_contents.data)[source->data_contents.size] = '\0';
-			/* data is ready, waiting to be written to destination */
-			source->state = RDP_CLIPBOARD_SOURCE_RECEIVED_DATA;
-			success = true;
+			/* process data here on FreeRDP thread, so the display
+			   loop only needs to write it to destination */
+			success = clipboard_process_source(source, false);
+			if (success) {
+				/* data is ready, waiting to be written to destination */
+				source->state = RDP_CLIPBOARD_SOURCE_RECEIVED_DATA;
+			} else {
+				/* don't keep data which can't be delivered */
+				wl_array_release(&source->data_contents);
+				wl_array_init(&source->data_contents);
+			}
 		} else {
 			source->state = RDP_CLIPBOARD_SOURCE_FAILED;
 		}
@@ -1687,6 +1970,9 @@ rdp_clipboard_init(freerdp_peer *client)
 	if (!ctx->clipboard_server_context)
 		goto error;
 
+	if (!clipboard_worker_start(ctx))
+		goto error;
+
 	clip_ctx = ctx->clipboard_server_context;
 	clip_ctx->custom = (void *)client;
 	clip_ctx->TempDirectory = clipboard_client_temp_directory;
@@ -1713,6 +1999,8 @@ rdp_clipboard_init(freerdp_peer *client)
 	return 0;
 
 error:
+	clipboard_worker_stop(ctx);
+
 	if (ctx->clipboard_server_context) {
 		cliprdr_server_context_free(ctx->clipboard_server_context);
 		ctx->clipboard_server_context = NULL;
@@ -1734,6 +2022,9 @@ rdp_clipboard_destroy(RdpPeerContext *ctx)
 		ctx->clipboard_selection_listener.notify = NULL;
 	}
 
+	/* worker may still be sending to client, so stop it first */
+	clipboard_worker_stop(ctx);
+
 	if (ctx->clipboard_inflight_client_data_source) {
 		data_source = ctx->clipboard_inflight_client_data_source;
 		ctx->clipboard_inflight_client_data_source = NULL;
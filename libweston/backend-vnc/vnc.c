@@ -93,6 +93,9 @@ struct vnc_peer {
 	struct weston_seat *seat;
 	struct nvnc_client *client;
 
+	/* built from the seat keymap, rebuilt when that changes */
+	struct weston_keysym_index *keysym_index;
+
 	enum nvnc_button_mask last_button_mask;
 	struct wl_list link;
 };
@@ -270,17 +273,49 @@ struct vnc_keysym_to_keycode key_translation[] = {
 	{ },
 };
 
+static bool
+vnc_peer_lookup_keysym(struct vnc_peer *peer, uint32_t keysym,
+		       uint32_t *key, uint32_t *mods)
+{
+	struct weston_keyboard *keyboard = weston_seat_get_keyboard(peer->seat);
+	struct xkb_keymap *keymap = keyboard->xkb_info->keymap;
+	int i;
+
+	if (!peer->keysym_index ||
+	    weston_keysym_index_get_keymap(peer->keysym_index) != keymap) {
+		weston_keysym_index_destroy(peer->keysym_index);
+		peer->keysym_index = weston_keysym_index_create(keymap);
+	}
+
+	if (peer->keysym_index &&
+	    weston_keysym_index_lookup(peer->keysym_index, keysym, key, mods))
+		return true;
+
+	/* Fall back to the keys a US layout has */
+	for (i = 0; key_translation[i].keysym; i++) {
+		if (key_translation[i].keysym == keysym) {
+			*key = key_translation[i].code;
+			*mods = key_translation[i].shift ?
+				WESTON_KEYSYM_INDEX_MOD_SHIFT : 0;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static void
 vnc_handle_key_event(struct nvnc_client *client, uint32_t keysym,
 		     bool is_pressed)
 {
 	struct vnc_peer *peer = nvnc_get_userdata(client);
 	uint32_t key = 0;
-	bool needs_shift = false;
+	uint32_t mods = 0;
+	uint32_t shift_key = KEY_LEFTSHIFT;
+	uint32_t level3_key = KEY_RIGHTALT;
 	enum weston_key_state_update state_update;
 	enum wl_keyboard_key_state state;
 	struct timespec time;
-	int i;
 
 	weston_compositor_get_time(&time);
 
@@ -289,8 +324,10 @@ vnc_handle_key_event(struct nvnc_client *client, uint32_t keysym,
 	else
 		state = WL_KEYBOARD_KEY_STATE_RELEASED;
 
-	/* Generally ignore shift state as per RFC6143 Section 7.5.4 */
-	if (keysym == XKB_KEY_Shift_L || keysym == XKB_KEY_Shift_R)
+	/* Generally ignore shift state as per RFC6143 Section 7.5.4, the
+	 * keysyms already carry the level. AltGr is the same for us. */
+	if (keysym == XKB_KEY_Shift_L || keysym == XKB_KEY_Shift_R ||
+	    keysym == XKB_KEY_ISO_Level3_Shift)
 		return;
 
 	/* Allow selected modifiers */
@@ -300,32 +337,39 @@ vnc_handle_key_event(struct nvnc_client *client, uint32_t keysym,
 	else
 		state_update = STATE_UPDATE_NONE;
 
-	for (i = 0; key_translation[i].keysym; i++) {
-		if (key_translation[i].keysym == keysym) {
-			key = key_translation[i].code;
-			needs_shift = key_translation[i].shift;
-			break;
-		}
-	}
-
-	if (!key) {
+	if (!vnc_peer_lookup_keysym(peer, keysym, &key, &mods)) {
 		weston_log("Key not found: keysym %08x, translated %08x\n",
 			    keysym, key);
 		return;
 	}
 
-	/* emulate lshift press */
-	if (needs_shift)
-		notify_key(peer->seat, &time, KEY_LEFTSHIFT,
+	if (peer->keysym_index) {
+		shift_key = weston_keysym_index_get_modifier_key(peer->keysym_index,
+								 WESTON_KEYSYM_INDEX_MOD_SHIFT);
+		level3_key = weston_keysym_index_get_modifier_key(peer->keysym_index,
+								  WESTON_KEYSYM_INDEX_MOD_LEVEL3);
+	}
+
+	/* emulate shift and level 3 press */
+	if (mods & WESTON_KEYSYM_INDEX_MOD_SHIFT)
+		notify_key(peer->seat, &time, shift_key,
+			   WL_KEYBOARD_KEY_STATE_PRESSED,
+			   STATE_UPDATE_AUTOMATIC);
+	if (mods & WESTON_KEYSYM_INDEX_MOD_LEVEL3)
+		notify_key(peer->seat, &time, level3_key,
 			   WL_KEYBOARD_KEY_STATE_PRESSED,
 			   STATE_UPDATE_AUTOMATIC);
 
 	/* send detected key code */
 	notify_key(peer->seat, &time, key, state, state_update);
 
-	/* emulate lshift release */
-	if (needs_shift)
-		notify_key(peer->seat, &time, KEY_LEFTSHIFT,
+	/* emulate level 3 and shift release */
+	if (mods & WESTON_KEYSYM_INDEX_MOD_LEVEL3)
+		notify_key(peer->seat, &time, level3_key,
+			   WL_KEYBOARD_KEY_STATE_RELEASED,
+			   STATE_UPDATE_AUTOMATIC);
+	if (mods & WESTON_KEYSYM_INDEX_MOD_SHIFT)
+		notify_key(peer->seat, &time, shift_key,
 			   WL_KEYBOARD_KEY_STATE_RELEASED,
 			   STATE_UPDATE_AUTOMATIC);
 }
@@ -427,6 +471,7 @@ vnc_client_cleanup(struct nvnc_client *client)
 	struct vnc_output *output = peer->backend->output;
 
 	wl_list_remove(&peer->link);
+	weston_keysym_index_destroy(peer->keysym_index);
 	weston_seat_release_keyboard(peer->seat);
 	weston_seat_release_pointer(peer->seat);
 	weston_seat_release(peer->seat);
@@ -518,13 +563,11 @@ vnc_output_update_cursor(struct vnc_output *output)
 }
 
 /*
- * Convert damage rectangles from 32-bit global coordinates to 16-bit local
- * coordinates. The output transformation has to be a pure translation.
+ * Convert damage rectangles from 32-bit to 16-bit regions, both in output
+ * coordinates.
  */
 static void
-vnc_region_global_to_output(pixman_region16_t *dst,
-			    struct weston_output *output,
-			    pixman_region32_t *src)
+vnc_region32_to_region16(pixman_region16_t *dst, pixman_region32_t *src)
 {
 	struct pixman_box32 *src_rects;
 	struct pixman_box16 *dest_rects;
@@ -538,10 +581,10 @@ vnc_region_global_to_output(pixman_region16_t *dst,
 	dest_rects = xcalloc(n_rects, sizeof(*dest_rects));
 
 	for (i = 0; i < n_rects; i++) {
-		dest_rects[i].x1 = src_rects[i].x1 - output->x;
-		dest_rects[i].y1 = src_rects[i].y1 - output->y;
-		dest_rects[i].x2 = src_rects[i].x2 - output->x;
-		dest_rects[i].y2 = src_rects[i].y2 - output->y;
+		dest_rects[i].x1 = src_rects[i].x1;
+		dest_rects[i].y1 = src_rects[i].y1;
+		dest_rects[i].x2 = src_rects[i].x2;
+		dest_rects[i].y2 = src_rects[i].y2;
 	}
 
 	pixman_region_init_rects(dst, dest_rects, n_rects);
@@ -631,9 +674,8 @@ vnc_update_buffer(struct nvnc_display *display, struct pixman_region32 *damage)
 
 	ec->renderer->repaint_output(&output->base, damage, renderbuffer);
 
-	/* Convert to local coordinates */
 	pixman_region_init(&local_damage);
-	vnc_region_global_to_output(&local_damage, &output->base, damage);
+	vnc_region32_to_region16(&local_damage, &output->base.repaint_damage);
 
 	nvnc_display_feed_buffer(output->display, fb, &local_damage);
 	nvnc_fb_unref(fb);
@@ -448,12 +448,12 @@ x11_output_repaint_gl(struct weston_output *output_base,
 	return 0;
 }
 
+/* Clip to the damage being repainted, already in output coordinates */
 static void
-set_clip_for_output(struct weston_output *output_base, pixman_region32_t *region)
+set_clip_for_output(struct weston_output *output_base)
 {
 	struct x11_output *output = to_x11_output(output_base);
 	struct x11_backend *b;
-	pixman_region32_t transformed_region;
 	pixman_box32_t *rects;
 	xcb_rectangle_t *output_rects;
 	xcb_void_cookie_t cookie;
@@ -465,18 +465,12 @@ set_clip_for_output(struct weston_output *output_base, pixman_region32_t *region
 
 	b = output->backend;
 
-	pixman_region32_init(&transformed_region);
-	weston_region_global_to_output(&transformed_region,
-				       output_base,
-				       region);
-
-	rects = pixman_region32_rectangles(&transformed_region, &nrects);
+	rects = pixman_region32_rectangles(&output_base->repaint_damage,
+					   &nrects);
 	output_rects = calloc(nrects, sizeof(xcb_rectangle_t));
 
-	if (output_rects == NULL) {
-		pixman_region32_fini(&transformed_region);
+	if (output_rects == NULL)
 		return;
-	}
 
 	for (i = 0; i < nrects; i++) {
 		output_rects[i].x = rects[i].x1;
@@ -485,8 +479,6 @@ set_clip_for_output(struct weston_output *output_base, pixman_region32_t *region
 		output_rects[i].height = rects[i].y2 - rects[i].y1;
 	}
 
-	pixman_region32_fini(&transformed_region);
-
 	cookie = xcb_set_clip_rectangles_checked(b->conn, XCB_CLIP_ORDERING_UNSORTED,
 					output->gc,
 					0, 0, nrects,
@@ -524,7 +516,7 @@ x11_output_repaint_shm(struct weston_output *output_base,
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
-	set_clip_for_output(output_base, damage);
+	set_clip_for_output(output_base);
 	cookie = xcb_shm_put_image_checked(b->conn, output->window, output->gc,
 					pixman_image_get_width(image),
 					pixman_image_get_height(image),
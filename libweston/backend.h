@@ -225,6 +225,32 @@ notify_pointer_focus(struct weston_seat *seat, struct weston_output *output,
 void
 clear_pointer_focus(struct weston_seat *seat);
 
+/* Keysym to key code lookup, for backends whose clients send keysyms */
+
+enum weston_keysym_index_mods {
+	WESTON_KEYSYM_INDEX_MOD_SHIFT  = (1 << 0),
+	WESTON_KEYSYM_INDEX_MOD_LEVEL3 = (1 << 1),
+};
+
+struct weston_keysym_index;
+
+struct weston_keysym_index *
+weston_keysym_index_create(struct xkb_keymap *keymap);
+
+void
+weston_keysym_index_destroy(struct weston_keysym_index *index);
+
+struct xkb_keymap *
+weston_keysym_index_get_keymap(const struct weston_keysym_index *index);
+
+uint32_t
+weston_keysym_index_get_modifier_key(const struct weston_keysym_index *index,
+				     enum weston_keysym_index_mods mod);
+
+bool
+weston_keysym_index_lookup(const struct weston_keysym_index *index,
+			   uint32_t keysym, uint32_t *key, uint32_t *mods);
+
 /* weston_touch_device */
 
 void
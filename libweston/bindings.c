@@ -31,6 +31,7 @@
 
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
+#include "shared/hash.h"
 #include "shared/helpers.h"
 #include "shared/timespec-util.h"
 #include "tablet-unstable-v2-server-protocol.h"
@@ -43,8 +44,129 @@ struct weston_binding {
 	void *handler;
 	void *data;
 	struct wl_list link;
+
+	struct weston_binding_index *index;	/* NULL if not indexed */
+	uint32_t code;
+	struct wl_list index_link;	/* weston_binding_bucket::binding_list */
+};
+
+/* Key, button and axis bindings are also indexed by code and modifier, so
+ * that an input event only looks at the bindings it can trigger. Codes
+ * without any binding are turned away before hashing.
+ *
+ * A bucket keeps its bindings in registration order. Buckets live as long
+ * as the index, so a handler destroying bindings cannot free the bucket
+ * being dispatched from.
+ */
+struct weston_binding_index {
+	struct hash_table *buckets;
+	uint32_t code_count[KEY_CNT];
+};
+
+struct weston_binding_bucket {
+	struct wl_list binding_list;	/* weston_binding::index_link */
 };
 
+static uint32_t
+binding_hash(uint32_t code, uint32_t modifier)
+{
+	/* Colliding bindings merely share a bucket, dispatch compares both
+	 * the code and the modifier anyway. */
+	return (code << 8) ^ modifier;
+}
+
+static int
+weston_binding_index_add(struct weston_binding_index **indexp,
+			 struct weston_binding *binding, uint32_t code)
+{
+	struct weston_binding_index *index = *indexp;
+	struct weston_binding_bucket *bucket;
+	uint32_t hash = binding_hash(code, binding->modifier);
+
+	if (!index) {
+		index = zalloc(sizeof *index);
+		if (!index)
+			return -1;
+		index->buckets = hash_table_create();
+		if (!index->buckets) {
+			free(index);
+			return -1;
+		}
+		*indexp = index;
+	}
+
+	bucket = hash_table_lookup(index->buckets, hash);
+	if (!bucket) {
+		bucket = zalloc(sizeof *bucket);
+		if (!bucket)
+			return -1;
+		wl_list_init(&bucket->binding_list);
+		if (hash_table_insert(index->buckets, hash, bucket) < 0) {
+			free(bucket);
+			return -1;
+		}
+	}
+
+	binding->index = index;
+	binding->code = code;
+	wl_list_insert(bucket->binding_list.prev, &binding->index_link);
+	if (code < KEY_CNT)
+		index->code_count[code]++;
+
+	return 0;
+}
+
+static void
+weston_binding_index_remove(struct weston_binding *binding)
+{
+	struct weston_binding_index *index = binding->index;
+
+	if (!index)
+		return;
+
+	wl_list_remove(&binding->index_link);
+	if (binding->code < KEY_CNT)
+		index->code_count[binding->code]--;
+	binding->index = NULL;
+}
+
+static struct wl_list *
+weston_binding_index_lookup(struct weston_binding_index *index,
+			    uint32_t code, uint32_t modifier)
+{
+	struct weston_binding_bucket *bucket;
+
+	if (!index)
+		return NULL;
+
+	if (code < KEY_CNT && index->code_count[code] == 0)
+		return NULL;
+
+	bucket = hash_table_lookup(index->buckets,
+				   binding_hash(code, modifier));
+	if (!bucket)
+		return NULL;
+
+	return &bucket->binding_list;
+}
+
+static void
+free_bucket(void *element, void *data)
+{
+	free(element);
+}
+
+void
+weston_binding_index_destroy(struct weston_binding_index *index)
+{
+	if (!index)
+		return;
+
+	hash_table_for_each(index->buckets, free_bucket, NULL);
+	hash_table_destroy(index->buckets);
+	free(index);
+}
+
 static struct weston_binding *
 weston_compositor_add_binding(struct weston_compositor *compositor,
 			      uint32_t key, uint32_t button, uint32_t axis,
@@ -62,6 +184,8 @@ weston_compositor_add_binding(struct weston_compositor *compositor,
 	binding->modifier = modifier;
 	binding->handler = handler;
 	binding->data = data;
+	binding->index = NULL;
+	wl_list_init(&binding->index_link);
 
 	return binding;
 }
@@ -80,6 +204,12 @@ weston_compositor_add_key_binding(struct weston_compositor *compositor,
 	if (binding == NULL)
 		return NULL;
 
+	if (weston_binding_index_add(&compositor->key_binding_index,
+				     binding, key) < 0) {
+		free(binding);
+		return NULL;
+	}
+
 	wl_list_insert(compositor->key_binding_list.prev, &binding->link);
 
 	return binding;
@@ -117,6 +247,12 @@ weston_compositor_add_button_binding(struct weston_compositor *compositor,
 	if (binding == NULL)
 		return NULL;
 
+	if (weston_binding_index_add(&compositor->button_binding_index,
+				     binding, button) < 0) {
+		free(binding);
+		return NULL;
+	}
+
 	wl_list_insert(compositor->button_binding_list.prev, &binding->link);
 
 	return binding;
@@ -173,6 +309,12 @@ weston_compositor_add_axis_binding(struct weston_compositor *compositor,
 	if (binding == NULL)
 		return NULL;
 
+	if (weston_binding_index_add(&compositor->axis_binding_index,
+				     binding, axis) < 0) {
+		free(binding);
+		return NULL;
+	}
+
 	wl_list_insert(compositor->axis_binding_list.prev, &binding->link);
 
 	return binding;
@@ -197,6 +339,7 @@ weston_compositor_add_debug_binding(struct weston_compositor *compositor,
 WL_EXPORT void
 weston_binding_destroy(struct weston_binding *binding)
 {
+	weston_binding_index_remove(binding);
 	wl_list_remove(&binding->link);
 	free(binding);
 }
@@ -316,6 +459,7 @@ weston_compositor_run_key_binding(struct weston_compositor *compositor,
 	struct weston_binding *b, *tmp;
 	struct weston_surface *focus;
 	struct weston_seat *seat = keyboard->seat;
+	struct wl_list *bucket;
 
 	if (state == WL_KEYBOARD_KEY_STATE_RELEASED)
 		return;
@@ -324,7 +468,12 @@ weston_compositor_run_key_binding(struct weston_compositor *compositor,
 	wl_list_for_each(b, &compositor->modifier_binding_list, link)
 		b->key = key;
 
-	wl_list_for_each_safe(b, tmp, &compositor->key_binding_list, link) {
+	bucket = weston_binding_index_lookup(compositor->key_binding_index,
+					     key, seat->modifier_state);
+	if (!bucket)
+		return;
+
+	wl_list_for_each_safe(b, tmp, bucket, index_link) {
 		if (b->key == key && b->modifier == seat->modifier_state) {
 			weston_key_binding_handler_t handler = b->handler;
 			focus = keyboard->focus;
@@ -382,6 +531,7 @@ weston_compositor_run_button_binding(struct weston_compositor *compositor,
 				     enum wl_pointer_button_state state)
 {
 	struct weston_binding *b, *tmp;
+	struct wl_list *bucket;
 
 	if (state == WL_POINTER_BUTTON_STATE_RELEASED)
 		return;
@@ -390,7 +540,13 @@ weston_compositor_run_button_binding(struct weston_compositor *compositor,
 	wl_list_for_each(b, &compositor->modifier_binding_list, link)
 		b->key = button;
 
-	wl_list_for_each_safe(b, tmp, &compositor->button_binding_list, link) {
+	bucket = weston_binding_index_lookup(compositor->button_binding_index,
+					     button,
+					     pointer->seat->modifier_state);
+	if (!bucket)
+		return;
+
+	wl_list_for_each_safe(b, tmp, bucket, index_link) {
 		if (b->button == button &&
 		    b->modifier == pointer->seat->modifier_state) {
 			weston_button_binding_handler_t handler = b->handler;
@@ -444,12 +600,19 @@ weston_compositor_run_axis_binding(struct weston_compositor *compositor,
 				   struct weston_pointer_axis_event *event)
 {
 	struct weston_binding *b, *tmp;
+	struct wl_list *bucket;
 
 	/* Invalidate all active modifier bindings. */
 	wl_list_for_each(b, &compositor->modifier_binding_list, link)
 		b->key = event->axis;
 
-	wl_list_for_each_safe(b, tmp, &compositor->axis_binding_list, link) {
+	bucket = weston_binding_index_lookup(compositor->axis_binding_index,
+					     event->axis,
+					     pointer->seat->modifier_state);
+	if (!bucket)
+		return 0;
+
+	wl_list_for_each_safe(b, tmp, bucket, index_link) {
 		if (b->axis == event->axis &&
 		    b->modifier == pointer->seat->modifier_state) {
 			weston_axis_binding_handler_t handler = b->handler;
@@ -42,6 +42,7 @@
 #include <sys/socket.h>
 #include <sys/utsname.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <math.h>
 #include <linux/input.h>
@@ -228,21 +229,49 @@ weston_paint_node_destroy(struct weston_paint_node *pnode)
 	free(pnode);
 }
 
-/** Send wl_output events for mode and scale changes
+/* Output changes an output layout transaction holds back until commit */
+enum weston_output_layout_change {
+	WESTON_OUTPUT_LAYOUT_MOVED	= (1 << 0),
+	WESTON_OUTPUT_LAYOUT_MODE	= (1 << 1),
+	WESTON_OUTPUT_LAYOUT_SCALE	= (1 << 2),
+	WESTON_OUTPUT_LAYOUT_RESIZED	= (1 << 3),
+	WESTON_OUTPUT_LAYOUT_DAMAGE	= (1 << 4),
+};
+
+/** Send wl_output and xdg_output events for output layout changes
  *
  * \param head Send on all resources bound to this head.
- * \param mode_changed If true, send the current mode.
- * \param scale_changed If true, send the current scale.
+ * \param changes Bitmask of enum weston_output_layout_change; the position
+ * is sent if moved, the mode and scale if they changed.
+ *
+ * Everything is followed by a single done event per resource.
  */
 static void
-weston_mode_switch_send_events(struct weston_head *head,
-			       bool mode_changed, bool scale_changed)
+weston_head_send_layout_events(struct weston_head *head, uint32_t changes)
 {
 	struct weston_output *output = head->output;
 	struct wl_resource *resource;
+	bool moved = changes & WESTON_OUTPUT_LAYOUT_MOVED;
+	bool mode_changed = changes & WESTON_OUTPUT_LAYOUT_MODE;
+	bool scale_changed = changes & WESTON_OUTPUT_LAYOUT_SCALE;
 	int version;
 
+	if (!moved && !mode_changed && !scale_changed)
+		return;
+
 	wl_resource_for_each(resource, &head->resource_list) {
+		if (moved) {
+			wl_output_send_geometry(resource,
+						output->x,
+						output->y,
+						head->mm_width,
+						head->mm_height,
+						head->subpixel,
+						head->make,
+						head->model,
+						output->transform);
+		}
+
 		if (mode_changed) {
 			wl_output_send_mode(resource,
 					    output->current_mode->flags,
@@ -255,11 +284,13 @@ weston_mode_switch_send_events(struct weston_head *head,
 		if (version >= WL_OUTPUT_SCALE_SINCE_VERSION && scale_changed)
 			wl_output_send_scale(resource, output->current_scale);
 
-		if (version >= WL_OUTPUT_NAME_SINCE_VERSION)
-			wl_output_send_name(resource, head->name);
+		if (mode_changed || scale_changed) {
+			if (version >= WL_OUTPUT_NAME_SINCE_VERSION)
+				wl_output_send_name(resource, head->name);
 
-		if (version >= WL_OUTPUT_DESCRIPTION_SINCE_VERSION)
-			wl_output_send_description(resource, head->model);
+			if (version >= WL_OUTPUT_DESCRIPTION_SINCE_VERSION)
+				wl_output_send_description(resource, head->model);
+		}
 
 		if (version >= WL_OUTPUT_DONE_SINCE_VERSION)
 			wl_output_send_done(resource);
@@ -268,13 +299,27 @@ weston_mode_switch_send_events(struct weston_head *head,
 		zxdg_output_v1_send_logical_position(resource,
 						     output->x,
 						     output->y);
-		zxdg_output_v1_send_logical_size(resource,
-						 output->width,
-						 output->height);
+		if (mode_changed || scale_changed) {
+			zxdg_output_v1_send_logical_size(resource,
+							 output->width,
+							 output->height);
+		}
 		zxdg_output_v1_send_done(resource);
 	}
 }
 
+/* Holds back changes while an output layout transaction is open. Returns
+ * false if there is none, and the caller must apply them right away. */
+static bool
+weston_output_layout_defer(struct weston_output *output, uint32_t changes)
+{
+	if (output->compositor->output_layout_depth == 0)
+		return false;
+
+	output->layout_pending |= changes;
+	return true;
+}
+
 WL_EXPORT bool
 weston_output_contains_point(struct weston_output *output,
 			     int32_t x, int32_t y)
@@ -289,6 +334,7 @@ weston_mode_switch_finish(struct weston_output *output,
 	struct weston_seat *seat;
 	struct weston_head *head;
 	pixman_region32_t old_output_region;
+	uint32_t changes;
 
 	pixman_region32_init(&old_output_region);
 	pixman_region32_copy(&old_output_region, &output->region);
@@ -330,12 +376,20 @@ weston_mode_switch_finish(struct weston_output *output,
 	if (!mode_changed && !scale_changed)
 		return;
 
+	changes = WESTON_OUTPUT_LAYOUT_DAMAGE;
+	if (mode_changed)
+		changes |= WESTON_OUTPUT_LAYOUT_MODE;
+	if (scale_changed)
+		changes |= WESTON_OUTPUT_LAYOUT_SCALE;
+
+	if (weston_output_layout_defer(output, changes))
+		return;
+
 	weston_output_damage(output);
 
 	/* notify clients of the changes */
 	wl_list_for_each(head, &output->head_list, output_link)
-		weston_mode_switch_send_events(head,
-					       mode_changed, scale_changed);
+		weston_head_send_layout_events(head, changes);
 }
 
 static void
@@ -377,7 +431,8 @@ weston_output_mode_set_native(struct weston_output *output,
 	if (mode_changed || scale_changed) {
 		weston_compositor_reflow_outputs(output->compositor, output, output->width - old_width);
 
-		wl_signal_emit(&output->compositor->output_resized_signal, output);
+		if (!weston_output_layout_defer(output, WESTON_OUTPUT_LAYOUT_RESIZED))
+			wl_signal_emit(&output->compositor->output_resized_signal, output);
 	}
 	return 0;
 }
@@ -983,7 +1038,7 @@ weston_surface_compute_protection(struct protected_surface *psurface)
 	struct weston_output *output;
 
 	wl_list_for_each(output, &surface->compositor->output_list, link)
-		if (surface->output_mask & (1u << output->id)) {
+		if (weston_output_set_has(&surface->output_mask, output->id)) {
 			/*
 			 * If the content-protection is enabled with protection
 			 * mode as RELAXED for a surface, and if
@@ -1064,32 +1119,32 @@ weston_schedule_surface_protection_update(struct weston_compositor *compositor)
  * outputs as appropriate.
  */
 static void
-weston_surface_update_output_mask(struct weston_surface *es, uint32_t mask)
+weston_surface_update_output_mask(struct weston_surface *es,
+				  const struct weston_output_set *mask)
 {
-	uint32_t different = es->output_mask ^ mask;
-	uint32_t entered = mask & different;
-	uint32_t left = es->output_mask & different;
-	uint32_t output_bit;
 	struct weston_output *output;
 	struct weston_head *head;
+	bool entered, left;
 
-	es->output_mask = mask;
-	if (es->resource == NULL)
-		return;
-	if (different == 0)
+	if (es->resource == NULL ||
+	    weston_output_set_equal(&es->output_mask, mask)) {
+		weston_output_set_copy(&es->output_mask, mask);
 		return;
+	}
 
 	wl_list_for_each(output, &es->compositor->output_list, link) {
-		output_bit = 1u << output->id;
-		if (!(output_bit & different))
+		entered = weston_output_set_has(mask, output->id);
+		left = weston_output_set_has(&es->output_mask, output->id);
+		if (entered == left)
 			continue;
 
 		wl_list_for_each(head, &output->head_list, output_link) {
 			weston_surface_send_enter_leave(es, head,
-							output_bit & entered,
-							output_bit & left);
+							entered, left);
 		}
 	}
+	weston_output_set_copy(&es->output_mask, mask);
+
 	/*
 	 * Change in surfaces' output mask might trigger a change in its
 	 * protection.
@@ -1161,12 +1216,12 @@ weston_surface_assign_output(struct weston_surface *es)
 	struct weston_output *new_output;
 	struct weston_view *view;
 	pixman_region32_t region;
-	uint32_t max, area, mask;
+	struct weston_output_set mask = { 0 };
+	uint32_t max, area;
 	pixman_box32_t *e;
 
 	new_output = NULL;
 	max = 0;
-	mask = 0;
 	pixman_region32_init(&region);
 	wl_list_for_each(view, &es->views, surface_link) {
 		/* Only views that are visible on some layer participate in
@@ -1180,7 +1235,7 @@ weston_surface_assign_output(struct weston_surface *es)
 		e = pixman_region32_extents(&region);
 		area = (e->x2 - e->x1) * (e->y2 - e->y1);
 
-		mask |= view->output_mask;
+		weston_output_set_union(&mask, &view->output_mask);
 
 		if (area >= max) {
 			new_output = view->output;
@@ -1190,7 +1245,8 @@ weston_surface_assign_output(struct weston_surface *es)
 	pixman_region32_fini(&region);
 
 	es->output = new_output;
-	weston_surface_update_output_mask(es, mask);
+	weston_surface_update_output_mask(es, &mask);
+	weston_output_set_fini(&mask);
 }
 
 /** Recalculate which output(s) the view is displayed on
@@ -1210,12 +1266,12 @@ weston_view_assign_output(struct weston_view *ev)
 	struct weston_compositor *ec = ev->surface->compositor;
 	struct weston_output *output, *new_output;
 	pixman_region32_t region;
-	uint32_t max, area, mask;
+	uint32_t max, area;
 	pixman_box32_t *e;
 
 	new_output = NULL;
 	max = 0;
-	mask = 0;
+	weston_output_set_clear(&ev->output_mask);
 	pixman_region32_init(&region);
 	wl_list_for_each(output, &ec->output_list, link) {
 		if (output->destroying)
@@ -1228,7 +1284,7 @@ weston_view_assign_output(struct weston_view *ev)
 		area = (e->x2 - e->x1) * (e->y2 - e->y1);
 
 		if (area > 0)
-			mask |= 1u << output->id;
+			weston_output_set_add(&ev->output_mask, output->id);
 
 		if (area >= max) {
 			new_output = output;
@@ -1238,7 +1294,6 @@ weston_view_assign_output(struct weston_view *ev)
 	pixman_region32_fini(&region);
 
 	weston_view_set_output(ev, new_output);
-	ev->output_mask = mask;
 
 	weston_surface_assign_output(ev->surface);
 }
@@ -1524,7 +1579,7 @@ weston_surface_schedule_repaint(struct weston_surface *surface)
 	struct weston_output *output;
 
 	wl_list_for_each(output, &surface->compositor->output_list, link)
-		if (surface->output_mask & (1u << output->id))
+		if (weston_output_set_has(&surface->output_mask, output->id))
 			weston_output_schedule_repaint(output);
 }
 
@@ -1540,7 +1595,7 @@ weston_view_schedule_repaint(struct weston_view *view)
 	struct weston_output *output;
 
 	wl_list_for_each(output, &view->surface->compositor->output_list, link)
-		if (view->output_mask & (1u << output->id))
+		if (weston_output_set_has(&view->output_mask, output->id))
 			weston_output_schedule_repaint(output);
 }
 
@@ -2035,7 +2090,7 @@ weston_view_unmap(struct weston_view *view)
 	weston_layer_entry_remove(&view->layer_link);
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
-	view->output_mask = 0;
+	weston_output_set_clear(&view->output_mask);
 	weston_surface_assign_output(view->surface);
 
 	if (!weston_surface_is_mapped(view->surface)) {
@@ -2118,6 +2173,8 @@ weston_view_destroy(struct weston_view *view)
 
 	wl_list_remove(&view->surface_link);
 
+	weston_output_set_fini(&view->output_mask);
+
 	free(view);
 }
 
@@ -2189,6 +2246,8 @@ weston_surface_unref(struct weston_surface *surface)
 	if (surface->tear_control)
 		surface->tear_control->surface = NULL;
 
+	weston_output_set_fini(&surface->output_mask);
+
 	free(surface);
 }
 
@@ -2443,18 +2502,78 @@ weston_buffer_release_move(struct weston_buffer_release_reference *dest,
 	weston_buffer_release_reference(src, NULL);
 }
 
+struct weston_solid_buffer_entry {
+	struct weston_buffer *buffer;
+	struct wl_list link; /* weston_compositor::solid_buffer_list */
+	struct wl_listener destroy_listener;
+};
+
+static void
+weston_solid_buffer_entry_destroy(struct weston_solid_buffer_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	wl_list_remove(&entry->destroy_listener.link);
+	free(entry);
+}
+
+static void
+weston_solid_buffer_entry_handle_destroy(struct wl_listener *listener,
+					 void *data)
+{
+	struct weston_solid_buffer_entry *entry =
+		container_of(listener, struct weston_solid_buffer_entry,
+			     destroy_listener);
+
+	weston_solid_buffer_entry_destroy(entry);
+}
+
+static struct weston_buffer *
+weston_compositor_find_solid_buffer(struct weston_compositor *compositor,
+				    float r, float g, float b, float a)
+{
+	struct weston_solid_buffer_entry *entry;
+
+	wl_list_for_each(entry, &compositor->solid_buffer_list, link) {
+		struct weston_solid_buffer_values *solid =
+			&entry->buffer->solid;
+
+		if (solid->r == r && solid->g == g &&
+		    solid->b == b && solid->a == a)
+			return entry->buffer;
+	}
+
+	return NULL;
+}
+
+/** Get a reference to a solid color buffer
+ *
+ * Buffers are shared between all callers asking for the same color, along
+ * with whatever state the renderer keeps for them, so curtains and
+ * backgrounds cost one buffer per color rather than one per surface.
+ * Release the reference with weston_buffer_destroy_solid().
+ */
 WL_EXPORT struct weston_buffer_reference *
 weston_buffer_create_solid_rgba(struct weston_compositor *compositor,
 				float r, float g, float b, float a)
 {
 	struct weston_buffer_reference *ret = zalloc(sizeof(*ret));
+	struct weston_solid_buffer_entry *entry;
 	struct weston_buffer *buffer;
 
 	if (!ret)
 		return NULL;
 
+	buffer = weston_compositor_find_solid_buffer(compositor, r, g, b, a);
+	if (buffer) {
+		weston_buffer_reference(ret, buffer, BUFFER_MAY_BE_ACCESSED);
+		return ret;
+	}
+
 	buffer = zalloc(sizeof(*buffer));
-	if (!buffer) {
+	entry = zalloc(sizeof(*entry));
+	if (!buffer || !entry) {
+		free(buffer);
+		free(entry);
 		free(ret);
 		return NULL;
 	}
@@ -2478,6 +2597,12 @@ weston_buffer_create_solid_rgba(struct weston_compositor *compositor,
 	}
 	buffer->format_modifier = DRM_FORMAT_MOD_LINEAR;
 
+	entry->buffer = buffer;
+	entry->destroy_listener.notify =
+		weston_solid_buffer_entry_handle_destroy;
+	wl_signal_add(&buffer->destroy_signal, &entry->destroy_listener);
+	wl_list_insert(&compositor->solid_buffer_list, &entry->link);
+
 	weston_buffer_reference(ret, buffer, BUFFER_MAY_BE_ACCESSED);
 
 	return ret;
@@ -2759,7 +2884,8 @@ output_accumulate_damage(struct weston_output *output)
 			 z_order_link) {
 		/* Ignore views not visible on the current output */
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if (!(pnode->view->output_mask & (1u << output->id)))
+		if (!weston_output_set_has(&pnode->view->output_mask,
+					   output->id))
 			continue;
 		if (pnode->surface->touched)
 			continue;
@@ -3005,7 +3131,7 @@ weston_output_take_feedback_list(struct weston_output *output,
 	/* All views must have the flag for the flag to survive. */
 	wl_list_for_each(view, &surface->views, surface_link) {
 		/* ignore views that are not on this output at all */
-		if (view->output_mask & (1u << output->id))
+		if (weston_output_set_has(&view->output_mask, output->id))
 			flags &= view->psf_flags;
 	}
 
@@ -3022,11 +3148,8 @@ weston_output_repaint(struct weston_output *output)
 	struct weston_compositor *ec = output->compositor;
 	struct weston_paint_node *pnode;
 	struct weston_animation *animation, *next;
-	struct wl_resource *cb, *cnext;
-	struct wl_list frame_callback_list;
 	pixman_region32_t output_damage;
 	int r;
-	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
 
 	if (output->destroying)
@@ -3041,7 +3164,8 @@ weston_output_repaint(struct weston_output *output)
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if ((pnode->surface->output_mask & (1u << output->id)) == 0)
+		if (!weston_output_set_has(&pnode->surface->output_mask,
+					   output->id))
 			continue;
 
 		/*
@@ -3062,7 +3186,8 @@ weston_output_repaint(struct weston_output *output)
 		wl_list_for_each(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
 			/* TODO: turn this into assert once z_order_list is pruned. */
-			if ((pnode->view->output_mask & (1u << output->id)) == 0)
+			if (!weston_output_set_has(&pnode->view->output_mask,
+						   output->id))
 				continue;
 
 			weston_view_move_to_plane(pnode->view, &ec->primary_plane);
@@ -3070,14 +3195,15 @@ weston_output_repaint(struct weston_output *output)
 		}
 	}
 
-	wl_list_init(&frame_callback_list);
+	/* Surfaces get their frame callbacks from their primary output only,
+	 * so spanning several outputs does not make them fire twice. */
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
 		/* Note: This operation is safe to do multiple times on the
 		 * same surface.
 		 */
 		if (pnode->surface->output == output) {
-			wl_list_insert_list(&frame_callback_list,
+			wl_list_insert_list(output->frame_callback_list.prev,
 					    &pnode->surface->frame_callback_list);
 			wl_list_init(&pnode->surface->frame_callback_list);
 
@@ -3093,8 +3219,14 @@ weston_output_repaint(struct weston_output *output)
 	pixman_region32_subtract(&output_damage,
 				 &output_damage, &ec->primary_plane.clip);
 
+	/* Converted once here for all the backends and screen grabbers
+	 * wanting it in output coordinates */
+	weston_region_global_to_output(&output->repaint_damage, output,
+				       &output_damage);
+
 	r = output->repaint(output, &output_damage);
 
+	pixman_region32_clear(&output->repaint_damage);
 	pixman_region32_fini(&output_damage);
 
 	output->repaint_needed = false;
@@ -3103,12 +3235,7 @@ weston_output_repaint(struct weston_output *output)
 
 	weston_compositor_repick(ec);
 
-	frame_time_msec = timespec_to_msec(&output->frame_time);
-
-	wl_resource_for_each_safe(cb, cnext, &frame_callback_list) {
-		wl_callback_send_done(cb, frame_time_msec);
-		wl_resource_destroy(cb);
-	}
+	output->frame_callback_msec = timespec_to_msec(&output->frame_time);
 
 	wl_list_for_each_safe(animation, next, &output->animation_list, link) {
 		animation->frame_counter++;
@@ -3177,6 +3304,28 @@ err:
 	return ret;
 }
 
+/* With a virtual clock there is no timer granularity to work around, and
+ * all outputs due at the same time are repainted in the same pass anyway. */
+static void
+output_repaint_virtual_timer_arm(struct weston_compositor *compositor)
+{
+	struct weston_output *output;
+	const struct timespec *deadline = NULL;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (output->repaint_status != REPAINT_SCHEDULED)
+			continue;
+
+		if (!deadline ||
+		    timespec_sub_to_nsec(&output->next_repaint, deadline) < 0)
+			deadline = &output->next_repaint;
+	}
+
+	if (deadline)
+		weston_virtual_timer_arm(compositor->virtual_clock.repaint_timer,
+					 deadline);
+}
+
 static void
 output_repaint_timer_arm(struct weston_compositor *compositor)
 {
@@ -3185,6 +3334,11 @@ output_repaint_timer_arm(struct weston_compositor *compositor)
 	struct timespec now;
 	int64_t msec_to_next = INT64_MAX;
 
+	if (compositor->virtual_clock.mode != WESTON_VIRTUAL_CLOCK_DISABLED) {
+		output_repaint_virtual_timer_arm(compositor);
+		return;
+	}
+
 	weston_compositor_read_presentation_clock(compositor, &now);
 
 	wl_list_for_each(output, &compositor->output_list, link) {
@@ -3230,6 +3384,38 @@ weston_output_schedule_repaint_restart(struct weston_output *output)
 	weston_output_damage(output);
 }
 
+static bool
+weston_output_send_frame_callbacks(struct weston_output *output)
+{
+	struct wl_resource *cb, *cnext;
+	bool sent = false;
+
+	wl_resource_for_each_safe(cb, cnext, &output->frame_callback_list) {
+		wl_callback_send_done(cb, output->frame_callback_msec);
+		wl_resource_destroy(cb);
+		sent = true;
+	}
+
+	return sent;
+}
+
+/* Frame callbacks are held back until every output due in this pass has
+ * been repainted and flushed to the backend, then written out in one go:
+ * a client with surfaces on several outputs repainting together wakes up
+ * once, and only after the compositor is done with the frame. */
+static void
+weston_compositor_send_frame_callbacks(struct weston_compositor *compositor)
+{
+	struct weston_output *output;
+	bool sent = false;
+
+	wl_list_for_each(output, &compositor->output_list, link)
+		sent |= weston_output_send_frame_callbacks(output);
+
+	if (sent)
+		wl_display_flush_clients(compositor->wl_display);
+}
+
 static int
 output_repaint_timer_handler(void *data)
 {
@@ -3272,6 +3458,8 @@ output_repaint_timer_handler(void *data)
 	wl_list_for_each(output, &compositor->output_list, link)
 		output->repainted = false;
 
+	weston_compositor_send_frame_callbacks(compositor);
+
 	output_repaint_timer_arm(compositor);
 
 	return 0;
@@ -3359,6 +3547,9 @@ weston_output_finish_frame(struct weston_output *output,
 
 	output->frame_time = *stamp;
 
+	if (!(presented_flags & WP_PRESENTATION_FEEDBACK_INVALID))
+		wl_signal_emit(&output->present_signal, output);
+
 	/* If we're tearing just repaint right away */
 	if (presented_flags & WESTON_FINISH_FRAME_TEARING) {
 		output->next_repaint = now;
@@ -5574,12 +5765,17 @@ weston_compositor_call_heads_changed(void *data)
 
 	compositor->heads_changed_source = NULL;
 
+	/* Whatever the frontend does about this hotplug lands as one layout */
+	weston_compositor_begin_output_layout(compositor);
+
 	wl_signal_emit(&compositor->heads_changed_signal, compositor);
 
 	wl_list_for_each(head, &compositor->head_list, compositor_link) {
 		if (head->output && head->output->enabled)
 			weston_output_emit_heads_changed(head->output);
 	}
+
+	weston_compositor_commit_output_layout(compositor);
 }
 
 /** Schedule a call on idle to heads_changed callback
@@ -6383,7 +6579,40 @@ weston_region_global_to_output(pixman_region32_t *dst,
 			       struct weston_output *output,
 			       pixman_region32_t *src)
 {
-	weston_matrix_transform_region(dst, &output->matrix, src);
+	pixman_box32_t *src_rects, *dest_rects;
+	int32_t scale = output->matrix_integer.scale;
+	int32_t dx = output->matrix_integer.dx;
+	int32_t dy = output->matrix_integer.dy;
+	int nrects, i;
+
+	if (!output->matrix_integer.valid) {
+		weston_matrix_transform_region(dst, &output->matrix, src);
+		return;
+	}
+
+	if (scale == 1) {
+		if (dst != src)
+			pixman_region32_copy(dst, src);
+		pixman_region32_translate(dst, dx, dy);
+		return;
+	}
+
+	src_rects = pixman_region32_rectangles(src, &nrects);
+	dest_rects = malloc(nrects * sizeof(*dest_rects));
+	if (!dest_rects)
+		return;
+
+	/* A positive scale keeps the bands in order */
+	for (i = 0; i < nrects; i++) {
+		dest_rects[i].x1 = src_rects[i].x1 * scale + dx;
+		dest_rects[i].y1 = src_rects[i].y1 * scale + dy;
+		dest_rects[i].x2 = src_rects[i].x2 * scale + dx;
+		dest_rects[i].y2 = src_rects[i].y2 * scale + dy;
+	}
+
+	pixman_region32_clear(dst);
+	pixman_region32_init_rects(dst, dest_rects, nrects);
+	free(dest_rects);
 }
 
 WESTON_EXPORT_FOR_TESTS void
@@ -6397,6 +6626,14 @@ weston_output_update_matrix(struct weston_output *output)
 				     output->current_scale);
 
 	weston_matrix_invert(&output->inverse_matrix, &output->matrix);
+
+	/* Output transforms are scale * translate(-x, -y) plus rotation and
+	 * flipping; without the latter, regions need no matrix at all. */
+	output->matrix_integer.valid =
+		output->transform == WL_OUTPUT_TRANSFORM_NORMAL;
+	output->matrix_integer.scale = output->current_scale;
+	output->matrix_integer.dx = -output->x * output->current_scale;
+	output->matrix_integer.dy = -output->y * output->current_scale;
 }
 
 static void
@@ -6432,8 +6669,6 @@ weston_output_set_position(struct weston_output *output,
 			   struct weston_coord_global pos)
 {
 	struct weston_head *head;
-	struct wl_resource *resource;
-	int ver;
 
 	if (!output->enabled) {
 		output->x = pos.c.x;
@@ -6451,34 +6686,19 @@ weston_output_set_position(struct weston_output *output,
 
 	weston_output_update_matrix(output);
 
+	/* Views and clients learn the total move at commit. */
+	if (weston_output_layout_defer(output, WESTON_OUTPUT_LAYOUT_MOVED)) {
+		output->layout_move_x += output->move_x;
+		output->layout_move_y += output->move_y;
+		return;
+	}
+
 	/* Move views on this output. */
 	wl_signal_emit(&output->compositor->output_moved_signal, output);
 
 	/* Notify clients of the change for output position. */
-	wl_list_for_each(head, &output->head_list, output_link) {
-		wl_resource_for_each(resource, &head->resource_list) {
-			wl_output_send_geometry(resource,
-						output->x,
-						output->y,
-						head->mm_width,
-						head->mm_height,
-						head->subpixel,
-						head->make,
-						head->model,
-						output->transform);
-
-			ver = wl_resource_get_version(resource);
-			if (ver >= WL_OUTPUT_DONE_SINCE_VERSION)
-				wl_output_send_done(resource);
-		}
-
-		wl_resource_for_each(resource, &head->xdg_output_resource_list) {
-			zxdg_output_v1_send_logical_position(resource,
-							     output->x,
-							     output->y);
-			zxdg_output_v1_send_done(resource);
-		}
-	}
+	wl_list_for_each(head, &output->head_list, output_link)
+		weston_head_send_layout_events(head, WESTON_OUTPUT_LAYOUT_MOVED);
 }
 
 /**
@@ -6504,6 +6724,85 @@ weston_output_move(struct weston_output *output,
 	weston_output_set_position(output, pos);
 }
 
+/** Start batching output layout changes
+ *
+ * \param compositor The compositor instance.
+ *
+ * Until the matching weston_compositor_commit_output_layout(), enabling,
+ * disabling, moving and mode changes of outputs update the output geometry
+ * right away, but hold back their side effects: the output moved and
+ * resized signals, damage, re-assigning views to outputs and the
+ * wl_output and xdg_output events. The commit applies them once, for the
+ * final layout, rather than for every intermediate one.
+ *
+ * Transactions nest; only the outermost commit applies the changes.
+ * The heads_changed hook always runs inside a transaction.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_begin_output_layout(struct weston_compositor *compositor)
+{
+	compositor->output_layout_depth++;
+}
+
+/** Apply the output layout changes batched since the transaction began
+ *
+ * \param compositor The compositor instance.
+ *
+ * \sa weston_compositor_begin_output_layout
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_commit_output_layout(struct weston_compositor *compositor)
+{
+	struct weston_output *output;
+	struct weston_view *view, *next;
+	struct weston_head *head;
+	uint32_t changes;
+
+	assert(compositor->output_layout_depth > 0);
+	if (--compositor->output_layout_depth > 0)
+		return;
+
+	if (compositor->output_layout_views_dirty) {
+		compositor->output_layout_views_dirty = false;
+		wl_list_for_each_safe(view, next, &compositor->view_list, link)
+			weston_view_geometry_dirty(view);
+	}
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		changes = output->layout_pending;
+		output->layout_pending = 0;
+
+		if (changes & WESTON_OUTPUT_LAYOUT_MOVED) {
+			output->move_x = output->layout_move_x;
+			output->move_y = output->layout_move_y;
+			output->layout_move_x = 0;
+			output->layout_move_y = 0;
+
+			/* moved back to where it started */
+			if (output->move_x == 0 && output->move_y == 0)
+				changes &= ~WESTON_OUTPUT_LAYOUT_MOVED;
+		}
+
+		if (!changes)
+			continue;
+
+		if (changes & WESTON_OUTPUT_LAYOUT_MOVED)
+			wl_signal_emit(&compositor->output_moved_signal, output);
+
+		if (changes & WESTON_OUTPUT_LAYOUT_RESIZED)
+			wl_signal_emit(&compositor->output_resized_signal, output);
+
+		if (changes & WESTON_OUTPUT_LAYOUT_DAMAGE)
+			weston_output_damage(output);
+
+		wl_list_for_each(head, &output->head_list, output_link)
+			weston_head_send_layout_events(head, changes);
+	}
+}
+
 /** Signal that a pending output is taken into use.
  *
  * Removes the output from the pending list and adds it to the compositor's
@@ -6527,15 +6826,12 @@ weston_compositor_add_output(struct weston_compositor *compositor,
 
 	assert(!output->enabled);
 
-	/* Verify we haven't reached the limit of 32 available output IDs */
-	assert(ffs(~compositor->output_id_pool) > 0);
-
-	/* Invert the output id pool and look for the lowest numbered
-	 * switch (the least significant bit).  Take that bit's position
-	 * as our ID, and mark it used in the compositor's output_id_pool.
+	/* Take the lowest unused ID, and mark it used in the compositor's
+	 * output_id_pool. The pool grows as needed, so there is no limit
+	 * on the number of outputs.
 	 */
-	output->id = ffs(~compositor->output_id_pool) - 1;
-	compositor->output_id_pool |= 1u << output->id;
+	output->id = weston_output_set_first_free(&compositor->output_id_pool);
+	weston_output_set_add(&compositor->output_id_pool, output->id);
 
 	wl_list_remove(&output->link);
 	wl_list_insert(compositor->output_list.prev, &output->link);
@@ -6546,6 +6842,12 @@ weston_compositor_add_output(struct weston_compositor *compositor,
 
 	wl_signal_emit(&compositor->output_created_signal, output);
 
+	/* Batched outputs share one pass over the views at commit. */
+	if (compositor->output_layout_depth > 0) {
+		compositor->output_layout_views_dirty = true;
+		return;
+	}
+
 	/*
 	 * Use view_list, as paint nodes have not been created for this
 	 * output yet. Any existing view might touch this new output.
@@ -6736,12 +7038,14 @@ weston_compositor_remove_output(struct weston_output *output)
 	}
 	assert(wl_list_empty(&output->paint_node_z_order_list));
 
+	weston_output_send_frame_callbacks(output);
+
 	/*
 	 * Use view_list in case the output did not go through repaint
 	 * after a view came on it, lacking a paint node. Just to be sure.
 	 */
 	wl_list_for_each(view, &compositor->view_list, link) {
-		if (view->output_mask & (1u << output->id))
+		if (weston_output_set_has(&view->output_mask, output->id))
 			weston_view_assign_output(view);
 	}
 
@@ -6751,6 +7055,11 @@ weston_compositor_remove_output(struct weston_output *output)
 
 	weston_compositor_reflow_outputs(compositor, output, -output->width);
 
+	/* nothing left to tell about an output that is going away */
+	output->layout_pending = 0;
+	output->layout_move_x = 0;
+	output->layout_move_y = 0;
+
 	wl_list_remove(&output->link);
 	wl_list_insert(compositor->pending_output_list.prev, &output->link);
 	output->enabled = false;
@@ -6763,7 +7072,7 @@ weston_compositor_remove_output(struct weston_output *output)
 
 	weston_output_capture_info_destroy(&output->capture_info);
 
-	compositor->output_id_pool &= ~(1u << output->id);
+	weston_output_set_remove(&compositor->output_id_pool, output->id);
 	output->id = 0xffffffff; /* invalid */
 }
 
@@ -7107,6 +7416,7 @@ weston_output_init(struct weston_output *output,
 	output->transform = UINT32_MAX;
 
 	pixman_region32_init(&output->region);
+	pixman_region32_init(&output->repaint_damage);
 	wl_list_init(&output->mode_list);
 }
 
@@ -7212,10 +7522,10 @@ weston_output_placement_ok(struct weston_output *output)
  * Establishes a repaint timer for the output with the relevant display
  * object's event loop. See output_repaint_timer_handler().
  *
- * The output is assigned an ID. Weston can support up to 32 distinct
- * outputs, with IDs numbered from 0-31; the compositor's output_id_pool
- * is referred to and used to find the first available ID number, and
- * then this ID is marked as used in output_id_pool.
+ * The output is assigned an ID. The compositor's output_id_pool is
+ * referred to and used to find the lowest available ID number, and
+ * then this ID is marked as used in output_id_pool. IDs below 32 are
+ * preferred, as they are the cheapest to track in a weston_output_set.
  *
  * The output is also assigned a Wayland global with the wl_output
  * external interface.
@@ -7271,6 +7581,7 @@ weston_output_enable(struct weston_output *output)
 	output->original_scale = output->scale;
 
 	wl_signal_init(&output->frame_signal);
+	wl_signal_init(&output->present_signal);
 	wl_signal_init(&output->destroy_signal);
 
 	weston_output_transform_scale_init(output, output->transform, output->scale);
@@ -7282,6 +7593,7 @@ weston_output_enable(struct weston_output *output)
 		return -1;
 
 	wl_list_init(&output->animation_list);
+	wl_list_init(&output->frame_callback_list);
 	wl_list_init(&output->feedback_list);
 	wl_list_init(&output->paint_node_list);
 	wl_list_init(&output->paint_node_z_order_list);
@@ -7309,7 +7621,8 @@ weston_output_enable(struct weston_output *output)
 	}
 
 	weston_compositor_add_output(output->compositor, output);
-	weston_output_damage(output);
+	if (!weston_output_layout_defer(output, WESTON_OUTPUT_LAYOUT_DAMAGE))
+		weston_output_damage(output);
 
 	head_names = weston_output_create_heads_string(output);
 	weston_log("Output '%s' enabled with head(s) %s\n",
@@ -7465,6 +7778,7 @@ weston_output_release(struct weston_output *output)
 	assert(output->color_outcome == NULL);
 
 	pixman_region32_fini(&output->region);
+	pixman_region32_fini(&output->repaint_damage);
 	wl_list_remove(&output->link);
 
 	wl_list_for_each_safe(head, tmp, &output->head_list, output_link)
@@ -8276,11 +8590,12 @@ debug_scene_view_print(FILE *fp, struct weston_view *view, int view_idx)
 	if (view->alpha < 1.0)
 		fprintf(fp, "\t\talpha: %f\n", view->alpha);
 
-	if (view->output_mask != 0) {
+	if (!weston_output_set_is_empty(&view->output_mask)) {
 		bool first_output = true;
 		fprintf(fp, "\t\toutputs: ");
 		wl_list_for_each(output, &ec->output_list, link) {
-			if (!(view->output_mask & (1 << output->id)))
+			if (!weston_output_set_has(&view->output_mask,
+						   output->id))
 				continue;
 			fprintf(fp, "%s%d (%s)%s",
 				(first_output) ? "" : ", ",
@@ -8504,7 +8819,7 @@ weston_compositor_create(struct wl_display *display,
 	wl_signal_init(&ec->output_capture.ask_auth);
 	ec->session_active = true;
 
-	ec->output_id_pool = 0;
+	weston_output_set_clear(&ec->output_id_pool);
 	ec->repaint_msec = DEFAULT_REPAINT_WINDOW;
 
 	ec->activate_serial = 1;
@@ -8557,6 +8872,7 @@ weston_compositor_create(struct wl_display *display,
 	wl_list_init(&ec->head_list);
 	wl_list_init(&ec->key_binding_list);
 	wl_list_init(&ec->modifier_binding_list);
+	wl_list_init(&ec->solid_buffer_list);
 	wl_list_init(&ec->button_binding_list);
 	wl_list_init(&ec->touch_binding_list);
 	wl_list_init(&ec->tablet_tool_binding_list);
@@ -8609,6 +8925,9 @@ fail:
 	return NULL;
 }
 
+static void
+weston_compositor_virtual_clock_fini(struct weston_compositor *compositor);
+
 /** weston_compositor_shutdown
  * \ingroup compositor
  */
@@ -8647,6 +8966,9 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	weston_binding_list_destroy_all(&ec->axis_binding_list);
 	weston_binding_list_destroy_all(&ec->debug_binding_list);
 	weston_binding_list_destroy_all(&ec->tablet_tool_binding_list);
+	weston_binding_index_destroy(ec->key_binding_index);
+	weston_binding_index_destroy(ec->button_binding_index);
+	weston_binding_index_destroy(ec->axis_binding_index);
 
 	weston_plane_release(&ec->primary_plane);
 
@@ -8655,6 +8977,8 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 
 	if (!wl_list_empty(&ec->layer_list))
 		weston_log("BUG: layer_list is not empty after shutdown. Calls to weston_layer_fini() are missing somwhere.\n");
+
+	weston_compositor_virtual_clock_fini(ec);
 }
 
 /** weston_compositor_exit_with_code
@@ -8753,6 +9077,11 @@ weston_compositor_read_presentation_clock(
 {
 	int ret;
 
+	if (compositor->virtual_clock.mode != WESTON_VIRTUAL_CLOCK_DISABLED) {
+		*ts = compositor->virtual_clock.now;
+		return;
+	}
+
 	ret = clock_gettime(compositor->presentation_clock, ts);
 	if (ret < 0) {
 		ts->tv_sec = 0;
@@ -8767,6 +9096,334 @@ weston_compositor_read_presentation_clock(
 	}
 }
 
+struct weston_virtual_timer {
+	struct weston_compositor *compositor;
+	struct wl_list link; /* weston_compositor::virtual_clock.timer_list */
+	wl_event_loop_timer_func_t func;
+	void *data;
+
+	bool armed;
+	struct timespec deadline;
+	uint32_t serial;
+};
+
+static void
+virtual_clock_kick(struct weston_compositor *compositor)
+{
+	uint64_t one = 1;
+
+	if (write(compositor->virtual_clock.kick_fd, &one, sizeof one) < 0 &&
+	    errno != EAGAIN)
+		weston_log("Error: failed to kick the virtual clock: %s\n",
+			   strerror(errno));
+}
+
+static struct weston_virtual_timer *
+virtual_clock_first_timer(struct weston_compositor *compositor,
+			  bool skip_current_pass)
+{
+	struct weston_virtual_timer *timer, *first = NULL;
+
+	wl_list_for_each(timer, &compositor->virtual_clock.timer_list, link) {
+		if (!timer->armed)
+			continue;
+
+		if (skip_current_pass &&
+		    timer->serial == compositor->virtual_clock.dispatch_serial)
+			continue;
+
+		if (!first ||
+		    timespec_sub_to_nsec(&timer->deadline, &first->deadline) < 0)
+			first = timer;
+	}
+
+	return first;
+}
+
+/* Fires all timers whose deadline has been reached, in deadline order.
+ * Timers (re-)armed by the callbacks are left for the next pass, so that
+ * a callback re-arming itself at the current time cannot starve the
+ * event loop. */
+static void
+virtual_clock_dispatch(struct weston_compositor *compositor)
+{
+	struct weston_virtual_timer *timer;
+
+	compositor->virtual_clock.dispatch_serial++;
+
+	while ((timer = virtual_clock_first_timer(compositor, true))) {
+		if (timespec_sub_to_nsec(&timer->deadline,
+					 &compositor->virtual_clock.now) > 0)
+			break;
+
+		timer->armed = false;
+		timer->func(timer->data);
+	}
+}
+
+/* Runs from an idle source, i.e. only after every event source that was
+ * ready together with the kick has been dispatched, so client requests
+ * already queued are handled before the clock moves. Re-kicking instead
+ * of adding the idle source again sends the event loop through another
+ * poll before the next jump. */
+static void
+virtual_clock_advance(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_virtual_timer *timer;
+
+	compositor->virtual_clock.advance_source = NULL;
+
+	timer = virtual_clock_first_timer(compositor, false);
+	if (!timer)
+		return;
+
+	/* In auto mode jump straight to the next deadline, in manual mode
+	 * only fire the timers already due. */
+	if (compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_AUTO &&
+	    timespec_sub_to_nsec(&timer->deadline,
+				 &compositor->virtual_clock.now) > 0)
+		compositor->virtual_clock.now = timer->deadline;
+
+	virtual_clock_dispatch(compositor);
+
+	timer = virtual_clock_first_timer(compositor, false);
+	if (!timer)
+		return;
+
+	if (compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_AUTO ||
+	    timespec_sub_to_nsec(&timer->deadline,
+				 &compositor->virtual_clock.now) <= 0)
+		virtual_clock_kick(compositor);
+}
+
+static int
+virtual_clock_kick_handler(int fd, uint32_t mask, void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct wl_event_loop *loop;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof count) < 0 && errno != EAGAIN)
+		weston_log("Error: failed to read the virtual clock kick: %s\n",
+			   strerror(errno));
+
+	if (compositor->virtual_clock.advance_source)
+		return 0;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	compositor->virtual_clock.advance_source =
+		wl_event_loop_add_idle(loop, virtual_clock_advance, compositor);
+
+	return 0;
+}
+
+/** Use a virtual presentation clock
+ *
+ * \param compositor The compositor.
+ * \param mode How the virtual clock advances.
+ * \return 0 on success, -1 on failure.
+ *
+ * The virtual clock starts at the current CLOCK_MONOTONIC time and from then
+ * on only moves forward through virtual timers: in
+ * WESTON_VIRTUAL_CLOCK_AUTO mode it jumps to the next timer deadline
+ * once the event loop has dispatched everything that was ready, in
+ * WESTON_VIRTUAL_CLOCK_MANUAL mode only
+ * weston_compositor_advance_virtual_clock() moves it. The repaint scheduling
+ * of the compositor follows the virtual clock, and backends must pace their
+ * frame completion with weston_compositor_add_virtual_timer() instead of
+ * real timers.
+ *
+ * This is meant for backends that do not drive any real display, to run
+ * frame-paced workloads deterministically and faster than real time.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT int
+weston_compositor_set_presentation_clock_virtual(
+					struct weston_compositor *compositor,
+					enum weston_virtual_clock_mode mode)
+{
+	struct wl_event_loop *loop;
+
+	assert(mode != WESTON_VIRTUAL_CLOCK_DISABLED);
+	assert(compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_DISABLED);
+
+	if (weston_compositor_set_presentation_clock(compositor,
+						     CLOCK_MONOTONIC) < 0)
+		return -1;
+
+	compositor->virtual_clock.kick_fd =
+		eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (compositor->virtual_clock.kick_fd < 0) {
+		weston_log("Error: creating virtual clock eventfd: %s\n",
+			   strerror(errno));
+		return -1;
+	}
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	compositor->virtual_clock.kick_source =
+		wl_event_loop_add_fd(loop, compositor->virtual_clock.kick_fd,
+				     WL_EVENT_READABLE,
+				     virtual_clock_kick_handler, compositor);
+	if (!compositor->virtual_clock.kick_source) {
+		close(compositor->virtual_clock.kick_fd);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &compositor->virtual_clock.now);
+	wl_list_init(&compositor->virtual_clock.timer_list);
+	compositor->virtual_clock.mode = mode;
+
+	compositor->virtual_clock.repaint_timer =
+		weston_compositor_add_virtual_timer(compositor,
+						    output_repaint_timer_handler,
+						    compositor);
+
+	weston_log("Using a virtual presentation clock (%s)\n",
+		   mode == WESTON_VIRTUAL_CLOCK_AUTO ? "auto" : "manual");
+
+	return 0;
+}
+
+static void
+weston_compositor_virtual_clock_fini(struct weston_compositor *compositor)
+{
+	if (compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_DISABLED)
+		return;
+
+	weston_virtual_timer_destroy(compositor->virtual_clock.repaint_timer);
+	compositor->virtual_clock.repaint_timer = NULL;
+
+	if (compositor->virtual_clock.advance_source)
+		wl_event_source_remove(compositor->virtual_clock.advance_source);
+
+	if (!wl_list_empty(&compositor->virtual_clock.timer_list))
+		weston_log("BUG: virtual timers left over at shutdown.\n");
+
+	wl_event_source_remove(compositor->virtual_clock.kick_source);
+	close(compositor->virtual_clock.kick_fd);
+	compositor->virtual_clock.mode = WESTON_VIRTUAL_CLOCK_DISABLED;
+}
+
+/** Move the virtual presentation clock forward
+ *
+ * \param compositor The compositor, using a virtual presentation clock.
+ * \param nsec The amount of time to advance by, non-negative.
+ *
+ * All virtual timers falling due within the interval fire in order, each
+ * seeing the presentation clock at its own deadline, before the clock
+ * settles at the new time. Works in both virtual clock modes.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_advance_virtual_clock(struct weston_compositor *compositor,
+					int64_t nsec)
+{
+	struct weston_virtual_timer *timer;
+	struct timespec target;
+
+	assert(compositor->virtual_clock.mode != WESTON_VIRTUAL_CLOCK_DISABLED);
+	assert(nsec >= 0);
+
+	timespec_add_nsec(&target, &compositor->virtual_clock.now, nsec);
+
+	while ((timer = virtual_clock_first_timer(compositor, false))) {
+		if (timespec_sub_to_nsec(&timer->deadline, &target) > 0)
+			break;
+
+		if (timespec_sub_to_nsec(&timer->deadline,
+					 &compositor->virtual_clock.now) > 0)
+			compositor->virtual_clock.now = timer->deadline;
+
+		virtual_clock_dispatch(compositor);
+	}
+
+	compositor->virtual_clock.now = target;
+	virtual_clock_dispatch(compositor);
+}
+
+/** Create a timer following the virtual presentation clock
+ *
+ * \param compositor The compositor, using a virtual presentation clock.
+ * \param func The function to call when the timer fires.
+ * \param data User data for \c func.
+ * \return A new disarmed timer, or NULL on failure.
+ *
+ * \sa weston_compositor_set_presentation_clock_virtual
+ * \ingroup compositor
+ */
+WL_EXPORT struct weston_virtual_timer *
+weston_compositor_add_virtual_timer(struct weston_compositor *compositor,
+				    wl_event_loop_timer_func_t func,
+				    void *data)
+{
+	struct weston_virtual_timer *timer;
+
+	assert(compositor->virtual_clock.mode != WESTON_VIRTUAL_CLOCK_DISABLED);
+
+	timer = zalloc(sizeof *timer);
+	if (!timer)
+		return NULL;
+
+	timer->compositor = compositor;
+	timer->func = func;
+	timer->data = data;
+	wl_list_insert(&compositor->virtual_clock.timer_list, &timer->link);
+
+	return timer;
+}
+
+/** Arm a virtual timer
+ *
+ * \param timer The timer.
+ * \param deadline Absolute presentation clock time to fire at.
+ *
+ * Re-arming an armed timer replaces its deadline. A deadline in the past
+ * fires the timer from the event loop as soon as possible.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_virtual_timer_arm(struct weston_virtual_timer *timer,
+			 const struct timespec *deadline)
+{
+	struct weston_compositor *compositor = timer->compositor;
+
+	timer->armed = true;
+	timer->deadline = *deadline;
+	timer->serial = compositor->virtual_clock.dispatch_serial;
+
+	if (compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_AUTO ||
+	    timespec_sub_to_nsec(deadline, &compositor->virtual_clock.now) <= 0)
+		virtual_clock_kick(compositor);
+}
+
+/** Disarm a virtual timer
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_virtual_timer_disarm(struct weston_virtual_timer *timer)
+{
+	timer->armed = false;
+}
+
+/** Destroy a virtual timer
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_virtual_timer_destroy(struct weston_virtual_timer *timer)
+{
+	if (!timer)
+		return;
+
+	wl_list_remove(&timer->link);
+	free(timer);
+}
+
 /** Import dmabuf buffer into current renderer
  *
  * \param compositor
@@ -9016,6 +9673,17 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 		weston_dmabuf_feedback_format_table_destroy(compositor->dmabuf_feedback_format_table);
 	}
 
+	/* Buffers still referenced by leaked curtains outlive the list */
+	while (!wl_list_empty(&compositor->solid_buffer_list)) {
+		struct weston_solid_buffer_entry *entry =
+			container_of(compositor->solid_buffer_list.next,
+				     struct weston_solid_buffer_entry, link);
+
+		weston_solid_buffer_entry_destroy(entry);
+	}
+
+	weston_output_set_fini(&compositor->output_id_pool);
+
 	free(compositor);
 }
 
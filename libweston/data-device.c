@@ -48,6 +48,14 @@ struct weston_drag {
 	struct wl_listener icon_destroy_listener;
 	struct weston_coord_surface offset;
 	struct weston_keyboard_grab keyboard_grab;
+
+	/* Motion is sent at most once per refresh of the output under the
+	 * drag: while the timer runs, only the latest position is kept. */
+	struct wl_event_source *motion_timer;
+	bool motion_throttled;
+	bool motion_pending;
+	uint32_t motion_msecs;
+	struct weston_coord_global motion_pos;
 };
 
 struct weston_pointer_drag {
@@ -60,6 +68,8 @@ struct weston_touch_drag {
 	struct weston_touch_grab grab;
 };
 
+#define DRAG_MOTION_DEFAULT_INTERVAL_MS 16
+
 #define ALL_ACTIONS (WL_DATA_DEVICE_MANAGER_DND_ACTION_COPY | \
 		     WL_DATA_DEVICE_MANAGER_DND_ACTION_MOVE | \
 		     WL_DATA_DEVICE_MANAGER_DND_ACTION_ASK)
@@ -498,9 +508,99 @@ destroy_drag_focus(struct wl_listener *listener, void *data)
 	drag->focus_resource = NULL;
 }
 
+static void
+weston_drag_send_motion(struct weston_drag *drag, uint32_t msecs,
+			struct weston_coord_global pos)
+{
+	struct weston_coord_surface surf_pos;
+
+	surf_pos = weston_coord_global_to_surface(drag->focus, pos);
+	wl_data_device_send_motion(drag->focus_resource, msecs,
+				   wl_fixed_from_double(surf_pos.c.x),
+				   wl_fixed_from_double(surf_pos.c.y));
+}
+
+/* Deliver the coalesced motion, if any, ahead of anything else sent to the
+ * focus, so that the event order seen by the client is unchanged. */
+static void
+weston_drag_flush_motion(struct weston_drag *drag)
+{
+	if (!drag->motion_pending)
+		return;
+
+	drag->motion_pending = false;
+	if (drag->focus_resource)
+		weston_drag_send_motion(drag, drag->motion_msecs,
+					drag->motion_pos);
+}
+
+static int
+weston_drag_motion_interval(struct weston_drag *drag)
+{
+	struct weston_output *output = drag->focus->output;
+
+	if (!output || !output->current_mode ||
+	    output->current_mode->refresh <= 0)
+		return DRAG_MOTION_DEFAULT_INTERVAL_MS;
+
+	return MAX(1, 1000000 / output->current_mode->refresh);
+}
+
+static int
+drag_motion_timer_handler(void *data)
+{
+	struct weston_drag *drag = data;
+
+	if (drag->motion_pending && drag->focus_resource) {
+		weston_drag_flush_motion(drag);
+		wl_event_source_timer_update(drag->motion_timer,
+				weston_drag_motion_interval(drag));
+	} else {
+		drag->motion_pending = false;
+		drag->motion_throttled = false;
+	}
+
+	return 0;
+}
+
+static void
+weston_drag_motion(struct weston_drag *drag, const struct timespec *time,
+		   struct weston_coord_global pos)
+{
+	struct wl_event_loop *loop;
+
+	if (!drag->focus_resource)
+		return;
+
+	if (drag->motion_throttled) {
+		drag->motion_pending = true;
+		drag->motion_msecs = timespec_to_msec(time);
+		drag->motion_pos = pos;
+		return;
+	}
+
+	weston_drag_send_motion(drag, timespec_to_msec(time), pos);
+
+	if (!drag->motion_timer) {
+		loop = wl_display_get_event_loop(
+			drag->focus->surface->compositor->wl_display);
+		drag->motion_timer =
+			wl_event_loop_add_timer(loop, drag_motion_timer_handler,
+						drag);
+		if (!drag->motion_timer)
+			return;
+	}
+
+	wl_event_source_timer_update(drag->motion_timer,
+				     weston_drag_motion_interval(drag));
+	drag->motion_throttled = true;
+}
+
 static void
 weston_drag_clear_focus(struct weston_drag *drag)
 {
+	weston_drag_flush_motion(drag);
+
 	if (drag->focus_resource) {
 		wl_data_device_send_leave(drag->focus_resource);
 		wl_list_remove(&drag->focus_listener.link);
@@ -618,7 +718,6 @@ drag_grab_motion(struct weston_pointer_grab *grab,
 		container_of(grab, struct weston_pointer_drag, grab);
 	struct weston_pointer *pointer = drag->grab.pointer;
 	float fx, fy;
-	uint32_t msecs;
 
 	weston_pointer_move(pointer, event);
 
@@ -629,17 +728,7 @@ drag_grab_motion(struct weston_pointer_grab *grab,
 		weston_view_schedule_repaint(drag->base.icon);
 	}
 
-	if (drag->base.focus_resource) {
-		struct weston_coord_surface surf_pos;
-
-		msecs = timespec_to_msec(time);
-		surf_pos = weston_coord_global_to_surface(drag->base.focus,
-							  pointer->pos);
-
-		wl_data_device_send_motion(drag->base.focus_resource, msecs,
-					   wl_fixed_from_double(surf_pos.c.x),
-					   wl_fixed_from_double(surf_pos.c.y));
-	}
+	weston_drag_motion(&drag->base, time, pointer->pos);
 }
 
 static void
@@ -658,6 +747,9 @@ data_device_end_drag_grab(struct weston_drag *drag,
 	}
 
 	weston_drag_clear_focus(drag);
+
+	if (drag->motion_timer)
+		wl_event_source_remove(drag->motion_timer);
 }
 
 static void
@@ -687,6 +779,8 @@ drag_grab_button(struct weston_pointer_grab *grab,
 	if (data_source &&
 	    pointer->grab_button == button &&
 	    state == WL_POINTER_BUTTON_STATE_RELEASED) {
+		weston_drag_flush_motion(&drag->base);
+
 		if (drag->base.focus_resource &&
 		    data_source->accepted &&
 		    data_source->current_dnd_action) {
@@ -785,6 +879,7 @@ drag_grab_touch_up(struct weston_touch_grab *grab,
 	if (touch_id != touch->grab_touch_id)
 		return;
 
+	weston_drag_flush_motion(&touch_drag->base);
 	if (touch_drag->base.focus_resource)
 		wl_data_device_send_drop(touch_drag->base.focus_resource);
 	if (touch_drag->base.data_source) {
@@ -812,8 +907,8 @@ drag_grab_touch_motion(struct weston_touch_grab *grab,
 	struct weston_touch_drag *touch_drag =
 		container_of(grab, struct weston_touch_drag, grab);
 	struct weston_touch *touch = grab->touch;
+	struct weston_coord_global pos;
 	float fx, fy;
-	uint32_t msecs;
 
 	if (touch_id != touch->grab_touch_id)
 		return;
@@ -828,17 +923,8 @@ drag_grab_touch_motion(struct weston_touch_grab *grab,
 		weston_view_schedule_repaint(touch_drag->base.icon);
 	}
 
-	if (touch_drag->base.focus_resource) {
-		struct weston_coord_global tmp_g;
-		struct weston_coord_surface c;
-
-		tmp_g.c = weston_coord_from_fixed(touch->grab_x, touch->grab_y);
-		msecs = timespec_to_msec(time);
-		c = weston_coord_global_to_surface(touch_drag->base.focus, tmp_g);
-		wl_data_device_send_motion(touch_drag->base.focus_resource,
-					   msecs, wl_fixed_from_double(c.c.x),
-					   wl_fixed_from_double(c.c.y));
-	}
+	pos.c = weston_coord_from_fixed(touch->grab_x, touch->grab_y);
+	weston_drag_motion(&touch_drag->base, time, pos);
 }
 
 static void
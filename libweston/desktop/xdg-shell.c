@@ -38,6 +38,7 @@
 #include <libweston/desktop.h>
 #include "internal.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 /************************************************************************************
  * WARNING: This file implements the stable xdg shell protocol.
@@ -78,6 +79,11 @@ struct weston_desktop_xdg_surface {
 	struct wl_event_source *configure_idle;
 	struct wl_list configure_list; /* weston_desktop_xdg_surface_configure::link */
 
+	/* Size-only configures held back until the client caught up */
+	bool configure_throttled;
+	bool configure_acked_uncommitted;
+	struct wl_event_source *configure_throttle_timer;
+
 	bool has_next_geometry;
 	struct weston_geometry next_geometry;
 
@@ -1148,41 +1154,61 @@ weston_desktop_xdg_surface_send_configure(void *user_data)
 	xdg_surface_send_configure(surface->resource, configure->serial);
 }
 
-static bool
-weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *toplevel)
+static void
+weston_desktop_xdg_toplevel_get_configured(struct weston_desktop_xdg_toplevel *toplevel,
+					   struct weston_desktop_xdg_toplevel_state *state,
+					   struct weston_size *size)
 {
-	struct {
-		struct weston_desktop_xdg_toplevel_state state;
-		struct weston_size size;
-	} configured;
-
-	if (!toplevel->base.configured)
-		return false;
-
 	if (wl_list_empty(&toplevel->base.configure_list)) {
 		/* Last configure is actually the current state, just use it */
-		configured.state = toplevel->current.state;
-		configured.size.width = toplevel->base.surface->width;
-		configured.size.height = toplevel->base.surface->height;
+		*state = toplevel->current.state;
+		size->width = toplevel->base.surface->width;
+		size->height = toplevel->base.surface->height;
 	} else {
 		struct weston_desktop_xdg_toplevel_configure *configure =
 			wl_container_of(toplevel->base.configure_list.prev,
 					configure, base.link);
 
-		configured.state = configure->state;
-		configured.size = configure->size;
+		*state = configure->state;
+		*size = configure->size;
 	}
+}
 
-	if (toplevel->pending.state.activated != configured.state.activated)
+static bool
+weston_desktop_xdg_toplevel_pending_state_same(struct weston_desktop_xdg_toplevel *toplevel,
+					       const struct weston_desktop_xdg_toplevel_state *state)
+{
+	if (toplevel->pending.state.activated != state->activated)
 		return false;
-	if (toplevel->pending.state.fullscreen != configured.state.fullscreen)
+	if (toplevel->pending.state.fullscreen != state->fullscreen)
 		return false;
-	if (toplevel->pending.state.maximized != configured.state.maximized)
+	if (toplevel->pending.state.maximized != state->maximized)
 		return false;
-	if (toplevel->pending.state.resizing != configured.state.resizing)
+	if (toplevel->pending.state.resizing != state->resizing)
 		return false;
 	if (toplevel->pending.state.tiled_orientation !=
-	    configured.state.tiled_orientation)
+	    state->tiled_orientation)
+		return false;
+
+	return true;
+}
+
+static bool
+weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *toplevel)
+{
+	struct {
+		struct weston_desktop_xdg_toplevel_state state;
+		struct weston_size size;
+	} configured;
+
+	if (!toplevel->base.configured)
+		return false;
+
+	weston_desktop_xdg_toplevel_get_configured(toplevel, &configured.state,
+						   &configured.size);
+
+	if (!weston_desktop_xdg_toplevel_pending_state_same(toplevel,
+							    &configured.state))
 		return false;
 
 	if (toplevel->pending.size.width == configured.size.width &&
@@ -1196,12 +1222,98 @@ weston_desktop_xdg_toplevel_state_compare(struct weston_desktop_xdg_toplevel *to
 	return false;
 }
 
+/* A client still busy with the previous configure, i.e. one that has not
+ * acked it or not committed the result yet, does not benefit from more
+ * configures that only change the size: they would pile up and the client
+ * would fall behind more and more, e.g. during an interactive resize. Such
+ * configures are merged into one, sent once the client caught up, or after
+ * one output frame at the latest. State changes are never held back. */
+static bool
+weston_desktop_xdg_toplevel_should_throttle(struct weston_desktop_xdg_toplevel *toplevel)
+{
+	struct weston_desktop_xdg_toplevel_state state;
+	struct weston_size size;
+
+	if (!toplevel->base.configured)
+		return false;
+
+	if (wl_list_empty(&toplevel->base.configure_list) &&
+	    !toplevel->base.configure_acked_uncommitted)
+		return false;
+
+	weston_desktop_xdg_toplevel_get_configured(toplevel, &state, &size);
+
+	return weston_desktop_xdg_toplevel_pending_state_same(toplevel, &state);
+}
+
+static void
+weston_desktop_xdg_surface_send_throttled(struct weston_desktop_xdg_surface *surface)
+{
+	struct wl_display *display = weston_desktop_get_display(surface->desktop);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+
+	if (!surface->configure_throttled)
+		return;
+
+	surface->configure_throttled = false;
+	wl_event_source_timer_update(surface->configure_throttle_timer, 0);
+
+	if (surface->configure_idle != NULL)
+		return;
+
+	surface->configure_idle =
+		wl_event_loop_add_idle(loop,
+				       weston_desktop_xdg_surface_send_configure,
+				       surface);
+}
+
+static int
+weston_desktop_xdg_surface_throttle_timeout(void *user_data)
+{
+	struct weston_desktop_xdg_surface *surface = user_data;
+
+	weston_desktop_xdg_surface_send_throttled(surface);
+
+	return 0;
+}
+
+static void
+weston_desktop_xdg_surface_throttle_configure(struct weston_desktop_xdg_surface *surface)
+{
+	struct wl_display *display = weston_desktop_get_display(surface->desktop);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	struct weston_output *output = surface->surface->output;
+	int msec = 16;
+
+	if (surface->configure_throttled)
+		return;
+
+	if (surface->configure_throttle_timer == NULL) {
+		surface->configure_throttle_timer =
+			wl_event_loop_add_timer(loop,
+						weston_desktop_xdg_surface_throttle_timeout,
+						surface);
+		if (surface->configure_throttle_timer == NULL) {
+			weston_desktop_xdg_surface_send_configure(surface);
+			return;
+		}
+	}
+
+	if (output && output->current_mode && output->current_mode->refresh > 0)
+		msec = (millihz_to_nsec(output->current_mode->refresh) +
+			999999) / 1000000;
+
+	surface->configure_throttled = true;
+	wl_event_source_timer_update(surface->configure_throttle_timer, msec);
+}
+
 static void
 weston_desktop_xdg_surface_schedule_configure(struct weston_desktop_xdg_surface *surface)
 {
 	struct wl_display *display = weston_desktop_get_display(surface->desktop);
 	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 	bool pending_same = false;
+	bool throttle = false;
 
 	switch (surface->role) {
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_NONE:
@@ -1209,11 +1321,22 @@ weston_desktop_xdg_surface_schedule_configure(struct weston_desktop_xdg_surface
 		break;
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_TOPLEVEL:
 		pending_same = weston_desktop_xdg_toplevel_state_compare((struct weston_desktop_xdg_toplevel *) surface);
+		throttle = weston_desktop_xdg_toplevel_should_throttle((struct weston_desktop_xdg_toplevel *) surface);
 		break;
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_POPUP:
 		break;
 	}
 
+	if (surface->configure_throttled) {
+		if (pending_same) {
+			surface->configure_throttled = false;
+			wl_event_source_timer_update(surface->configure_throttle_timer, 0);
+		} else if (!throttle) {
+			weston_desktop_xdg_surface_send_throttled(surface);
+		}
+		return;
+	}
+
 	if (surface->configure_idle != NULL) {
 		if (!pending_same)
 			return;
@@ -1224,6 +1347,11 @@ weston_desktop_xdg_surface_schedule_configure(struct weston_desktop_xdg_surface
 		if (pending_same)
 			return;
 
+		if (throttle) {
+			weston_desktop_xdg_surface_throttle_configure(surface);
+			return;
+		}
+
 		surface->configure_idle =
 			wl_event_loop_add_idle(loop,
 					       weston_desktop_xdg_surface_send_configure,
@@ -1433,6 +1561,7 @@ weston_desktop_xdg_surface_protocol_ack_configure(struct wl_client *wl_client,
 	}
 
 	surface->configured = true;
+	surface->configure_acked_uncommitted = true;
 
 	switch (surface->role) {
 	case WESTON_DESKTOP_XDG_SURFACE_ROLE_NONE:
@@ -1495,6 +1624,10 @@ weston_desktop_xdg_surface_committed(struct weston_desktop_surface *dsurface,
 		weston_desktop_xdg_popup_committed((struct weston_desktop_xdg_popup *) surface);
 		break;
 	}
+
+	surface->configure_acked_uncommitted = false;
+	if (wl_list_empty(&surface->configure_list))
+		weston_desktop_xdg_surface_send_throttled(surface);
 }
 
 static void
@@ -1537,6 +1670,9 @@ weston_desktop_xdg_surface_destroy(struct weston_desktop_surface *dsurface,
 	if (surface->configure_idle != NULL)
 		wl_event_source_remove(surface->configure_idle);
 
+	if (surface->configure_throttle_timer != NULL)
+		wl_event_source_remove(surface->configure_throttle_timer);
+
 	wl_list_for_each_safe(configure, temp, &surface->configure_list, link)
 		free(configure);
 
@@ -4667,6 +4667,8 @@ weston_pointer_constraint_destroy(struct weston_pointer_constraint *constraint)
 
 	wl_resource_set_user_data(constraint->resource, NULL);
 	pixman_region32_fini(&constraint->region);
+	weston_confine_region_fini(constraint->confine);
+	free(constraint->confine);
 	wl_list_remove(&constraint->link);
 	free(constraint);
 }
@@ -4684,25 +4686,29 @@ disable_pointer_constraint(struct weston_pointer_constraint *constraint)
 	}
 }
 
+static struct weston_confine_region *
+get_confine_region(struct weston_pointer_constraint *constraint)
+{
+	struct weston_confine_region *confine = constraint->confine;
+
+	if (!confine->valid)
+		weston_confine_region_update(confine,
+					     &constraint->surface->input,
+					     &constraint->region);
+
+	return confine;
+}
+
 static bool
 is_within_constraint_region(struct weston_pointer_constraint *constraint,
 			    wl_fixed_t sx, wl_fixed_t sy)
 {
-	struct weston_surface *surface = constraint->surface;
-	pixman_region32_t constraint_region;
-	bool result;
-
-	pixman_region32_init(&constraint_region);
-	pixman_region32_intersect(&constraint_region,
-				  &surface->input,
-				  &constraint->region);
-	result = pixman_region32_contains_point(&constraint_region,
-						wl_fixed_to_int(sx),
-						wl_fixed_to_int(sy),
-						NULL);
-	pixman_region32_fini(&constraint_region);
+	struct weston_confine_region *confine = get_confine_region(constraint);
 
-	return result;
+	return pixman_region32_contains_point(&confine->region,
+					      wl_fixed_to_int(sx),
+					      wl_fixed_to_int(sy),
+					      NULL);
 }
 
 static void
@@ -4872,6 +4878,9 @@ pointer_constraint_surface_committed(struct wl_listener *listener, void *data)
 		container_of(listener, struct weston_pointer_constraint,
 			     surface_commit_listener);
 
+	/* Both the input region and the constraint region change here */
+	constraint->confine->valid = false;
+
 	if (is_pointer_constraint_enabled(constraint))
 		weston_view_update_transform(constraint->view);
 
@@ -4911,6 +4920,13 @@ weston_pointer_constraint_create(struct weston_surface *surface,
 	if (!constraint)
 		return NULL;
 
+	constraint->confine = zalloc(sizeof *constraint->confine);
+	if (!constraint->confine) {
+		free(constraint);
+		return NULL;
+	}
+	weston_confine_region_init(constraint->confine);
+
 	constraint->lifetime = lifetime;
 	pixman_region32_init(&constraint->region);
 	pixman_region32_init(&constraint->region_pending);
@@ -5443,7 +5459,7 @@ region_to_outline(pixman_region32_t *region, struct wl_array *borders)
 }
 
 static bool
-is_border_horizontal (struct border *border)
+is_border_horizontal(const struct border *border)
 {
 	return border->line.a.y == border->line.b.y;
 }
@@ -5466,19 +5482,60 @@ is_border_blocking_directions(struct border *border,
 	return (~border->blocking_dir & directions) != directions;
 }
 
-static struct border *
-get_closest_border(struct wl_array *borders,
-		   struct line *motion,
-		   uint32_t directions)
+static double
+border_position(const struct border *border)
 {
-	struct border *border;
+	return is_border_horizontal(border) ?
+		border->line.a.y : border->line.a.x;
+}
+
+static int
+compare_border_position(const void *a, const void *b)
+{
+	double pos_a = border_position(a);
+	double pos_b = border_position(b);
+
+	if (pos_a < pos_b)
+		return -1;
+	else if (pos_a > pos_b)
+		return 1;
+	else
+		return 0;
+}
+
+/*
+ * Only borders whose position lies within the extent of the motion along
+ * the blocked axis can intersect it. The borders are sorted by position,
+ * so find the first candidate with a binary search and stop once past the
+ * motion.
+ */
+static void
+find_closest_border_in(const struct wl_array *borders,
+		       double min, double max,
+		       struct line *motion,
+		       uint32_t directions,
+		       struct border **closest_border,
+		       double *closest_distance_2)
+{
+	struct border *first = borders->data;
+	size_t count = borders->size / sizeof *first;
+	size_t lo = 0, hi = count, mid;
 	struct weston_coord intersection;
 	struct weston_coord delta;
 	double distance_2;
-	struct border *closest_border = NULL;
-	double closest_distance_2 = DBL_MAX;
+	size_t i;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (border_position(&first[mid]) < min)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < count && border_position(&first[i]) <= max; i++) {
+		struct border *border = &first[i];
 
-	wl_array_for_each(border, borders) {
 		if (!is_border_blocking_directions(border, directions))
 			continue;
 
@@ -5487,11 +5544,36 @@ get_closest_border(struct wl_array *borders,
 
 		delta = weston_coord_sub(intersection, motion->a);
 		distance_2 = delta.x*delta.x + delta.y*delta.y;
-		if (distance_2 < closest_distance_2) {
-			closest_border = border;
-			closest_distance_2 = distance_2;
+		if (distance_2 < *closest_distance_2) {
+			*closest_border = border;
+			*closest_distance_2 = distance_2;
 		}
 	}
+}
+
+static struct border *
+get_closest_border(const struct weston_confine_region *confine,
+		   struct line *motion,
+		   uint32_t directions)
+{
+	struct border *closest_border = NULL;
+	double closest_distance_2 = DBL_MAX;
+
+	if (directions & (MOTION_DIRECTION_POSITIVE_X |
+			  MOTION_DIRECTION_NEGATIVE_X))
+		find_closest_border_in(&confine->vertical,
+				       MIN(motion->a.x, motion->b.x),
+				       MAX(motion->a.x, motion->b.x),
+				       motion, directions,
+				       &closest_border, &closest_distance_2);
+
+	if (directions & (MOTION_DIRECTION_POSITIVE_Y |
+			  MOTION_DIRECTION_NEGATIVE_Y))
+		find_closest_border_in(&confine->horizontal,
+				       MIN(motion->a.y, motion->b.y),
+				       MAX(motion->a.y, motion->b.y),
+				       motion, directions,
+				       &closest_border, &closest_distance_2);
 
 	return closest_border;
 }
@@ -5542,28 +5624,39 @@ get_motion_directions(struct line *motion)
 	return directions;
 }
 
-static struct weston_coord_global
-weston_pointer_clamp_event_to_region(struct weston_pointer *pointer,
-				     struct weston_pointer_motion_event *event,
-				     pixman_region32_t *region)
+WESTON_EXPORT_FOR_TESTS void
+weston_confine_region_init(struct weston_confine_region *confine)
 {
-	wl_fixed_t old_sx = pointer->sx;
-	wl_fixed_t old_sy = pointer->sy;
-	struct wl_array borders;
-	struct line motion;
-	struct border *closest_border;
-	uint32_t directions;
-	struct weston_coord_global pos;
-	struct weston_coord_global clamped_pos;
-	struct weston_coord_surface clamped_surf_pos;
-	struct weston_coord_surface surf_pos;
+	pixman_region32_init(&confine->region);
+	wl_array_init(&confine->horizontal);
+	wl_array_init(&confine->vertical);
+	confine->valid = false;
+}
 
-	assert(pointer->focus);
+WESTON_EXPORT_FOR_TESTS void
+weston_confine_region_fini(struct weston_confine_region *confine)
+{
+	pixman_region32_fini(&confine->region);
+	wl_array_release(&confine->horizontal);
+	wl_array_release(&confine->vertical);
+}
 
-	pos = weston_pointer_motion_to_abs(pointer, event);
-	surf_pos = weston_coord_global_to_surface(pointer->focus, pos);
+/** Rebuild the effective confinement area and its outline
+ *
+ * \param confine The cache to fill.
+ * \param input The surface input region.
+ * \param constraint_region The region set on the constraint.
+ */
+WESTON_EXPORT_FOR_TESTS void
+weston_confine_region_update(struct weston_confine_region *confine,
+			     pixman_region32_t *input,
+			     pixman_region32_t *constraint_region)
+{
+	struct wl_array borders;
+	struct border *border;
+	struct border *sorted;
 
-	wl_array_init(&borders);
+	pixman_region32_intersect(&confine->region, input, constraint_region);
 
 	/*
 	 * Generate borders given the confine region we are to use. The borders
@@ -5572,19 +5665,60 @@ weston_pointer_clamp_event_to_region(struct weston_pointer *pointer,
 	 * borders are outside. This needs to be considered when clamping
 	 * confined motion vectors.
 	 */
-	region_to_outline(region, &borders);
+	wl_array_init(&borders);
+	if (pixman_region32_not_empty(&confine->region))
+		region_to_outline(&confine->region, &borders);
+
+	confine->horizontal.size = 0;
+	confine->vertical.size = 0;
+	wl_array_for_each(border, &borders) {
+		if (is_border_horizontal(border))
+			sorted = wl_array_add(&confine->horizontal,
+					      sizeof *sorted);
+		else
+			sorted = wl_array_add(&confine->vertical,
+					      sizeof *sorted);
+		if (sorted)
+			*sorted = *border;
+	}
+	wl_array_release(&borders);
+
+	qsort(confine->horizontal.data,
+	      confine->horizontal.size / sizeof(struct border),
+	      sizeof(struct border), compare_border_position);
+	qsort(confine->vertical.data,
+	      confine->vertical.size / sizeof(struct border),
+	      sizeof(struct border), compare_border_position);
+
+	confine->valid = true;
+}
+
+/** Clamp a motion in surface coordinates to the confinement area
+ *
+ * \param confine An up to date confinement area.
+ * \param from Where the motion starts, within the area.
+ * \param to Where the motion would end without confinement.
+ * \return Where the motion ends within the area.
+ */
+WESTON_EXPORT_FOR_TESTS struct weston_coord
+weston_confine_region_clamp_motion(const struct weston_confine_region *confine,
+				   struct weston_coord from,
+				   struct weston_coord to)
+{
+	struct line motion;
+	struct border *closest_border;
+	uint32_t directions;
+
+	assert(confine->valid);
 
 	motion = (struct line) {
-		.a = (struct weston_coord) {
-			.x = wl_fixed_to_double(old_sx),
-			.y = wl_fixed_to_double(old_sy),
-		},
-		.b = surf_pos.c,
+		.a = from,
+		.b = to,
 	};
 	directions = get_motion_directions(&motion);
 
 	while (directions) {
-		closest_border = get_closest_border(&borders,
+		closest_border = get_closest_border(confine,
 						    &motion,
 						    directions);
 		if (closest_border)
@@ -5593,13 +5727,36 @@ weston_pointer_clamp_event_to_region(struct weston_pointer *pointer,
 			break;
 	}
 
-	clamped_surf_pos = weston_coord_surface(motion.b.x, motion.b.y,
+	return motion.b;
+}
+
+static struct weston_coord_global
+weston_pointer_clamp_event_to_region(struct weston_pointer *pointer,
+				     struct weston_pointer_motion_event *event,
+				     const struct weston_confine_region *confine)
+{
+	struct weston_coord_global pos;
+	struct weston_coord_surface clamped_surf_pos;
+	struct weston_coord_surface surf_pos;
+	struct weston_coord from;
+	struct weston_coord clamped;
+
+	assert(pointer->focus);
+
+	pos = weston_pointer_motion_to_abs(pointer, event);
+	surf_pos = weston_coord_global_to_surface(pointer->focus, pos);
+
+	from = (struct weston_coord) {
+		.x = wl_fixed_to_double(pointer->sx),
+		.y = wl_fixed_to_double(pointer->sy),
+	};
+
+	clamped = weston_confine_region_clamp_motion(confine, from, surf_pos.c);
+	clamped_surf_pos = weston_coord_surface(clamped.x, clamped.y,
 						pointer->focus->surface);
-	clamped_pos = weston_coord_surface_to_global(pointer->focus,
-						     clamped_surf_pos);
 
-	wl_array_release(&borders);
-	return clamped_pos;
+	return weston_coord_surface_to_global(pointer->focus,
+					      clamped_surf_pos);
 }
 
 static double
@@ -5676,39 +5833,37 @@ maybe_warp_confined_pointer(struct weston_pointer_constraint *constraint)
 	if (!is_within_constraint_region(constraint, sx, sy)) {
 		double xf = wl_fixed_to_double(sx);
 		double yf = wl_fixed_to_double(sy);
-		pixman_region32_t confine_region;
-		struct wl_array borders;
+		struct weston_confine_region *confine =
+			get_confine_region(constraint);
+		struct wl_array *lists[] = {
+			&confine->horizontal,
+			&confine->vertical,
+		};
 		struct border *border;
 		double closest_distance_2 = DBL_MAX;
 		struct border *closest_border = NULL;
 		struct weston_coord_global cg;
 		struct weston_coord_surface cs;
+		unsigned int i;
 
-		wl_array_init(&borders);
-
-		pixman_region32_init(&confine_region);
-		pixman_region32_intersect(&confine_region,
-					  &constraint->view->surface->input,
-					  &constraint->region);
-		assert(pixman_region32_not_empty(&confine_region));
-		region_to_outline(&confine_region, &borders);
-		pixman_region32_fini(&confine_region);
+		assert(pixman_region32_not_empty(&confine->region));
 
-		wl_array_for_each(border, &borders) {
-			double distance_2;
+		for (i = 0; i < ARRAY_LENGTH(lists); i++) {
+			wl_array_for_each(border, lists[i]) {
+				double distance_2;
 
-			distance_2 = point_to_border_distance_2(border, xf, yf);
-			if (distance_2 < closest_distance_2) {
-				closest_border = border;
-				closest_distance_2 = distance_2;
+				distance_2 = point_to_border_distance_2(border,
+									xf, yf);
+				if (distance_2 < closest_distance_2) {
+					closest_border = border;
+					closest_distance_2 = distance_2;
+				}
 			}
 		}
 		assert(closest_border);
 
 		warp_to_behind_border(closest_border, &sx, &sy);
 
-		wl_array_release(&borders);
-
 		cs = weston_coord_surface_from_fixed(sx, sy,
 						     constraint->view->surface);
 		cg = weston_coord_surface_to_global(constraint->view, cs);
@@ -5724,28 +5879,19 @@ confined_pointer_grab_pointer_motion(struct weston_pointer_grab *grab,
 	struct weston_pointer_constraint *constraint =
 		container_of(grab, struct weston_pointer_constraint, grab);
 	struct weston_pointer *pointer = grab->pointer;
-	struct weston_surface *surface;
 	wl_fixed_t old_sx = pointer->sx;
 	wl_fixed_t old_sy = pointer->sy;
-	pixman_region32_t confine_region;
 	struct weston_coord_global pos;
 	struct weston_coord_surface surf_pos;
 
 	assert(pointer->focus);
 	assert(pointer->focus->surface == constraint->surface);
 
-	surface = pointer->focus->surface;
-
 	weston_view_update_transform(pointer->focus);
 
-	pixman_region32_init(&confine_region);
-	pixman_region32_intersect(&confine_region,
-				  &surface->input,
-				  &constraint->region);
 	pos = weston_pointer_clamp_event_to_region(pointer, event,
-						   &confine_region);
+						   get_confine_region(constraint));
 	weston_pointer_move_to(pointer, pos);
-	pixman_region32_fini(&confine_region);
 
 	surf_pos = weston_coord_global_to_surface(pointer->focus, pos);
 	pointer->sx = wl_fixed_from_double(surf_pos.c.x);
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <linux/input.h>
+
+#include <xkbcommon/xkbcommon.h>
+
+#include <libweston/libweston.h>
+#include "backend.h"
+#include "shared/hash.h"
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+
+struct keysym_index_entry {
+	uint32_t key;
+	uint32_t mods; /* enum weston_keysym_index_mods */
+};
+
+struct weston_keysym_index {
+	struct xkb_keymap *keymap;
+	struct hash_table *table;	/* keysym -> struct keysym_index_entry */
+	struct keysym_index_entry *entries;
+	uint32_t shift_key;
+	uint32_t level3_key;
+};
+
+/* Modifier combinations tried for every key, the cheapest one first so
+ * that a keysym reachable in several ways is typed without modifiers if
+ * possible. */
+static const uint32_t index_mods[] = {
+	0,
+	WESTON_KEYSYM_INDEX_MOD_SHIFT,
+	WESTON_KEYSYM_INDEX_MOD_LEVEL3,
+	WESTON_KEYSYM_INDEX_MOD_SHIFT | WESTON_KEYSYM_INDEX_MOD_LEVEL3,
+};
+
+/* The alphanumeric block, including its modifiers and the extra key of
+ * ISO keyboards. Keys there win over keys elsewhere, whatever modifiers
+ * they need: evdev rules also put e.g. EuroSign on KEY_EURO, which few
+ * clients expect to see. */
+static bool
+key_is_main_block(uint32_t key)
+{
+	return key <= KEY_SPACE || key == KEY_102ND;
+}
+
+/* Find the key that produces a modifier keysym without any modifiers,
+ * preferring the usual one, and the modifier mask it sets. */
+static bool
+find_modifier_key(struct xkb_keymap *keymap, struct xkb_state *state,
+		  xkb_keysym_t keysym, uint32_t preferred,
+		  uint32_t *key, xkb_mod_mask_t *mask)
+{
+	xkb_keycode_t min, max, code, found = XKB_KEYCODE_INVALID;
+
+	xkb_state_update_mask(state, 0, 0, 0, 0, 0, 0);
+
+	if (xkb_state_key_get_one_sym(state, preferred + 8) == keysym) {
+		found = preferred + 8;
+	} else {
+		min = xkb_keymap_min_keycode(keymap);
+		max = xkb_keymap_max_keycode(keymap);
+		for (code = MAX(min, 8u); code <= max; code++) {
+			if (xkb_state_key_get_one_sym(state, code) == keysym) {
+				found = code;
+				break;
+			}
+		}
+	}
+
+	if (found == XKB_KEYCODE_INVALID)
+		return false;
+
+	xkb_state_update_key(state, found, XKB_KEY_DOWN);
+	*mask = xkb_state_serialize_mods(state, XKB_STATE_MODS_DEPRESSED);
+	xkb_state_update_key(state, found, XKB_KEY_UP);
+	*key = found - 8;
+
+	return *mask != 0;
+}
+
+static struct keysym_index_entry *
+index_keys(struct weston_keysym_index *index, struct xkb_state *state,
+	   struct keysym_index_entry *entry, uint32_t mods, bool main_block)
+{
+	xkb_keycode_t min, max, code;
+	const xkb_keysym_t *syms;
+
+	min = xkb_keymap_min_keycode(index->keymap);
+	max = xkb_keymap_max_keycode(index->keymap);
+
+	/* xkb key codes are evdev ones offset by 8 */
+	for (code = MAX(min, 8u); code <= max; code++) {
+		if (key_is_main_block(code - 8) != main_block)
+			continue;
+
+		if (xkb_state_key_get_syms(state, code, &syms) != 1)
+			continue;
+
+		if (syms[0] == XKB_KEY_NoSymbol ||
+		    hash_table_lookup(index->table, syms[0]))
+			continue;
+
+		entry->key = code - 8;
+		entry->mods = mods;
+		hash_table_insert(index->table, syms[0], entry);
+		entry++;
+	}
+
+	return entry;
+}
+
+/** Build a keysym to key code index of a keymap
+ *
+ * \param keymap The keymap to index, a reference is kept.
+ * \return The index, or NULL if the keymap cannot be queried.
+ *
+ * Only the first layout is indexed. Every keysym gets the key and the
+ * Shift and level 3 modifiers that produce it; keysyms that need other
+ * modifiers, e.g. NumLock on the keypad, are not indexed. Level 3 is
+ * only used if some key of the keymap produces ISO_Level3_Shift.
+ *
+ * \ingroup keyboard
+ */
+WL_EXPORT struct weston_keysym_index *
+weston_keysym_index_create(struct xkb_keymap *keymap)
+{
+	struct weston_keysym_index *index;
+	struct keysym_index_entry *entry;
+	struct xkb_state *state;
+	xkb_mod_mask_t shift_mask = 0, level3_mask = 0;
+	bool has_shift, has_level3;
+	unsigned int pass, i;
+
+	state = xkb_state_new(keymap);
+	if (!state)
+		return NULL;
+
+	index = xzalloc(sizeof *index);
+	index->keymap = xkb_keymap_ref(keymap);
+	index->table = hash_table_create();
+	abort_oom_if_null(index->table);
+
+	has_shift = find_modifier_key(keymap, state, XKB_KEY_Shift_L,
+				      KEY_LEFTSHIFT, &index->shift_key,
+				      &shift_mask);
+	has_level3 = find_modifier_key(keymap, state, XKB_KEY_ISO_Level3_Shift,
+				       KEY_RIGHTALT, &index->level3_key,
+				       &level3_mask);
+
+	/* Every key can add at most one keysym per combination */
+	index->entries = xcalloc((xkb_keymap_max_keycode(keymap) -
+				  xkb_keymap_min_keycode(keymap) + 1) *
+				 ARRAY_LENGTH(index_mods),
+				 sizeof *index->entries);
+	entry = index->entries;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < ARRAY_LENGTH(index_mods); i++) {
+			xkb_mod_mask_t mask = 0;
+
+			if (index_mods[i] & WESTON_KEYSYM_INDEX_MOD_SHIFT) {
+				if (!has_shift)
+					continue;
+				mask |= shift_mask;
+			}
+			if (index_mods[i] & WESTON_KEYSYM_INDEX_MOD_LEVEL3) {
+				if (!has_level3)
+					continue;
+				mask |= level3_mask;
+			}
+
+			xkb_state_update_mask(state, mask, 0, 0, 0, 0, 0);
+			entry = index_keys(index, state, entry,
+					   index_mods[i], pass == 0);
+		}
+	}
+
+	if (!has_shift)
+		index->shift_key = KEY_LEFTSHIFT;
+	if (!has_level3)
+		index->level3_key = KEY_RIGHTALT;
+
+	xkb_state_unref(state);
+
+	return index;
+}
+
+/** Destroy a keysym index
+ *
+ * \ingroup keyboard
+ */
+WL_EXPORT void
+weston_keysym_index_destroy(struct weston_keysym_index *index)
+{
+	if (!index)
+		return;
+
+	hash_table_destroy(index->table);
+	free(index->entries);
+	xkb_keymap_unref(index->keymap);
+	free(index);
+}
+
+/** The keymap a keysym index was built from
+ *
+ * \ingroup keyboard
+ */
+WL_EXPORT struct xkb_keymap *
+weston_keysym_index_get_keymap(const struct weston_keysym_index *index)
+{
+	return index->keymap;
+}
+
+/** The key to hold for a modifier of a lookup result
+ *
+ * \param index The index to ask.
+ * \param mod One of enum weston_keysym_index_mods.
+ * \return The evdev key code that produces the modifier in the keymap,
+ * e.g. the key mapped to ISO_Level3_Shift for level 3, which need not be
+ * KEY_RIGHTALT.
+ *
+ * \ingroup keyboard
+ */
+WL_EXPORT uint32_t
+weston_keysym_index_get_modifier_key(const struct weston_keysym_index *index,
+				     enum weston_keysym_index_mods mod)
+{
+	if (mod == WESTON_KEYSYM_INDEX_MOD_LEVEL3)
+		return index->level3_key;
+
+	return index->shift_key;
+}
+
+/** Find the key that types a keysym
+ *
+ * \param index The index to search.
+ * \param keysym The keysym to type.
+ * \param[out] key The evdev key code.
+ * \param[out] mods The enum weston_keysym_index_mods that must be held.
+ * \return True if the keysym can be typed with the keymap.
+ *
+ * \ingroup keyboard
+ */
+WL_EXPORT bool
+weston_keysym_index_lookup(const struct weston_keysym_index *index,
+			   uint32_t keysym, uint32_t *key, uint32_t *mods)
+{
+	const struct keysym_index_entry *entry;
+
+	entry = hash_table_lookup(index->table, keysym);
+	if (!entry)
+		return false;
+
+	*key = entry->key;
+	*mods = entry->mods;
+	return true;
+}
@@ -154,6 +154,9 @@ weston_buffer_release_reference(struct weston_buffer_release_reference *ref,
 void
 weston_binding_list_destroy_all(struct wl_list *list);
 
+void
+weston_binding_index_destroy(struct weston_binding_index *index);
+
 /* weston_compositor */
 
 void
@@ -162,6 +165,69 @@ touch_calibrator_mode_changed(struct weston_compositor *compositor);
 int
 noop_renderer_init(struct weston_compositor *ec);
 
+/** One paint node the no-op renderer would have drawn */
+struct weston_render_record_node {
+	struct weston_view *view;
+	struct weston_surface *surface;
+	/* damaged part of the view in global coordinates, clip removed */
+	pixman_region32_t repaint;
+	/* view->clip at the time of the repaint, global coordinates */
+	const pixman_region32_t *clip;
+	/* extents of repaint in output (framebuffer) coordinates */
+	pixman_box32_t dst;
+	/* extents of the sampled area in buffer coordinates */
+	pixman_box32_t src;
+	/* framebuffer pixels written */
+	uint64_t pixels;
+	bool needs_filtering;
+	bool blend;
+	bool valid_transform;
+	enum wl_output_transform transform;
+};
+
+/** SHM bytes a surface would have uploaded for a repaint */
+struct weston_render_record_upload {
+	struct weston_surface *surface;
+	uint64_t bytes;
+};
+
+/** Everything the no-op renderer would have done for one repaint
+ *
+ * Only valid for the duration of the recorder callback.
+ */
+struct weston_render_record {
+	struct weston_output *output;
+	/* output damage in global coordinates */
+	pixman_region32_t *damage;
+	/* struct weston_render_record_node, bottom-most first */
+	struct wl_array nodes;
+	/* struct weston_render_record_upload; a surface shown on several
+	 * outputs is only listed for the first of them to repaint */
+	struct wl_array uploads;
+	uint64_t upload_bytes;
+};
+
+typedef void (*weston_render_record_func_t)(const struct weston_render_record *record,
+					    void *data);
+
+int
+noop_renderer_set_recorder(struct weston_compositor *ec,
+			   weston_render_record_func_t func, void *data);
+
+/** Per-operation costs for weston_render_record_estimate_msec() */
+struct weston_render_cost_model {
+	double nsec_per_node;
+	double nsec_per_pixel;
+	/* added on top of nsec_per_pixel */
+	double nsec_per_blended_pixel;
+	double nsec_per_filtered_pixel;
+	double nsec_per_upload_byte;
+};
+
+double
+weston_render_record_estimate_msec(const struct weston_render_record *record,
+				   const struct weston_render_cost_model *model);
+
 void
 weston_compositor_add_head(struct weston_compositor *compositor,
 			   struct weston_head *head);
@@ -243,6 +309,26 @@ weston_compositor_set_presentation_clock(struct weston_compositor *compositor,
 int
 weston_compositor_set_presentation_clock_software(
 					struct weston_compositor *compositor);
+int
+weston_compositor_set_presentation_clock_virtual(
+					struct weston_compositor *compositor,
+					enum weston_virtual_clock_mode mode);
+void
+weston_compositor_advance_virtual_clock(struct weston_compositor *compositor,
+					int64_t nsec);
+
+struct weston_virtual_timer *
+weston_compositor_add_virtual_timer(struct weston_compositor *compositor,
+				    wl_event_loop_timer_func_t func,
+				    void *data);
+void
+weston_virtual_timer_arm(struct weston_virtual_timer *timer,
+			 const struct timespec *deadline);
+void
+weston_virtual_timer_disarm(struct weston_virtual_timer *timer);
+void
+weston_virtual_timer_destroy(struct weston_virtual_timer *timer);
+
 void
 weston_compositor_shutdown(struct weston_compositor *ec);
 
@@ -272,6 +358,41 @@ weston_plane_init(struct weston_plane *plane, struct weston_compositor *ec);
 void
 weston_plane_release(struct weston_plane *plane);
 
+/* weston_pointer_constraint */
+
+/** Effective confinement area of a pointer constraint
+ *
+ * Cached per constraint and rebuilt lazily after a surface commit, since
+ * both the input region and the constraint region only change there. All
+ * coordinates are surface-local, so moving or transforming the view does
+ * not invalidate it.
+ */
+struct weston_confine_region {
+	/* surface input region intersected with the constraint region */
+	pixman_region32_t region;
+	/* outline of region, struct border private to input.c:
+	 * horizontal borders sorted by y, vertical borders sorted by x */
+	struct wl_array horizontal;
+	struct wl_array vertical;
+	bool valid;
+};
+
+void
+weston_confine_region_init(struct weston_confine_region *confine);
+
+void
+weston_confine_region_fini(struct weston_confine_region *confine);
+
+void
+weston_confine_region_update(struct weston_confine_region *confine,
+			     pixman_region32_t *input,
+			     pixman_region32_t *constraint_region);
+
+struct weston_coord
+weston_confine_region_clamp_motion(const struct weston_confine_region *confine,
+				   struct weston_coord from,
+				   struct weston_coord to);
+
 /* weston_seat */
 
 struct clipboard *
@@ -409,16 +530,9 @@ weston_spring_update(struct weston_spring *spring, const struct timespec *time);
 
 /* weston_view */
 
-bool
-weston_view_is_opaque(struct weston_view *ev, pixman_region32_t *region);
-
 bool
 weston_view_has_valid_buffer(struct weston_view *ev);
 
-bool
-weston_view_matches_output_entirely(struct weston_view *ev,
-				    struct weston_output *output);
-
 bool
 weston_view_takes_input_at_point(struct weston_view *view,
 				 struct weston_coord_surface surf_pos);
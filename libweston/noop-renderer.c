@@ -30,12 +30,30 @@
 
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
+#include "backend.h"
+#include "pixel-formats.h"
+#include "shared/helpers.h"
 
 struct noop_renderer {
 	struct weston_renderer base;
 	unsigned char seed; /* see comment in attach() */
+
+	/* Optional recording, see noop_renderer_set_recorder() */
+	weston_render_record_func_t record_func;
+	void *record_data;
+	/* struct weston_render_record_upload, filled by flush_damage() */
+	struct wl_array uploads;
+	uint64_t upload_bytes;
 };
 
+static struct noop_renderer *
+get_renderer(struct weston_compositor *ec)
+{
+	struct noop_renderer *renderer;
+
+	return wl_container_of(ec->renderer, renderer, base);
+}
+
 static int
 noop_renderer_read_pixels(struct weston_output *output,
 			  const struct pixel_format_info *format, void *pixels,
@@ -45,11 +63,120 @@ noop_renderer_read_pixels(struct weston_output *output,
 	return 0;
 }
 
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int i, n;
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+static void
+record_paint_node(struct weston_render_record *record,
+		  struct weston_paint_node *pnode,
+		  pixman_region32_t *damage /* in global coordinates */)
+{
+	struct weston_view *view = pnode->view;
+	struct weston_render_record_node *node;
+	pixman_region32_t repaint;
+	pixman_region32_t output_region;
+	pixman_region32_t buffer_region;
+
+	/* Same region as the pixman renderer's draw_paint_node() */
+	pixman_region32_init(&repaint);
+	pixman_region32_intersect(&repaint,
+				  &view->transform.boundingbox, damage);
+	pixman_region32_subtract(&repaint, &repaint, &view->clip);
+
+	if (!pixman_region32_not_empty(&repaint)) {
+		pixman_region32_fini(&repaint);
+		return;
+	}
+
+	node = wl_array_add(&record->nodes, sizeof *node);
+	if (!node) {
+		pixman_region32_fini(&repaint);
+		return;
+	}
+
+	pixman_region32_init(&output_region);
+	weston_region_global_to_output(&output_region, pnode->output, &repaint);
+
+	pixman_region32_init(&buffer_region);
+	weston_matrix_transform_region(&buffer_region,
+				       &pnode->output_to_buffer_matrix,
+				       &output_region);
+
+	node->view = view;
+	node->surface = pnode->surface;
+	node->repaint = repaint;
+	node->clip = &view->clip;
+	node->dst = *pixman_region32_extents(&output_region);
+	node->src = *pixman_region32_extents(&buffer_region);
+	node->pixels = region_area(&output_region);
+	node->needs_filtering = pnode->needs_filtering;
+	node->blend = !weston_view_is_opaque(view, &repaint);
+	node->valid_transform = pnode->valid_transform;
+	node->transform = pnode->transform;
+
+	pixman_region32_fini(&buffer_region);
+	pixman_region32_fini(&output_region);
+}
+
+static void
+noop_renderer_record(struct noop_renderer *renderer,
+		     struct weston_output *output,
+		     pixman_region32_t *output_damage)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_render_record record = {
+		.output = output,
+		.damage = output_damage,
+		.uploads = renderer->uploads,
+		.upload_bytes = renderer->upload_bytes,
+	};
+	struct weston_render_record_node *node;
+	struct weston_paint_node *pnode;
+
+	wl_array_init(&record.nodes);
+
+	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
+				 z_order_link) {
+		if (pnode->view->plane != &compositor->primary_plane)
+			continue;
+		if (!pnode->surface->buffer_ref.buffer)
+			continue;
+
+		record_paint_node(&record, pnode, output_damage);
+	}
+
+	renderer->record_func(&record, renderer->record_data);
+
+	wl_array_for_each(node, &record.nodes)
+		pixman_region32_fini(&node->repaint);
+	wl_array_release(&record.nodes);
+
+	/* Uploads are flushed right before the repaint that uses them */
+	renderer->uploads.size = 0;
+	renderer->upload_bytes = 0;
+}
+
 static void
 noop_renderer_repaint_output(struct weston_output *output,
 			     pixman_region32_t *output_damage,
 			     struct weston_renderbuffer *renderbuffer)
 {
+	struct noop_renderer *renderer = get_renderer(output->compositor);
+
+	if (renderer->record_func)
+		noop_renderer_record(renderer, output, output_damage);
 }
 
 static bool
@@ -65,6 +192,36 @@ static void
 noop_renderer_flush_damage(struct weston_surface *surface,
 			   struct weston_buffer *buffer)
 {
+	struct noop_renderer *renderer = get_renderer(surface->compositor);
+	struct weston_render_record_upload *upload;
+	pixman_box32_t *rects;
+	uint64_t bytes = 0;
+	int i, n;
+
+	if (!renderer->record_func || !buffer->pixel_format)
+		return;
+
+	/* Mirror what the GL renderer uploads: the damaged buffer
+	 * rectangles of the first plane. */
+	rects = pixman_region32_rectangles(&surface->damage, &n);
+	for (i = 0; i < n; i++) {
+		pixman_box32_t r = weston_surface_to_buffer_rect(surface,
+								 rects[i]);
+
+		bytes += (uint64_t)(r.x2 - r.x1) * (r.y2 - r.y1) *
+			 buffer->pixel_format->bpp / 8;
+	}
+
+	if (bytes == 0)
+		return;
+
+	upload = wl_array_add(&renderer->uploads, sizeof *upload);
+	if (!upload)
+		return;
+
+	upload->surface = surface;
+	upload->bytes = bytes;
+	renderer->upload_bytes += bytes;
 }
 
 static void
@@ -119,6 +276,7 @@ noop_renderer_destroy(struct weston_compositor *ec)
 		wl_container_of(ec->renderer, renderer, base);
 
 	weston_log("no-op renderer SHM seed: %d\n", renderer->seed);
+	wl_array_release(&renderer->uploads);
 	free(ec->renderer);
 	ec->renderer = NULL;
 }
@@ -139,7 +297,73 @@ noop_renderer_init(struct weston_compositor *ec)
 	renderer->base.attach = noop_renderer_attach;
 	renderer->base.destroy = noop_renderer_destroy;
 	renderer->base.type = WESTON_RENDERER_NOOP;
+	wl_array_init(&renderer->uploads);
 	ec->renderer = &renderer->base;
 
 	return 0;
 }
+
+/** Record what every repaint would have drawn
+ *
+ * \param ec The compositor, which must use the no-op renderer.
+ * \param func Called at the end of every output repaint, or NULL to stop
+ * recording.
+ * \param data User data passed to \c func.
+ * \return 0 on success, -1 if the compositor uses another renderer.
+ *
+ * For each repaint, \c func gets the paint nodes the pixman renderer would
+ * have composited, bottom-most first, with the damaged region, the source
+ * and destination rectangles, filtering and blending, and the SHM bytes
+ * that were flushed for it. Nothing is rasterized.
+ *
+ * A surface's damage is flushed once per repaint pass, so when it spans
+ * several outputs its upload is charged to whichever of them repaints
+ * first, like the GL renderer's texture upload. Sum the records of a pass
+ * to get the uploads of all outputs.
+ */
+WESTON_EXPORT_FOR_TESTS int
+noop_renderer_set_recorder(struct weston_compositor *ec,
+			   weston_render_record_func_t func, void *data)
+{
+	struct noop_renderer *renderer;
+
+	if (!ec->renderer || ec->renderer->type != WESTON_RENDERER_NOOP)
+		return -1;
+
+	renderer = get_renderer(ec);
+	renderer->record_func = func;
+	renderer->record_data = data;
+	renderer->uploads.size = 0;
+	renderer->upload_bytes = 0;
+
+	return 0;
+}
+
+/** Estimate the CPU time a recorded repaint would take
+ *
+ * \param record The repaint, as passed to the recorder callback.
+ * \param model The cost of each operation, measured on the target.
+ * \return The estimated render time in milliseconds.
+ */
+WESTON_EXPORT_FOR_TESTS double
+weston_render_record_estimate_msec(const struct weston_render_record *record,
+				   const struct weston_render_cost_model *model)
+{
+	const struct weston_render_record_node *node;
+	double nsec = 0.0;
+
+	wl_array_for_each(node, &record->nodes) {
+		double per_pixel = model->nsec_per_pixel;
+
+		if (node->blend)
+			per_pixel += model->nsec_per_blended_pixel;
+		if (node->needs_filtering)
+			per_pixel += model->nsec_per_filtered_pixel;
+
+		nsec += model->nsec_per_node + per_pixel * node->pixels;
+	}
+
+	nsec += model->nsec_per_upload_byte * record->upload_bytes;
+
+	return nsec / 1e6;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <libweston/libweston.h>
+#include "shared/xalloc.h"
+
+/* Make sure the extra words can hold the given ID */
+static void
+weston_output_set_reserve(struct weston_output_set *set, uint32_t id)
+{
+	uint32_t n_extra = id / 32;
+
+	if (n_extra <= set->n_extra)
+		return;
+
+	set->extra = xrealloc(set->extra, n_extra * sizeof(*set->extra));
+	memset(set->extra + set->n_extra, 0,
+	       (n_extra - set->n_extra) * sizeof(*set->extra));
+	set->n_extra = n_extra;
+}
+
+/** Add an output ID to the set
+ *
+ * \param set The set to modify.
+ * \param id The weston_output::id to add.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_add(struct weston_output_set *set, uint32_t id)
+{
+	if (id < 32) {
+		set->bits |= 1u << id;
+		return;
+	}
+
+	weston_output_set_reserve(set, id);
+	set->extra[id / 32 - 1] |= 1u << (id % 32);
+}
+
+/** Remove an output ID from the set
+ *
+ * \param set The set to modify.
+ * \param id The weston_output::id to remove.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_remove(struct weston_output_set *set, uint32_t id)
+{
+	uint32_t word;
+
+	if (id < 32) {
+		set->bits &= ~(1u << id);
+		return;
+	}
+
+	word = id / 32 - 1;
+	if (word < set->n_extra)
+		set->extra[word] &= ~(1u << (id % 32));
+}
+
+/** Remove all output IDs from the set
+ *
+ * The storage is kept, so that refilling the set does not allocate again.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_clear(struct weston_output_set *set)
+{
+	set->bits = 0;
+	if (set->n_extra)
+		memset(set->extra, 0, set->n_extra * sizeof(*set->extra));
+}
+
+/** Release the storage of the set
+ *
+ * The set is left empty and may be used again.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_fini(struct weston_output_set *set)
+{
+	free(set->extra);
+	set->bits = 0;
+	set->extra = NULL;
+	set->n_extra = 0;
+}
+
+/** Test whether the set has no output IDs
+ *
+ * \ingroup output
+ */
+WL_EXPORT bool
+weston_output_set_is_empty(const struct weston_output_set *set)
+{
+	uint32_t i;
+
+	if (set->bits)
+		return false;
+
+	for (i = 0; i < set->n_extra; i++)
+		if (set->extra[i])
+			return false;
+
+	return true;
+}
+
+/** Test whether the set holds exactly one output ID
+ *
+ * \param set The set to test.
+ * \param id The only weston_output::id the set may hold.
+ * \return True if \c id is in the set and nothing else is.
+ *
+ * \ingroup output
+ */
+WL_EXPORT bool
+weston_output_set_is_single(const struct weston_output_set *set, uint32_t id)
+{
+	uint32_t word = id / 32;
+	uint32_t expected;
+	uint32_t i;
+
+	/* word 0 is the inline one, word i is extra[i - 1] */
+	for (i = 0; i <= set->n_extra; i++) {
+		expected = (i == word) ? 1u << (id % 32) : 0;
+		if ((i == 0 ? set->bits : set->extra[i - 1]) != expected)
+			return false;
+	}
+
+	return word <= set->n_extra;
+}
+
+/** Test whether two sets hold the same output IDs
+ *
+ * \ingroup output
+ */
+WL_EXPORT bool
+weston_output_set_equal(const struct weston_output_set *a,
+			const struct weston_output_set *b)
+{
+	const struct weston_output_set *longer = a;
+	uint32_t common = a->n_extra;
+	uint32_t i;
+
+	if (a->bits != b->bits)
+		return false;
+
+	if (b->n_extra < common)
+		common = b->n_extra;
+	else
+		longer = b;
+
+	for (i = 0; i < common; i++)
+		if (a->extra[i] != b->extra[i])
+			return false;
+
+	for (; i < longer->n_extra; i++)
+		if (longer->extra[i])
+			return false;
+
+	return true;
+}
+
+/** Make one set hold the same output IDs as another
+ *
+ * \param dst The set to overwrite.
+ * \param src The set to copy from.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_copy(struct weston_output_set *dst,
+		       const struct weston_output_set *src)
+{
+	weston_output_set_clear(dst);
+	weston_output_set_union(dst, src);
+}
+
+/** Add all output IDs of one set to another
+ *
+ * \param dst The set to add to.
+ * \param src The set to add from.
+ *
+ * \ingroup output
+ */
+WL_EXPORT void
+weston_output_set_union(struct weston_output_set *dst,
+			const struct weston_output_set *src)
+{
+	uint32_t n_extra = src->n_extra;
+	uint32_t i;
+
+	dst->bits |= src->bits;
+
+	/* Only grow for words that actually have bits */
+	while (n_extra > 0 && src->extra[n_extra - 1] == 0)
+		n_extra--;
+
+	if (n_extra == 0)
+		return;
+
+	weston_output_set_reserve(dst, n_extra * 32);
+	for (i = 0; i < n_extra; i++)
+		dst->extra[i] |= src->extra[i];
+}
+
+/** Find the lowest output ID not in the set
+ *
+ * \ingroup output
+ */
+WL_EXPORT uint32_t
+weston_output_set_first_free(const struct weston_output_set *set)
+{
+	uint32_t i;
+
+	if (~set->bits)
+		return ffs(~set->bits) - 1;
+
+	for (i = 0; i < set->n_extra; i++)
+		if (~set->extra[i])
+			return (i + 1) * 32 + ffs(~set->extra[i]) - 1;
+
+	return (set->n_extra + 1) * 32;
+}
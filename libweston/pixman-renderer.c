@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <math.h>
 
 #include "pixman-renderer.h"
 #include "color.h"
@@ -52,6 +53,10 @@ struct pixman_output_state {
 	struct wl_list renderbuffer_list;
 };
 
+/* Deepest prescaled level, i.e. views are never sampled from a copy
+ * smaller than 1/16th of the buffer in each direction. */
+#define PIXMAN_PRESCALED_MAX_LEVELS 4
+
 struct pixman_surface_state {
 	struct weston_surface *surface;
 
@@ -59,6 +64,15 @@ struct pixman_surface_state {
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_release_reference buffer_release_ref;
 
+	/* Box-filtered copies of image for heavily downscaled views,
+	 * levels[i] being downscaled by 2^(i+1). Created on demand. */
+	struct {
+		pixman_image_t *levels[PIXMAN_PRESCALED_MAX_LEVELS];
+		int n_levels;
+		/* stale area of all levels, in buffer coordinates */
+		pixman_region32_t damage;
+	} prescaled;
+
 	struct wl_listener buffer_destroy_listener;
 	struct wl_listener surface_destroy_listener;
 	struct wl_listener renderer_destroy_listener;
@@ -307,6 +321,148 @@ composite_clipped(struct weston_output *output,
 	}
 }
 
+static void
+prescaled_release(struct pixman_surface_state *ps)
+{
+	int i;
+
+	for (i = 0; i < ps->prescaled.n_levels; i++) {
+		pixman_image_unref(ps->prescaled.levels[i]);
+		ps->prescaled.levels[i] = NULL;
+	}
+	ps->prescaled.n_levels = 0;
+	pixman_region32_clear(&ps->prescaled.damage);
+}
+
+/* Scale a region down by 2^level, rounding outwards */
+static void
+region_scale_down(pixman_region32_t *dst, pixman_region32_t *src, int level)
+{
+	pixman_box32_t *boxes;
+	pixman_box32_t *scaled;
+	int round = (1 << level) - 1;
+	int n_box;
+	int i;
+
+	boxes = pixman_region32_rectangles(src, &n_box);
+	scaled = xcalloc(MAX(n_box, 1), sizeof *scaled);
+	for (i = 0; i < n_box; i++) {
+		scaled[i].x1 = boxes[i].x1 >> level;
+		scaled[i].y1 = boxes[i].y1 >> level;
+		scaled[i].x2 = (boxes[i].x2 + round) >> level;
+		scaled[i].y2 = (boxes[i].y2 + round) >> level;
+	}
+
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, scaled, n_box);
+	free(scaled);
+}
+
+/* How many times the view can be halved before it is sampled with less than
+ * one source pixel per output pixel. Bilinear filtering of anything beyond
+ * 2:1 skips source pixels, which both aliases and walks the full-size
+ * image for nothing. */
+static int
+prescaled_level_for_node(struct weston_paint_node *pnode)
+{
+	const struct weston_matrix *m = &pnode->output_to_buffer_matrix;
+	double scale;
+	int level = 0;
+
+	/* buffer pixels per output pixel, along both output axes */
+	scale = MIN(hypot(m->d[0], m->d[1]), hypot(m->d[4], m->d[5]));
+
+	while (level < PIXMAN_PRESCALED_MAX_LEVELS &&
+	       scale >= (double)(2 << level))
+		level++;
+
+	return level;
+}
+
+/* Halve src into dst, on the dst area covered by clip. Sampling bilinearly
+ * exactly in between four source pixels is a 2x2 box filter. */
+static void
+prescaled_downsample(pixman_image_t *src, pixman_image_t *dst,
+		     pixman_region32_t *clip)
+{
+	pixman_transform_t transform;
+
+	pixman_transform_init_scale(&transform, pixman_int_to_fixed(2),
+				    pixman_int_to_fixed(2));
+	pixman_image_set_transform(src, &transform);
+	pixman_image_set_filter(src, PIXMAN_FILTER_BILINEAR, NULL, 0);
+	pixman_image_set_repeat(src, PIXMAN_REPEAT_PAD);
+
+	pixman_image_set_clip_region32(dst, clip);
+	pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, dst,
+				 0, 0, /* src_x, src_y */
+				 0, 0, /* mask_x, mask_y */
+				 0, 0, /* dest_x, dest_y */
+				 pixman_image_get_width(dst),
+				 pixman_image_get_height(dst));
+	pixman_image_set_clip_region32(dst, NULL);
+
+	pixman_image_set_transform(src, NULL);
+	pixman_image_set_repeat(src, PIXMAN_REPEAT_NONE);
+}
+
+/* Returns the prescaled copy for level (>= 1), bringing all levels up to
+ * date with the surface damage first, or NULL if it cannot be created. */
+static pixman_image_t *
+prescaled_get_level(struct pixman_surface_state *ps, int level)
+{
+	pixman_image_t *src = ps->image;
+	pixman_format_code_t format;
+	pixman_region32_t damage;
+	int width = pixman_image_get_width(ps->image);
+	int height = pixman_image_get_height(ps->image);
+	int n_levels = MAX(level, ps->prescaled.n_levels);
+	int i;
+
+	assert(level >= 1 && level <= PIXMAN_PRESCALED_MAX_LEVELS);
+
+	if (PIXMAN_FORMAT_A(pixman_image_get_format(ps->image)))
+		format = PIXMAN_a8r8g8b8;
+	else
+		format = PIXMAN_x8r8g8b8;
+
+	pixman_region32_init(&damage);
+	pixman_region32_copy(&damage, &ps->prescaled.damage);
+
+	for (i = 0; i < n_levels; i++) {
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		region_scale_down(&damage, &damage, 1);
+
+		if (i >= ps->prescaled.n_levels) {
+			ps->prescaled.levels[i] =
+				pixman_image_create_bits(format, width, height,
+							 NULL, 0);
+			if (!ps->prescaled.levels[i])
+				break;
+			ps->prescaled.n_levels = i + 1;
+
+			pixman_region32_fini(&damage);
+			pixman_region32_init_rect(&damage, 0, 0,
+						  width, height);
+		}
+
+		if (pixman_region32_not_empty(&damage))
+			prescaled_downsample(src, ps->prescaled.levels[i],
+					     &damage);
+
+		src = ps->prescaled.levels[i];
+	}
+
+	pixman_region32_fini(&damage);
+	pixman_region32_clear(&ps->prescaled.damage);
+
+	if (ps->prescaled.n_levels < level)
+		return NULL;
+
+	return ps->prescaled.levels[level - 1];
+}
+
 /** Paint an intersected region
  *
  * \param pnode The paint node to be painted.
@@ -328,10 +484,13 @@ repaint_region(struct weston_paint_node *pnode,
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	struct pixman_output_state *po = get_output_state(output);
 	pixman_image_t *target_image;
+	pixman_image_t *src_image = ps->image;
 	pixman_transform_t transform;
 	pixman_filter_t filter;
 	pixman_image_t *mask_image;
 	pixman_color_t mask = { 0, };
+	pixman_region32_t prescaled_clip;
+	int level = 0;
 
 	if (po->shadow_image)
 		target_image = po->shadow_image;
@@ -352,6 +511,29 @@ repaint_region(struct weston_paint_node *pnode,
 	if (ps->buffer_ref.buffer)
 		wl_shm_buffer_begin_access(ps->buffer_ref.buffer->shm_buffer);
 
+	/* Sample heavily downscaled views from a prescaled copy instead */
+	if (pnode->needs_filtering && ps->buffer_ref.buffer)
+		level = prescaled_level_for_node(pnode);
+	if (level > 0) {
+		pixman_image_t *prescaled = prescaled_get_level(ps, level);
+
+		if (prescaled) {
+			pixman_fixed_t s =
+				pixman_double_to_fixed(1.0 / (1 << level));
+
+			src_image = prescaled;
+			pixman_transform_scale(&transform, NULL, s, s);
+		} else {
+			level = 0;
+		}
+	}
+
+	pixman_region32_init(&prescaled_clip);
+	if (source_clip && level > 0) {
+		region_scale_down(&prescaled_clip, source_clip, level);
+		source_clip = &prescaled_clip;
+	}
+
 	if (ev->alpha < 1.0) {
 		mask.alpha = 0xffff * ev->alpha;
 		mask_image = pixman_image_create_solid_fill(&mask);
@@ -360,15 +542,17 @@ repaint_region(struct weston_paint_node *pnode,
 	}
 
 	if (source_clip)
-		composite_clipped(output, ps->image, mask_image, target_image,
+		composite_clipped(output, src_image, mask_image, target_image,
 				  &transform, filter, source_clip);
 	else
-		composite_whole(pixman_op, ps->image, mask_image,
+		composite_whole(pixman_op, src_image, mask_image,
 				target_image, &transform, filter);
 
 	if (mask_image)
 		pixman_image_unref(mask_image);
 
+	pixman_region32_fini(&prescaled_clip);
+
 	if (ps->buffer_ref.buffer)
 		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
 
@@ -689,7 +873,25 @@ static void
 pixman_renderer_flush_damage(struct weston_surface *surface,
 			     struct weston_buffer *buffer)
 {
-	/* No-op for pixman renderer */
+	struct pixman_surface_state *ps = get_surface_state(surface);
+	pixman_box32_t *rects;
+	int i, n;
+
+	/* The client image itself is sampled directly, only the prescaled
+	 * copies need to know what changed. */
+	if (ps->prescaled.n_levels == 0)
+		return;
+
+	rects = pixman_region32_rectangles(&surface->damage, &n);
+	for (i = 0; i < n; i++) {
+		pixman_box32_t r;
+
+		r = weston_surface_to_buffer_rect(surface, rects[i]);
+		pixman_region32_union_rect(&ps->prescaled.damage,
+					   &ps->prescaled.damage,
+					   r.x1, r.y1,
+					   r.x2 - r.x1, r.y2 - r.y1);
+	}
 }
 
 static void
@@ -708,24 +910,50 @@ buffer_state_handle_buffer_destroy(struct wl_listener *listener, void *data)
 	ps->buffer_destroy_listener.notify = NULL;
 }
 
+struct pixman_solid_buffer_state {
+	pixman_image_t *image;
+	struct wl_listener destroy_listener;
+};
+
 static void
-pixman_renderer_surface_set_color(struct weston_surface *es,
-		 float red, float green, float blue, float alpha)
+solid_buffer_state_handle_buffer_destroy(struct wl_listener *listener,
+					 void *data)
 {
-	struct pixman_surface_state *ps = get_surface_state(es);
+	struct pixman_solid_buffer_state *sbs =
+		container_of(listener, struct pixman_solid_buffer_state,
+			     destroy_listener);
+	struct weston_buffer *buffer = data;
+
+	assert(buffer->renderer_private == sbs);
+	buffer->renderer_private = NULL;
+
+	wl_list_remove(&sbs->destroy_listener.link);
+	pixman_image_unref(sbs->image);
+	free(sbs);
+}
+
+/* Solid buffers are shared between surfaces, so is their fill image */
+static pixman_image_t *
+get_solid_buffer_image(struct weston_buffer *buffer)
+{
+	struct pixman_solid_buffer_state *sbs = buffer->renderer_private;
 	pixman_color_t color;
 
-	color.red = red * 0xffff;
-	color.green = green * 0xffff;
-	color.blue = blue * 0xffff;
-	color.alpha = alpha * 0xffff;
+	if (sbs)
+		return sbs->image;
 
-	if (ps->image) {
-		pixman_image_unref(ps->image);
-		ps->image = NULL;
-	}
+	color.red = buffer->solid.r * 0xffff;
+	color.green = buffer->solid.g * 0xffff;
+	color.blue = buffer->solid.b * 0xffff;
+	color.alpha = buffer->solid.a * 0xffff;
 
-	ps->image = pixman_image_create_solid_fill(&color);
+	sbs = xzalloc(sizeof *sbs);
+	sbs->image = pixman_image_create_solid_fill(&color);
+	sbs->destroy_listener.notify = solid_buffer_state_handle_buffer_destroy;
+	wl_signal_add(&buffer->destroy_signal, &sbs->destroy_listener);
+	buffer->renderer_private = sbs;
+
+	return sbs->image;
 }
 
 static void
@@ -746,6 +974,16 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		ps->buffer_destroy_listener.notify = NULL;
 	}
 
+	/* Damage keeps the prescaled copies valid across buffers of the same
+	 * size and format; anything else starts over. */
+	if (ps->prescaled.n_levels > 0 &&
+	    (!buffer || buffer->type != WESTON_BUFFER_SHM || !ps->image ||
+	     pixman_image_get_width(ps->image) != buffer->width ||
+	     pixman_image_get_height(ps->image) != buffer->height ||
+	     pixman_image_get_format(ps->image) !=
+	     buffer->pixel_format->pixman_format))
+		prescaled_release(ps);
+
 	if (ps->image) {
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
@@ -755,11 +993,7 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		return;
 
 	if (buffer->type == WESTON_BUFFER_SOLID) {
-		pixman_renderer_surface_set_color(es,
-						  buffer->solid.r,
-						  buffer->solid.g,
-						  buffer->solid.b,
-						  buffer->solid.a);
+		ps->image = pixman_image_ref(get_solid_buffer_image(buffer));
 		weston_buffer_reference(&ps->buffer_ref, NULL,
 					BUFFER_WILL_NOT_BE_ACCESSED);
 		weston_buffer_release_reference(&ps->buffer_release_ref, NULL);
@@ -815,6 +1049,8 @@ pixman_renderer_surface_state_destroy(struct pixman_surface_state *ps)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	prescaled_release(ps);
+	pixman_region32_fini(&ps->prescaled.damage);
 	weston_buffer_reference(&ps->buffer_ref, NULL,
 				BUFFER_WILL_NOT_BE_ACCESSED);
 	weston_buffer_release_reference(&ps->buffer_release_ref, NULL);
@@ -856,6 +1092,7 @@ pixman_renderer_create_surface(struct weston_surface *surface)
 	surface->renderer_state = ps;
 
 	ps->surface = surface;
+	pixman_region32_init(&ps->prescaled.damage);
 
 	ps->surface_destroy_listener.notify =
 		surface_state_handle_surface_destroy;
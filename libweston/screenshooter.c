@@ -34,6 +34,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <pthread.h>
 
 #include <libweston/libweston.h>
 #include "shared/helpers.h"
@@ -53,25 +54,9 @@ struct screenshooter_frame_listener {
 	void *data;
 };
 
-static void
-copy_bgra_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
-
-	end = dst + height * stride;
-	while (dst < end) {
-		memcpy(dst, src, stride);
-		dst += stride;
-		src -= stride;
-	}
-}
-
-static void
-copy_bgra(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	/* TODO: optimize this out */
-	memcpy(dst, src, height * stride);
-}
+/* Upper bound for the intermediate buffer used when the pixels need to be
+ * flipped or swizzled: a band of rows small enough to stay in cache. */
+#define SCREENSHOOTER_BAND_BYTES (256 * 1024)
 
 static void
 copy_row_swap_RB(void *vdst, void *vsrc, int bytes)
@@ -90,30 +75,47 @@ copy_row_swap_RB(void *vdst, void *vsrc, int bytes)
 	}
 }
 
-static void
-copy_rgba_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
+/* Read the output back in bands of rows, and write every band to its final
+ * place in the client buffer, flipped and swizzled as needed. */
+static int
+screenshooter_read_bands(struct weston_output *output,
+			 uint8_t *dst, int32_t dst_stride,
+			 bool yflip, bool swap_rb)
 {
-	uint8_t *end;
+	struct weston_compositor *compositor = output->compositor;
+	const struct pixel_format_info *format = compositor->read_format;
+	int32_t width = output->current_mode->width;
+	int32_t height = output->current_mode->height;
+	int32_t row_bytes, band_rows, rows, y, i, dst_y;
+	uint8_t *band;
+
+	row_bytes = width * (PIXMAN_FORMAT_BPP(format->pixman_format) / 8);
+	band_rows = MAX(1, SCREENSHOOTER_BAND_BYTES / row_bytes);
+	band_rows = MIN(band_rows, height);
+	band = malloc(band_rows * row_bytes);
+	if (!band)
+		return -1;
 
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src -= stride;
+	for (y = 0; y < height; y += rows) {
+		rows = MIN(band_rows, height - y);
+		compositor->renderer->read_pixels(output, format, band,
+						  0, y, width, rows);
+
+		for (i = 0; i < rows; i++) {
+			dst_y = yflip ? height - 1 - (y + i) : y + i;
+			if (swap_rb)
+				copy_row_swap_RB(dst + dst_y * dst_stride,
+						 band + i * row_bytes,
+						 row_bytes);
+			else
+				memcpy(dst + dst_y * dst_stride,
+				       band + i * row_bytes, row_bytes);
+		}
 	}
-}
 
-static void
-copy_rgba(uint8_t *dst, uint8_t *src, int height, int stride)
-{
-	uint8_t *end;
+	free(band);
 
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src += stride;
-	}
+	return 0;
 }
 
 static void
@@ -127,57 +129,54 @@ screenshooter_frame_notify(struct wl_listener *listener, void *data)
 	struct weston_compositor *compositor = output->compositor;
 	const pixman_format_code_t pixman_format =
 		compositor->read_format->pixman_format;
+	bool yflip = compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP;
+	bool swap_rb;
+	int32_t width = output->current_mode->width;
+	int32_t height = output->current_mode->height;
 	int32_t stride;
-	uint8_t *pixels, *d, *s;
+	uint8_t *d;
+	int ret = 0;
 
 	weston_output_disable_planes_decr(output);
 	wl_list_remove(&listener->link);
 	wl_list_remove(&l->buffer_destroy_listener.link);
 
-	stride = l->buffer->width * (PIXMAN_FORMAT_BPP(pixman_format) / 8);
-	pixels = malloc(stride * l->buffer->height);
-
-	if (pixels == NULL) {
-		l->done(l->data, WESTON_SCREENSHOOTER_NO_MEMORY);
-		free(l);
-		return;
-	}
-
-	compositor->renderer->read_pixels(output,
-			     compositor->read_format, pixels,
-			     0, 0, output->current_mode->width,
-			     output->current_mode->height);
-
-	stride = wl_shm_buffer_get_stride(l->buffer->shm_buffer);
-
-	d = wl_shm_buffer_get_data(l->buffer->shm_buffer);
-	s = pixels + stride * (l->buffer->height - 1);
-
-	wl_shm_buffer_begin_access(l->buffer->shm_buffer);
-
 	switch (pixman_format) {
 	case PIXMAN_a8r8g8b8:
 	case PIXMAN_x8r8g8b8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_bgra_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_bgra(d, pixels, output->current_mode->height, stride);
+		swap_rb = false;
 		break;
 	case PIXMAN_x8b8g8r8:
 	case PIXMAN_a8b8g8r8:
-		if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-			copy_rgba_yflip(d, s, output->current_mode->height, stride);
-		else
-			copy_rgba(d, pixels, output->current_mode->height, stride);
+		swap_rb = true;
 		break;
 	default:
-		break;
+		l->done(l->data, WESTON_SCREENSHOOTER_SUCCESS);
+		free(l);
+		return;
 	}
 
+	stride = wl_shm_buffer_get_stride(l->buffer->shm_buffer);
+	d = wl_shm_buffer_get_data(l->buffer->shm_buffer);
+
+	wl_shm_buffer_begin_access(l->buffer->shm_buffer);
+
+	/* When the renderer already has the layout the client wants, read
+	 * straight into the client buffer without any copy at all. */
+	if (!yflip && !swap_rb && stride == width * 4)
+		compositor->renderer->read_pixels(output,
+						  compositor->read_format, d,
+						  0, 0, width, height);
+	else
+		ret = screenshooter_read_bands(output, d, stride,
+					       yflip, swap_rb);
+
 	wl_shm_buffer_end_access(l->buffer->shm_buffer);
 
-	l->done(l->data, WESTON_SCREENSHOOTER_SUCCESS);
-	free(pixels);
+	if (ret < 0)
+		l->done(l->data, WESTON_SCREENSHOOTER_NO_MEMORY);
+	else
+		l->done(l->data, WESTON_SCREENSHOOTER_SUCCESS);
 	free(l);
 }
 
@@ -238,14 +237,46 @@ weston_screenshooter_shoot(struct weston_output *output,
 	return 0;
 }
 
-struct weston_recorder {
+/* Encoding of the damaged rectangles of a frame is spread over at most
+ * this many threads, the compositor thread included. */
+#define RECORDER_MAX_THREADS 4
+
+struct recorder_job {
+	pixman_box32_t box;	/* in recording coordinates */
+	uint32_t *pixels;	/* as read back from the renderer */
+	uint32_t *encoded;
+	int encoded_len;	/* in 32-bit words */
+};
+
+struct weston_recorder_output {
+	struct weston_recorder *recorder;
 	struct weston_output *output;
-	uint32_t *frame, *rect;
-	uint32_t *tmpbuf;
+	int32_t x, y;		/* position in the recording */
+	struct wl_listener frame_listener;
+	struct wl_listener destroy_listener;
+	struct wl_list link;	/* weston_recorder::output_list */
+};
+
+struct weston_recorder {
+	struct weston_compositor *compositor;
+	struct wl_list output_list;
+	int32_t width, height;
+	bool yflip;
+	uint32_t *frame;
+	uint32_t *readback, *encoded;
 	uint32_t total;
+	uint32_t last_msecs;
 	int fd;
-	struct wl_listener frame_listener;
 	int count, destroying;
+
+	struct wl_array jobs;	/* struct recorder_job */
+	int n_jobs, next_job, jobs_done;
+	bool quit;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	pthread_t threads[RECORDER_MAX_THREADS - 1];
+	int n_threads;
 };
 
 static uint32_t *
@@ -282,137 +313,345 @@ component_delta(uint32_t next, uint32_t prev)
 static void
 weston_recorder_destroy(struct weston_recorder *recorder);
 
+static void
+recorder_job_encode(struct weston_recorder *recorder, struct recorder_job *job)
+{
+	int width = job->box.x2 - job->box.x1;
+	int height = job->box.y2 - job->box.y1;
+	uint32_t delta, prev, *d, *s, *p, next;
+	int j, k, run;
+
+	/* Rows are encoded bottom to top */
+	p = job->encoded;
+	run = prev = 0; /* quiet gcc */
+	for (j = 0; j < height; j++) {
+		if (recorder->yflip)
+			s = job->pixels + width * j;
+		else
+			s = job->pixels + width * (height - j - 1);
+		d = recorder->frame +
+		    recorder->width * (job->box.y2 - j - 1) + job->box.x1;
+
+		for (k = 0; k < width; k++) {
+			next = *s++;
+			delta = component_delta(next, *d);
+			*d++ = next;
+			if (run == 0 || delta == prev) {
+				run++;
+			} else {
+				p = output_run(p, prev, run);
+				run = 1;
+			}
+			prev = delta;
+		}
+	}
+
+	p = output_run(p, prev, run);
+	job->encoded_len = p - job->encoded;
+}
+
+/* Called with the mutex held, returns false when there is nothing left to
+ * take. Damage rectangles never overlap, so jobs touch disjoint parts of
+ * the frame. */
+static bool
+recorder_run_one_job(struct weston_recorder *recorder)
+{
+	struct recorder_job *job;
+
+	if (recorder->next_job == recorder->n_jobs)
+		return false;
+
+	job = (struct recorder_job *) recorder->jobs.data + recorder->next_job;
+	recorder->next_job++;
+
+	pthread_mutex_unlock(&recorder->mutex);
+	recorder_job_encode(recorder, job);
+	pthread_mutex_lock(&recorder->mutex);
+
+	recorder->jobs_done++;
+	if (recorder->jobs_done == recorder->n_jobs)
+		pthread_cond_signal(&recorder->done_cond);
+
+	return true;
+}
+
+static void *
+recorder_worker(void *data)
+{
+	struct weston_recorder *recorder = data;
+
+	pthread_mutex_lock(&recorder->mutex);
+	while (!recorder->quit) {
+		if (!recorder_run_one_job(recorder))
+			pthread_cond_wait(&recorder->work_cond,
+					  &recorder->mutex);
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+
+	return NULL;
+}
+
+static void
+recorder_run_jobs(struct weston_recorder *recorder)
+{
+	pthread_mutex_lock(&recorder->mutex);
+
+	recorder->n_jobs = recorder->jobs.size / sizeof(struct recorder_job);
+	recorder->next_job = 0;
+	recorder->jobs_done = 0;
+	pthread_cond_broadcast(&recorder->work_cond);
+
+	while (recorder_run_one_job(recorder))
+		;
+
+	while (recorder->jobs_done < recorder->n_jobs)
+		pthread_cond_wait(&recorder->done_cond, &recorder->mutex);
+
+	pthread_mutex_unlock(&recorder->mutex);
+}
+
+static void
+recorder_start_threads(struct weston_recorder *recorder)
+{
+	long n;
+	int i;
+
+	pthread_mutex_init(&recorder->mutex, NULL);
+	pthread_cond_init(&recorder->work_cond, NULL);
+	pthread_cond_init(&recorder->done_cond, NULL);
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	n = MIN(MAX(n, 1), RECORDER_MAX_THREADS);
+
+	for (i = 0; i < n - 1; i++) {
+		if (pthread_create(&recorder->threads[i], NULL,
+				   recorder_worker, recorder) != 0) {
+			weston_log("recorder: failed to start encoder thread\n");
+			break;
+		}
+		recorder->n_threads++;
+	}
+}
+
+static void
+recorder_stop_threads(struct weston_recorder *recorder)
+{
+	int i;
+
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->quit = true;
+	pthread_cond_broadcast(&recorder->work_cond);
+	pthread_mutex_unlock(&recorder->mutex);
+
+	for (i = 0; i < recorder->n_threads; i++)
+		pthread_join(recorder->threads[i], NULL);
+
+	pthread_cond_destroy(&recorder->done_cond);
+	pthread_cond_destroy(&recorder->work_cond);
+	pthread_mutex_destroy(&recorder->mutex);
+}
+
 static void
 weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 {
-	struct weston_recorder *recorder =
-		container_of(listener, struct weston_recorder, frame_listener);
-	struct weston_output *output = recorder->output;
+	struct weston_recorder_output *ro =
+		container_of(listener, struct weston_recorder_output,
+			     frame_listener);
+	struct weston_recorder *recorder = ro->recorder;
+	struct weston_output *output = ro->output;
 	struct weston_compositor *compositor = output->compositor;
 	uint32_t msecs = timespec_to_msec(&output->frame_time);
+	pixman_region32_t damage;
 	pixman_box32_t *r;
-	pixman_region32_t damage, transformed_damage;
-	int i, j, k, n, width, height, run, stride;
-	uint32_t delta, prev, *d, *s, *p, next;
-	struct {
-		uint32_t msecs;
-		uint32_t nrects;
-	} header;
+	struct recorder_job *job;
+	uint32_t *readback, *encoded;
+	int i, n, width, height, y_orig;
+	struct wcap_frame_header header;
 	struct iovec v[2];
-	int do_yflip;
-	int y_orig;
-	uint32_t *outbuf;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
-	if (do_yflip)
-		outbuf = recorder->rect;
-	else
-		outbuf = recorder->tmpbuf;
 
 	pixman_region32_init(&damage);
-	pixman_region32_init(&transformed_damage);
 	pixman_region32_intersect(&damage, &output->region, data);
-	weston_region_global_to_output(&transformed_damage,
-				       output,
-				       &damage);
-	pixman_region32_fini(&damage);
+	weston_region_global_to_output(&damage, output, &damage);
+	pixman_region32_translate(&damage, ro->x, ro->y);
 
-	r = pixman_region32_rectangles(&transformed_damage, &n);
-	if (n == 0) {
-		pixman_region32_fini(&transformed_damage);
-		return;
-	}
-
-	header.msecs = msecs;
-	header.nrects = n;
-	v[0].iov_base = &header;
-	v[0].iov_len = sizeof header;
-	v[1].iov_base = r;
-	v[1].iov_len = n * sizeof *r;
-	recorder->total += writev(recorder->fd, v, 2);
-	stride = output->current_mode->width;
+	r = pixman_region32_rectangles(&damage, &n);
+	if (n == 0)
+		goto out;
 
+	/* Read everything back first, the renderer is not thread safe */
+	recorder->jobs.size = 0;
+	readback = recorder->readback;
+	encoded = recorder->encoded;
 	for (i = 0; i < n; i++) {
 		width = r[i].x2 - r[i].x1;
 		height = r[i].y2 - r[i].y1;
 
-		if (do_yflip)
-			y_orig = output->current_mode->height - r[i].y2;
+		if (recorder->yflip)
+			y_orig = output->current_mode->height -
+				 (r[i].y2 - ro->y);
 		else
-			y_orig = r[i].y1;
+			y_orig = r[i].y1 - ro->y;
 
 		compositor->renderer->read_pixels(output,
-				compositor->read_format, recorder->rect,
-				r[i].x1, y_orig, width, height);
-
-		p = outbuf;
-		run = prev = 0; /* quiet gcc */
-		for (j = 0; j < height; j++) {
-			if (do_yflip)
-				s = recorder->rect + width * j;
-			else
-				s = recorder->rect + width * (height - j - 1);
-			y_orig = r[i].y2 - j - 1;
-			d = recorder->frame + stride * y_orig + r[i].x1;
-
-			for (k = 0; k < width; k++) {
-				next = *s++;
-				delta = component_delta(next, *d);
-				*d++ = next;
-				if (run == 0 || delta == prev) {
-					run++;
-				} else {
-					p = output_run(p, prev, run);
-					run = 1;
-				}
-				prev = delta;
-			}
+				compositor->read_format, readback,
+				r[i].x1 - ro->x, y_orig, width, height);
+
+		job = wl_array_add(&recorder->jobs, sizeof *job);
+		if (!job) {
+			weston_log("%s: out of memory\n", __func__);
+			goto out;
 		}
+		job->box = r[i];
+		job->pixels = readback;
+		job->encoded = encoded;
 
-		p = output_run(p, prev, run);
+		/* Run-length encoding never grows the data */
+		readback += width * height;
+		encoded += width * height;
+	}
 
-		recorder->total += write(recorder->fd,
-					 outbuf, (p - outbuf) * 4);
+	recorder_run_jobs(recorder);
 
-#if 0
-		fprintf(stderr,
-			"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
-			width, height, r[i].x1, r[i].y1,
-			width * height * 4, (int) (p - outbuf) * 4,
-			(float) (p - outbuf) / (width * height),
-			recorder->total / 1024 / 1024);
-#endif
-	}
+	/* Outputs repaint out of step, keep the timeline monotonic */
+	msecs = MAX(msecs, recorder->last_msecs);
+	recorder->last_msecs = msecs;
+
+	header.msecs = msecs;
+	header.nrects = n;
+	v[0].iov_base = &header;
+	v[0].iov_len = sizeof header;
+	v[1].iov_base = r;
+	v[1].iov_len = n * sizeof *r;
+	recorder->total += writev(recorder->fd, v, 2);
+
+	wl_array_for_each(job, &recorder->jobs)
+		recorder->total += write(recorder->fd, job->encoded,
+					 job->encoded_len * 4);
 
-	pixman_region32_fini(&transformed_damage);
 	recorder->count++;
 
+out:
+	pixman_region32_fini(&damage);
+
 	if (recorder->destroying)
 		weston_recorder_destroy(recorder);
 }
 
+static void
+weston_recorder_output_destroy(struct weston_recorder_output *ro)
+{
+	wl_list_remove(&ro->frame_listener.link);
+	wl_list_remove(&ro->destroy_listener.link);
+	wl_list_remove(&ro->link);
+	free(ro);
+}
+
+static void
+weston_recorder_output_destroy_handler(struct wl_listener *listener,
+				       void *data)
+{
+	struct weston_recorder_output *ro =
+		container_of(listener, struct weston_recorder_output,
+			     destroy_listener);
+
+	weston_log("recorder: output %s went away, no longer recording it\n",
+		   ro->output->name);
+	weston_recorder_output_destroy(ro);
+}
+
+static int
+weston_recorder_add_output(struct weston_recorder *recorder,
+			   struct weston_output *output, int32_t x, int32_t y)
+{
+	struct weston_recorder_output *ro;
+
+	ro = zalloc(sizeof *ro);
+	if (ro == NULL)
+		return -1;
+
+	ro->recorder = recorder;
+	ro->output = output;
+	ro->x = x;
+	ro->y = y;
+	wl_list_insert(recorder->output_list.prev, &ro->link);
+
+	ro->frame_listener.notify = weston_recorder_frame_notify;
+	wl_signal_add(&output->frame_signal, &ro->frame_listener);
+	ro->destroy_listener.notify = weston_recorder_output_destroy_handler;
+	wl_signal_add(&output->destroy_signal, &ro->destroy_listener);
+
+	weston_output_disable_planes_incr(output);
+	weston_output_damage(output);
+
+	return 0;
+}
+
 static void
 weston_recorder_free(struct weston_recorder *recorder)
 {
 	if (recorder == NULL)
 		return;
 
-	free(recorder->tmpbuf);
-	free(recorder->rect);
+	wl_array_release(&recorder->jobs);
+	free(recorder->encoded);
+	free(recorder->readback);
 	free(recorder->frame);
 	free(recorder);
 }
 
+/* Places the outputs in the recording. A single output is recorded as is,
+ * several outputs are laid out as in the global space, which needs them
+ * to share a scale and have no transform. */
+static int
+weston_recorder_layout(struct weston_compositor *compositor,
+		       struct weston_output *only,
+		       int32_t *width, int32_t *height)
+{
+	struct weston_output *output;
+	int32_t x1 = INT32_MAX, y1 = INT32_MAX, x2 = INT32_MIN, y2 = INT32_MIN;
+	int32_t scale = 0;
+
+	if (only) {
+		*width = only->current_mode->width;
+		*height = only->current_mode->height;
+		return 0;
+	}
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (output->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+		    (scale != 0 && output->current_scale != scale)) {
+			weston_log("recording all outputs needs them "
+				   "untransformed and with the same scale\n");
+			return -1;
+		}
+		scale = output->current_scale;
+
+		x1 = MIN(x1, output->x);
+		y1 = MIN(y1, output->y);
+		x2 = MAX(x2, output->x + output->width);
+		y2 = MAX(y2, output->y + output->height);
+	}
+
+	if (scale == 0) {
+		weston_log("no outputs to record\n");
+		return -1;
+	}
+
+	*width = (x2 - x1) * scale;
+	*height = (y2 - y1) * scale;
+
+	return 0;
+}
+
 static struct weston_recorder *
-weston_recorder_create(struct weston_output *output, const char *filename)
+weston_recorder_create(struct weston_compositor *compositor,
+		       struct weston_output *only, const char *filename)
 {
-	struct weston_compositor *compositor = output->compositor;
 	struct weston_recorder *recorder;
-	int stride, size;
-	struct { uint32_t magic, format, width, height; } header;
-	int do_yflip;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	struct weston_output *output;
+	struct wcap_header header;
+	int32_t min_x = INT32_MAX, min_y = INT32_MAX;
+	size_t size;
 
 	recorder = zalloc(sizeof *recorder);
 	if (recorder == NULL) {
@@ -420,25 +659,27 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		return NULL;
 	}
 
-	stride = output->current_mode->width;
-	size = stride * 4 * output->current_mode->height;
+	recorder->compositor = compositor;
+	recorder->yflip =
+		!!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	wl_list_init(&recorder->output_list);
+	wl_array_init(&recorder->jobs);
+
+	if (weston_recorder_layout(compositor, only,
+				   &recorder->width, &recorder->height) < 0)
+		goto err_recorder;
+
+	size = (size_t) recorder->width * recorder->height * 4;
 	recorder->frame = zalloc(size);
-	recorder->rect = malloc(size);
-	recorder->output = output;
+	recorder->readback = malloc(size);
+	recorder->encoded = malloc(size);
 
-	if ((recorder->frame == NULL) || (recorder->rect == NULL)) {
+	if (recorder->frame == NULL || recorder->readback == NULL ||
+	    recorder->encoded == NULL) {
 		weston_log("%s: out of memory\n", __func__);
 		goto err_recorder;
 	}
 
-	if (!do_yflip) {
-		recorder->tmpbuf = malloc(size);
-		if (recorder->tmpbuf == NULL) {
-			weston_log("%s: out of memory\n", __func__);
-			goto err_recorder;
-		}
-	}
-
 	header.magic = WCAP_HEADER_MAGIC;
 
 	switch (compositor->read_format->pixman_format) {
@@ -463,14 +704,30 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		goto err_recorder;
 	}
 
-	header.width = output->current_mode->width;
-	header.height = output->current_mode->height;
+	header.width = recorder->width;
+	header.height = recorder->height;
 	recorder->total += write(recorder->fd, &header, sizeof header);
 
-	recorder->frame_listener.notify = weston_recorder_frame_notify;
-	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
-	weston_output_disable_planes_incr(output);
-	weston_output_damage(output);
+	recorder_start_threads(recorder);
+
+	if (only) {
+		weston_recorder_add_output(recorder, only, 0, 0);
+	} else {
+		wl_list_for_each(output, &compositor->output_list, link) {
+			min_x = MIN(min_x, output->x);
+			min_y = MIN(min_y, output->y);
+		}
+		wl_list_for_each(output, &compositor->output_list, link)
+			weston_recorder_add_output(recorder, output,
+				(output->x - min_x) * output->current_scale,
+				(output->y - min_y) * output->current_scale);
+	}
+
+	if (wl_list_empty(&recorder->output_list)) {
+		weston_log("%s: out of memory\n", __func__);
+		weston_recorder_destroy(recorder);
+		return NULL;
+	}
 
 	return recorder;
 
@@ -482,14 +739,20 @@ err_recorder:
 static void
 weston_recorder_destroy(struct weston_recorder *recorder)
 {
-	wl_list_remove(&recorder->frame_listener.link);
+	struct weston_recorder_output *ro, *tmp;
+
+	wl_list_for_each_safe(ro, tmp, &recorder->output_list, link) {
+		weston_output_disable_planes_decr(ro->output);
+		weston_recorder_output_destroy(ro);
+	}
+
+	recorder_stop_threads(recorder);
 	close(recorder->fd);
-	weston_output_disable_planes_decr(recorder->output);
 	weston_recorder_free(recorder);
 }
 
-WL_EXPORT struct weston_recorder *
-weston_recorder_start(struct weston_output *output, const char *filename)
+static bool
+weston_recorder_is_running(struct weston_output *output)
 {
 	struct wl_listener *listener;
 
@@ -498,12 +761,46 @@ weston_recorder_start(struct weston_output *output, const char *filename)
 	if (listener) {
 		weston_log("a recorder on output %s is already running\n",
 			   output->name);
-		return NULL;
+		return true;
 	}
 
+	return false;
+}
+
+WL_EXPORT struct weston_recorder *
+weston_recorder_start(struct weston_output *output, const char *filename)
+{
+	if (weston_recorder_is_running(output))
+		return NULL;
+
 	weston_log("starting recorder for output %s, file %s\n",
 		   output->name, filename);
-	return weston_recorder_create(output, filename);
+	return weston_recorder_create(output->compositor, output, filename);
+}
+
+/** Record all outputs into a single WCAP stream
+ *
+ * The outputs are placed in the recording as they are laid out in the
+ * global space, and every output contributes its own damage to the one
+ * timeline as it repaints.
+ *
+ * \param compositor The compositor whose outputs to record.
+ * \param filename The file to write the recording to.
+ * \return The recorder, or NULL on failure.
+ */
+WL_EXPORT struct weston_recorder *
+weston_recorder_start_all_outputs(struct weston_compositor *compositor,
+				  const char *filename)
+{
+	struct weston_output *output;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (weston_recorder_is_running(output))
+			return NULL;
+	}
+
+	weston_log("starting recorder for all outputs, file %s\n", filename);
+	return weston_recorder_create(compositor, NULL, filename);
 }
 
 WL_EXPORT void
@@ -512,6 +809,12 @@ weston_recorder_stop(struct weston_recorder *recorder)
 	weston_log("stopping recorder, total file size %dM, %d frames\n",
 		   recorder->total / (1024 * 1024), recorder->count);
 
+	/* All recorded outputs went away, nothing will repaint */
+	if (wl_list_empty(&recorder->output_list)) {
+		weston_recorder_destroy(recorder);
+		return;
+	}
+
 	recorder->destroying = 1;
-	weston_output_schedule_repaint(recorder->output);
+	weston_compositor_schedule_repaint(recorder->compositor);
 }
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_SESSION_RECORD_H
+#define WESTON_SESSION_RECORD_H
+
+#include <stdint.h>
+
+/*
+ * File format shared by the compositor session recorder (weston
+ * --record-session) and weston-session-replay.
+ *
+ * The file starts with a struct session_record_file_header, followed by
+ * records. Every record is a struct session_record_header followed by
+ * 'size' bytes of payload. All values are in host byte order and every
+ * field of the payload is padded to 4 bytes.
+ *
+ * SESSION_RECORD_REQUEST payload:
+ *	uint32 object id, uint32 opcode, string interface name,
+ *	uint32 argument count, then for every argument a uint32 type
+ *	character from the message signature followed by its value:
+ *	- 'i', 'u', 'f', 'o', 'n': uint32, object ids are 0 for NULL
+ *	- 's': uint32 length including the terminator (0 for NULL), bytes
+ *	- 'a': uint32 size, bytes
+ *	- 'h': int32 size (-1 when the fd could not be read), contents
+ *
+ * A string is stored like an 's' argument.
+ *
+ * SESSION_RECORD_OBJECT_DESTROYED payload: uint32 object id.
+ *
+ * SESSION_RECORD_BUFFER_CONTENTS payload: uint32 wl_buffer id, uint32
+ * size, bytes. Written just before the wl_surface.attach request that
+ * uses the buffer, since shm buffer contents change without any request
+ * passing through the compositor.
+ */
+
+#define SESSION_RECORD_MAGIC "WSESSREC"
+#define SESSION_RECORD_VERSION 1
+
+enum session_record_type {
+	SESSION_RECORD_CLIENT_CREATED = 1,
+	SESSION_RECORD_CLIENT_DESTROYED,
+	SESSION_RECORD_REQUEST,
+	SESSION_RECORD_OBJECT_DESTROYED,
+	SESSION_RECORD_BUFFER_CONTENTS,
+};
+
+struct session_record_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct session_record_header {
+	uint32_t type;		/* enum session_record_type */
+	uint32_t client;	/* recorder-assigned client number */
+	uint64_t time_nsec;	/* CLOCK_MONOTONIC */
+	uint32_t size;		/* payload size in bytes */
+	uint32_t reserved;
+};
+
+#endif /* WESTON_SESSION_RECORD_H */
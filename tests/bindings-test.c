@@ -0,0 +1,355 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <linux/input.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "backend.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+#define MAX_CALLS 16
+
+struct call_log {
+	int ids[MAX_CALLS];
+	int count;
+};
+
+struct logged_binding {
+	struct call_log *log;
+	int id;
+	struct weston_binding *binding;
+	bool destroy_in_handler;
+};
+
+static void
+log_call(struct logged_binding *lb)
+{
+	assert(lb->log->count < MAX_CALLS);
+	lb->log->ids[lb->log->count++] = lb->id;
+
+	if (lb->destroy_in_handler) {
+		weston_binding_destroy(lb->binding);
+		lb->binding = NULL;
+	}
+}
+
+static void
+key_handler(struct weston_keyboard *keyboard, const struct timespec *time,
+	    uint32_t key, void *data)
+{
+	log_call(data);
+}
+
+static void
+modifier_handler(struct weston_keyboard *keyboard,
+		 enum weston_keyboard_modifier modifier, void *data)
+{
+	log_call(data);
+}
+
+static void
+button_handler(struct weston_pointer *pointer, const struct timespec *time,
+	       uint32_t button, void *data)
+{
+	log_call(data);
+}
+
+static void
+axis_handler(struct weston_pointer *pointer, const struct timespec *time,
+	     struct weston_pointer_axis_event *event, void *data)
+{
+	log_call(data);
+}
+
+static void
+destroy_bindings(struct logged_binding *lbs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (lbs[i].binding)
+			weston_binding_destroy(lbs[i].binding);
+		lbs[i].binding = NULL;
+	}
+}
+
+static struct weston_seat *
+get_test_seat(struct weston_compositor *compositor)
+{
+	struct weston_seat *seat;
+
+	wl_list_for_each(seat, &compositor->seat_list, link) {
+		if (strcmp(seat->seat_name, "test-seat") == 0)
+			return seat;
+	}
+
+	assert(!"test-seat not found");
+	return NULL;
+}
+
+static void
+send_key(struct weston_seat *seat, uint32_t key,
+	 enum wl_keyboard_key_state state)
+{
+	struct timespec time = { 0 };
+
+	notify_key(seat, &time, key, state, STATE_UPDATE_AUTOMATIC);
+}
+
+static void
+tap_key(struct weston_seat *seat, uint32_t key)
+{
+	send_key(seat, key, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(seat, key, WL_KEYBOARD_KEY_STATE_RELEASED);
+}
+
+static void
+tap_button(struct weston_seat *seat, uint32_t button)
+{
+	struct timespec time = { 0 };
+
+	notify_button(seat, &time, button, WL_POINTER_BUTTON_STATE_PRESSED);
+	notify_button(seat, &time, button, WL_POINTER_BUTTON_STATE_RELEASED);
+}
+
+static void
+send_axis(struct weston_seat *seat, uint32_t axis)
+{
+	struct timespec time = { 0 };
+	struct weston_pointer_axis_event event = {
+		.axis = axis,
+		.value = 10.0,
+	};
+
+	notify_axis(seat, &time, &event);
+}
+
+static void
+assert_calls(struct call_log *log, const int *ids, int count)
+{
+	int i;
+
+	assert(log->count == count);
+	for (i = 0; i < count; i++)
+		assert(log->ids[i] == ids[i]);
+
+	log->count = 0;
+}
+
+PLUGIN_TEST(bindings_run_in_registration_order)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_seat *seat = get_test_seat(compositor);
+	struct call_log log = { .count = 0 };
+	struct logged_binding lbs[] = {
+		{ &log, 1 }, { &log, 2 }, { &log, 3 }, { &log, 4 },
+		{ &log, 5 }, { &log, 6 }, { &log, 7 },
+	};
+	static const int key_order[] = { 1, 2, 3 };
+	static const int button_order[] = { 4, 5 };
+	static const int axis_order[] = { 6 };
+
+	lbs[0].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_CTRL, key_handler, &lbs[0]);
+	lbs[1].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_CTRL, key_handler, &lbs[1]);
+	lbs[2].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_CTRL, key_handler, &lbs[2]);
+	lbs[3].binding = weston_compositor_add_button_binding(compositor,
+		BTN_LEFT, MODIFIER_CTRL, button_handler, &lbs[3]);
+	lbs[4].binding = weston_compositor_add_button_binding(compositor,
+		BTN_LEFT, MODIFIER_CTRL, button_handler, &lbs[4]);
+	lbs[5].binding = weston_compositor_add_axis_binding(compositor,
+		WL_POINTER_AXIS_VERTICAL_SCROLL, MODIFIER_CTRL,
+		axis_handler, &lbs[5]);
+	lbs[6].binding = weston_compositor_add_axis_binding(compositor,
+		WL_POINTER_AXIS_VERTICAL_SCROLL, MODIFIER_CTRL,
+		axis_handler, &lbs[6]);
+
+	send_key(seat, KEY_LEFTCTRL, WL_KEYBOARD_KEY_STATE_PRESSED);
+
+	/* Key and button bindings sharing code and modifiers all run,
+	 * in the order they were added. */
+	tap_key(seat, KEY_A);
+	assert_calls(&log, key_order, ARRAY_LENGTH(key_order));
+
+	tap_button(seat, BTN_LEFT);
+	assert_calls(&log, button_order, ARRAY_LENGTH(button_order));
+
+	/* An axis event is consumed by the first matching binding. */
+	send_axis(seat, WL_POINTER_AXIS_VERTICAL_SCROLL);
+	assert_calls(&log, axis_order, ARRAY_LENGTH(axis_order));
+
+	send_key(seat, KEY_LEFTCTRL, WL_KEYBOARD_KEY_STATE_RELEASED);
+
+	destroy_bindings(lbs, ARRAY_LENGTH(lbs));
+}
+
+PLUGIN_TEST(bindings_miss_after_fast_reject)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_seat *seat = get_test_seat(compositor);
+	struct call_log log = { .count = 0 };
+	struct logged_binding lbs[] = {
+		{ &log, 1 }, { &log, 2 },
+	};
+	static const int ctrl_order[] = { 1 };
+
+	lbs[0].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_CTRL, key_handler, &lbs[0]);
+	lbs[1].binding = weston_compositor_add_button_binding(compositor,
+		BTN_LEFT, MODIFIER_CTRL, button_handler, &lbs[1]);
+
+	/* The codes are bound, so the per-code count lets these through,
+	 * but no bucket matches the current modifiers. */
+	tap_key(seat, KEY_A);
+	tap_button(seat, BTN_LEFT);
+	assert(log.count == 0);
+
+	send_key(seat, KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_PRESSED);
+	tap_key(seat, KEY_A);
+	tap_button(seat, BTN_LEFT);
+	send_key(seat, KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(log.count == 0);
+
+	/* Same modifiers, different code: rejected by the count. */
+	send_key(seat, KEY_LEFTCTRL, WL_KEYBOARD_KEY_STATE_PRESSED);
+	tap_key(seat, KEY_B);
+	tap_button(seat, BTN_RIGHT);
+	assert(log.count == 0);
+
+	tap_key(seat, KEY_A);
+	assert_calls(&log, ctrl_order, ARRAY_LENGTH(ctrl_order));
+
+	/* Once the only binding for a code is gone, it is rejected again. */
+	destroy_bindings(lbs, ARRAY_LENGTH(lbs));
+	tap_key(seat, KEY_A);
+	tap_button(seat, BTN_LEFT);
+	send_key(seat, KEY_LEFTCTRL, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(log.count == 0);
+}
+
+PLUGIN_TEST(bindings_destroy_from_handler)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_seat *seat = get_test_seat(compositor);
+	struct call_log log = { .count = 0 };
+	struct logged_binding lbs[] = {
+		{ &log, 1, NULL, true }, { &log, 2 },
+		{ &log, 3, NULL, true }, { &log, 4 },
+	};
+	static const int first_keys[] = { 1, 2 };
+	static const int later_keys[] = { 2 };
+	static const int first_buttons[] = { 3, 4 };
+	static const int later_buttons[] = { 4 };
+
+	lbs[0].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_SUPER, key_handler, &lbs[0]);
+	lbs[1].binding = weston_compositor_add_key_binding(compositor,
+		KEY_A, MODIFIER_SUPER, key_handler, &lbs[1]);
+	lbs[2].binding = weston_compositor_add_button_binding(compositor,
+		BTN_LEFT, MODIFIER_SUPER, button_handler, &lbs[2]);
+	lbs[3].binding = weston_compositor_add_button_binding(compositor,
+		BTN_LEFT, MODIFIER_SUPER, button_handler, &lbs[3]);
+
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+
+	/* A binding that destroys itself does not stop the rest of its
+	 * bucket from running, and is gone for the next event. */
+	tap_key(seat, KEY_A);
+	assert_calls(&log, first_keys, ARRAY_LENGTH(first_keys));
+	assert(lbs[0].binding == NULL);
+
+	tap_key(seat, KEY_A);
+	assert_calls(&log, later_keys, ARRAY_LENGTH(later_keys));
+
+	tap_button(seat, BTN_LEFT);
+	assert_calls(&log, first_buttons, ARRAY_LENGTH(first_buttons));
+	assert(lbs[2].binding == NULL);
+
+	tap_button(seat, BTN_LEFT);
+	assert_calls(&log, later_buttons, ARRAY_LENGTH(later_buttons));
+
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+
+	destroy_bindings(lbs, ARRAY_LENGTH(lbs));
+}
+
+PLUGIN_TEST(bindings_modifier_cancelled_by_other_input)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_seat *seat = get_test_seat(compositor);
+	struct call_log log = { .count = 0 };
+	struct logged_binding lbs[] = {
+		{ &log, 1 },
+	};
+	static const int fired[] = { 1 };
+
+	lbs[0].binding = weston_compositor_add_modifier_binding(compositor,
+		MODIFIER_SUPER, modifier_handler, &lbs[0]);
+
+	/* Pressing and releasing the modifier alone fires on release. */
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	assert(log.count == 0);
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert_calls(&log, fired, ARRAY_LENGTH(fired));
+
+	/* Another key in between cancels it, bound or not. */
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	tap_key(seat, KEY_B);
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(log.count == 0);
+
+	/* So does a button. */
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	tap_button(seat, BTN_LEFT);
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert(log.count == 0);
+
+	/* The next clean press primes it again. */
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(seat, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+	assert_calls(&log, fired, ARRAY_LENGTH(fired));
+
+	destroy_bindings(lbs, ARRAY_LENGTH(lbs));
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <linux/input.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include <libweston/libweston.h>
+#include "backend.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct keysym_case {
+	uint32_t keysym;
+	uint32_t key;
+	uint32_t mods;
+};
+
+#define SHIFT WESTON_KEYSYM_INDEX_MOD_SHIFT
+#define LEVEL3 WESTON_KEYSYM_INDEX_MOD_LEVEL3
+
+static const struct keysym_case us_cases[] = {
+	{ XKB_KEY_a,		KEY_A,		0 },
+	{ XKB_KEY_A,		KEY_A,		SHIFT },
+	{ XKB_KEY_z,		KEY_Z,		0 },
+	{ XKB_KEY_at,		KEY_2,		SHIFT },
+	{ XKB_KEY_Return,	KEY_ENTER,	0 },
+	{ XKB_KEY_KP_Enter,	KEY_KPENTER,	0 },
+	{ XKB_KEY_Control_L,	KEY_LEFTCTRL,	0 },
+};
+
+static const struct keysym_case de_cases[] = {
+	{ XKB_KEY_z,		KEY_Y,		0 },
+	{ XKB_KEY_y,		KEY_Z,		0 },
+	{ XKB_KEY_ssharp,	KEY_MINUS,	0 },
+	{ XKB_KEY_quotedbl,	KEY_2,		SHIFT },
+	{ XKB_KEY_at,		KEY_Q,		LEVEL3 },
+	{ XKB_KEY_EuroSign,	KEY_E,		LEVEL3 },
+};
+
+static const struct keysym_case fr_cases[] = {
+	{ XKB_KEY_a,		KEY_Q,		0 },
+	{ XKB_KEY_q,		KEY_A,		0 },
+	{ XKB_KEY_1,		KEY_1,		SHIFT },
+	{ XKB_KEY_eacute,	KEY_2,		0 },
+	{ XKB_KEY_at,		KEY_0,		LEVEL3 },
+};
+
+/* de with AltGr turned into a plain Alt and level 3 moved to Caps Lock */
+static const struct keysym_case de_caps_cases[] = {
+	{ XKB_KEY_at,		KEY_Q,		LEVEL3 },
+	{ XKB_KEY_EuroSign,	KEY_E,		LEVEL3 },
+	{ XKB_KEY_Alt_R,	KEY_RIGHTALT,	0 },
+};
+
+static struct xkb_keymap *
+keymap_for_options(struct xkb_context *ctx, const char *layout,
+		   const char *options)
+{
+	const struct xkb_rule_names names = {
+		.rules = "evdev",
+		.model = "pc105",
+		.layout = layout,
+		.options = options,
+	};
+	struct xkb_keymap *keymap;
+
+	keymap = xkb_keymap_new_from_names(ctx, &names, 0);
+	assert(keymap);
+
+	return keymap;
+}
+
+static struct xkb_keymap *
+keymap_for_layout(struct xkb_context *ctx, const char *layout)
+{
+	return keymap_for_options(ctx, layout, NULL);
+}
+
+static void
+check_keymap(struct xkb_keymap *keymap, const char *layout,
+	     const struct keysym_case *cases, unsigned int n_cases)
+{
+	struct weston_keysym_index *index;
+	uint32_t key, mods;
+	unsigned int i;
+
+	index = weston_keysym_index_create(keymap);
+	assert(index);
+	assert(weston_keysym_index_get_keymap(index) == keymap);
+
+	for (i = 0; i < n_cases; i++) {
+		testlog("%s: keysym 0x%x\n", layout, cases[i].keysym);
+		assert(weston_keysym_index_lookup(index, cases[i].keysym,
+						  &key, &mods));
+		assert(key == cases[i].key);
+		assert(mods == cases[i].mods);
+	}
+
+	/* Not on any of these layouts */
+	assert(!weston_keysym_index_lookup(index, XKB_KEY_Thai_kokai,
+					   &key, &mods));
+	assert(!weston_keysym_index_lookup(index, XKB_KEY_NoSymbol,
+					   &key, &mods));
+
+	weston_keysym_index_destroy(index);
+}
+
+static void
+check_layout(struct xkb_context *ctx, const char *layout,
+	     const struct keysym_case *cases, unsigned int n_cases)
+{
+	struct xkb_keymap *keymap = keymap_for_layout(ctx, layout);
+
+	check_keymap(keymap, layout, cases, n_cases);
+	xkb_keymap_unref(keymap);
+}
+
+PLUGIN_TEST(keysym_index_layouts)
+{
+	/* struct weston_compositor *compositor; */
+	struct xkb_context *ctx = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
+	assert(ctx);
+
+	check_layout(ctx, "us", us_cases, ARRAY_LENGTH(us_cases));
+	check_layout(ctx, "de", de_cases, ARRAY_LENGTH(de_cases));
+	check_layout(ctx, "fr", fr_cases, ARRAY_LENGTH(fr_cases));
+
+	xkb_context_unref(ctx);
+}
+
+PLUGIN_TEST(keysym_index_keeps_keymap)
+{
+	/* struct weston_compositor *compositor; */
+	struct xkb_context *ctx = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	struct xkb_keymap *keymap;
+	struct weston_keysym_index *index;
+	uint32_t key, mods;
+
+	assert(ctx);
+
+	/* The index outlives the caller's reference to the keymap, which is
+	 * what lets a backend compare keymaps to decide on a rebuild. */
+	keymap = keymap_for_layout(ctx, "de");
+	index = weston_keysym_index_create(keymap);
+	xkb_keymap_unref(keymap);
+
+	assert(weston_keysym_index_lookup(index, XKB_KEY_z, &key, &mods));
+	assert(key == KEY_Y && mods == 0);
+
+	weston_keysym_index_destroy(index);
+	xkb_context_unref(ctx);
+}
+
+PLUGIN_TEST(keysym_index_modifier_keys)
+{
+	/* struct weston_compositor *compositor; */
+	struct xkb_context *ctx = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	struct xkb_keymap *keymap;
+	struct weston_keysym_index *index;
+
+	assert(ctx);
+
+	keymap = keymap_for_layout(ctx, "de");
+	index = weston_keysym_index_create(keymap);
+	assert(weston_keysym_index_get_modifier_key(index, SHIFT) ==
+	       KEY_LEFTSHIFT);
+	assert(weston_keysym_index_get_modifier_key(index, LEVEL3) ==
+	       KEY_RIGHTALT);
+	weston_keysym_index_destroy(index);
+	xkb_keymap_unref(keymap);
+
+	/* Level 3 must be typed with the key that produces it in the
+	 * keymap, not with whatever usually does. */
+	keymap = keymap_for_options(ctx, "de", "lv3:ralt_alt,lv3:caps_switch");
+	index = weston_keysym_index_create(keymap);
+	assert(weston_keysym_index_get_modifier_key(index, LEVEL3) ==
+	       KEY_CAPSLOCK);
+	weston_keysym_index_destroy(index);
+
+	check_keymap(keymap, "de lv3:caps_switch", de_caps_cases,
+		     ARRAY_LENGTH(de_caps_cases));
+	xkb_keymap_unref(keymap);
+
+	xkb_context_unref(ctx);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#include "xdg-shell-client-protocol.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_KIOSK;
+	setup.output_count = 3;
+
+	weston_ini_setup(&setup,
+			 cfgln("[output]"),
+			 cfgln("name=headless-1"),
+			 cfgln("app-ids=org.example.one,org.example.shared"),
+			 cfgln("[output]"),
+			 cfgln("name=headless-2"),
+			 cfgln("app-ids=org.example.two,org.example.shared,"
+			       "org.example.three"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct xdg_wm_base *
+get_xdg_wm_base(struct client *client)
+{
+	struct global *g;
+	struct global *global = NULL;
+	struct xdg_wm_base *xdg_wm_base;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, "xdg_wm_base"))
+			continue;
+
+		if (global)
+			assert(0 && "multiple xdg_wm_base objects");
+
+		global = g;
+	}
+
+	assert(global && "no xdg_wm_base found");
+
+	xdg_wm_base = wl_registry_bind(client->wl_registry, global->name,
+				       &xdg_wm_base_interface, 1);
+	assert(xdg_wm_base);
+
+	return xdg_wm_base;
+}
+
+static void
+xdg_surface_handle_configure(void *data, struct xdg_surface *xdg_surface,
+			     uint32_t serial)
+{
+	uint32_t *configure_serial = data;
+
+	*configure_serial = serial;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	xdg_surface_handle_configure,
+};
+
+/* Map a toplevel with the given app-id, return the output it lands on */
+static char *
+map_app_id(const char *app_id)
+{
+	struct client *client;
+	struct xdg_wm_base *xdg_wm_base;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct surface *surface;
+	uint32_t serial = 0;
+	int done;
+	char *name;
+
+	client = create_client();
+	xdg_wm_base = get_xdg_wm_base(client);
+	surface = create_test_surface(client);
+
+	xdg_surface = xdg_wm_base_get_xdg_surface(xdg_wm_base,
+						  surface->wl_surface);
+	xdg_surface_add_listener(xdg_surface, &xdg_surface_listener, &serial);
+	xdg_toplevel = xdg_surface_get_toplevel(xdg_surface);
+	xdg_toplevel_set_app_id(xdg_toplevel, app_id);
+	wl_surface_commit(surface->wl_surface);
+
+	while (serial == 0)
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+	xdg_surface_ack_configure(xdg_surface, serial);
+
+	surface->width = 64;
+	surface->height = 64;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, 64, 64);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0, 64, 64);
+	frame_callback_set(surface->wl_surface, &done);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &done);
+
+	assert(surface->output);
+	assert(surface->output->name);
+	name = strdup(surface->output->name);
+	assert(name);
+
+	xdg_toplevel_destroy(xdg_toplevel);
+	xdg_surface_destroy(xdg_surface);
+	surface_destroy(surface);
+	xdg_wm_base_destroy(xdg_wm_base);
+	client_destroy(client);
+
+	return name;
+}
+
+struct app_id_route {
+	const char *app_id;
+	const char *output;
+};
+
+static const struct app_id_route app_id_routes[] = {
+	{ "org.example.one", "headless-1" },
+	{ "org.example.two", "headless-2" },
+	/* Listed for both, the first configured output wins */
+	{ "org.example.shared", "headless-1" },
+	/* Last entry of a list */
+	{ "org.example.three", "headless-2" },
+};
+
+TEST_P(app_id_routes_to_configured_output, app_id_routes)
+{
+	const struct app_id_route *route = data;
+	char *name;
+
+	name = map_app_id(route->app_id);
+	testlog("%s mapped on %s\n", route->app_id, name);
+	assert(strcmp(name, route->output) == 0);
+	free(name);
+}
+
+/* Only whole entries of app-ids match, not substrings of them */
+TEST(partial_app_id_is_not_routed)
+{
+	char *name;
+
+	name = map_app_id("example.two");
+	testlog("example.two mapped on %s\n", name);
+	assert(strcmp(name, "headless-2") != 0);
+	free(name);
+}
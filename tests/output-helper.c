@@ -0,0 +1,79 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "output-helper.h"
+
+static struct weston_head *
+find_head(struct weston_compositor *compositor, const char *name)
+{
+	struct weston_head *head = NULL;
+
+	while ((head = weston_compositor_iterate_heads(compositor, head)))
+		if (strcmp(weston_head_get_name(head), name) == 0)
+			return head;
+
+	return NULL;
+}
+
+/** Create and enable a 64x64 output on a windowed backend
+ *
+ * \param compositor The compositor.
+ * \param api The windowed output API of the backend.
+ * \param name The name of the head and the output. The head is created
+ * unless a previous call already did.
+ * \param pos Where to place the output, or NULL for the default.
+ * \return The enabled output.
+ */
+struct weston_output *
+create_test_output(struct weston_compositor *compositor,
+		   const struct weston_windowed_output_api *api,
+		   const char *name, const struct weston_coord_global *pos)
+{
+	struct weston_output *output;
+	struct weston_head *head;
+
+	head = find_head(compositor, name);
+	if (!head) {
+		assert(api->create_head(compositor->backend, name) == 0);
+		head = find_head(compositor, name);
+		assert(head);
+	}
+
+	output = weston_compositor_create_output(compositor, head, name);
+	assert(output);
+	weston_output_set_scale(output, 1);
+	weston_output_set_transform(output, WL_OUTPUT_TRANSFORM_NORMAL);
+	if (pos)
+		weston_output_move(output, *pos);
+	assert(api->output_set_size(output, 64, 64) == 0);
+	assert(weston_output_enable(output) == 0);
+
+	return output;
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/windowed-output-api.h>
+#include "shared/helpers.h"
+#include "output-helper.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Counts the compositor signals a layout change fans out to. */
+struct signal_counter {
+	struct wl_listener moved_listener;
+	struct wl_listener resized_listener;
+	int moved;
+	int resized;
+};
+
+static void
+output_moved(struct wl_listener *listener, void *data)
+{
+	struct signal_counter *counter =
+		container_of(listener, struct signal_counter, moved_listener);
+
+	counter->moved++;
+}
+
+static void
+output_resized(struct wl_listener *listener, void *data)
+{
+	struct signal_counter *counter =
+		container_of(listener, struct signal_counter, resized_listener);
+
+	counter->resized++;
+}
+
+static void
+signal_counter_init(struct signal_counter *counter,
+		    struct weston_compositor *compositor)
+{
+	*counter = (struct signal_counter) { 0 };
+	counter->moved_listener.notify = output_moved;
+	wl_signal_add(&compositor->output_moved_signal,
+		      &counter->moved_listener);
+	counter->resized_listener.notify = output_resized;
+	wl_signal_add(&compositor->output_resized_signal,
+		      &counter->resized_listener);
+}
+
+static void
+signal_counter_fini(struct signal_counter *counter)
+{
+	wl_list_remove(&counter->moved_listener.link);
+	wl_list_remove(&counter->resized_listener.link);
+}
+
+/* An in-process client with a wl_output bound to each head. What the
+ * compositor sends is read back off the socket and counted per head. */
+struct event_recorder {
+	int fds[2];
+	struct wl_client *client;
+};
+
+struct output_events {
+	struct wl_resource *resource;
+	int geometry;
+	int mode;
+	int done;
+	int total;
+};
+
+static void
+event_recorder_init(struct event_recorder *recorder,
+		    struct weston_compositor *compositor)
+{
+	assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0,
+			  recorder->fds) == 0);
+	recorder->client = wl_client_create(compositor->wl_display,
+					    recorder->fds[0]);
+	assert(recorder->client);
+}
+
+static void
+event_recorder_fini(struct event_recorder *recorder)
+{
+	/* closes fds[0] */
+	wl_client_destroy(recorder->client);
+	close(recorder->fds[1]);
+}
+
+static void
+unlink_resource(struct wl_resource *resource)
+{
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
+static void
+event_recorder_bind(struct event_recorder *recorder,
+		    struct weston_head *head, struct output_events *events)
+{
+	*events = (struct output_events) { 0 };
+	events->resource = wl_resource_create(recorder->client,
+					      &wl_output_interface, 4, 0);
+	assert(events->resource);
+	wl_resource_set_implementation(events->resource, NULL, head,
+				       unlink_resource);
+	wl_list_insert(&head->resource_list,
+		       wl_resource_get_link(events->resource));
+}
+
+static void
+event_recorder_collect(struct event_recorder *recorder,
+		       struct output_events *events, unsigned int count)
+{
+	static uint32_t buf[16384];
+	size_t len = 0;
+	ssize_t ret;
+	size_t pos;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		events[i].geometry = 0;
+		events[i].mode = 0;
+		events[i].done = 0;
+		events[i].total = 0;
+	}
+
+	wl_client_flush(recorder->client);
+	do {
+		ret = recv(recorder->fds[1], (char *)buf + len,
+			   sizeof buf - len, MSG_DONTWAIT);
+		if (ret > 0)
+			len += ret;
+	} while (ret > 0 && len < sizeof buf);
+	assert(len < sizeof buf);
+
+	/* wire format: object id, then message size << 16 | opcode */
+	for (pos = 0; pos < len / 4; pos += buf[pos + 1] >> 18) {
+		uint32_t id = buf[pos];
+		uint32_t opcode = buf[pos + 1] & 0xffff;
+
+		assert(buf[pos + 1] >> 16 >= 8);
+		for (i = 0; i < count; i++) {
+			if (!events[i].resource ||
+			    wl_resource_get_id(events[i].resource) != id)
+				continue;
+
+			events[i].total++;
+			if (opcode == WL_OUTPUT_GEOMETRY)
+				events[i].geometry++;
+			else if (opcode == WL_OUTPUT_MODE)
+				events[i].mode++;
+			else if (opcode == WL_OUTPUT_DONE)
+				events[i].done++;
+		}
+	}
+}
+
+static struct weston_coord_global
+layout_pos(int x)
+{
+	struct weston_coord_global pos;
+
+	/* below the fixture's own output */
+	pos.c = weston_coord(x, 1000);
+	return pos;
+}
+
+static struct weston_output *
+create_output(struct weston_compositor *compositor,
+	      const struct weston_windowed_output_api *api,
+	      const char *name, int x)
+{
+	struct weston_coord_global pos = layout_pos(x);
+
+	return create_test_output(compositor, api, name, &pos);
+}
+
+static struct weston_head *
+output_head(struct weston_output *output)
+{
+	return weston_output_get_first_head(output);
+}
+
+/* A dock-like reconfiguration: one output goes away, one is added and the
+ * rest are rearranged, some of them more than once. */
+PLUGIN_TEST(output_layout_batches_changes)
+{
+	const struct weston_windowed_output_api *api;
+	struct weston_output *a, *b, *c, *d;
+	struct event_recorder recorder;
+	struct signal_counter counter;
+	struct output_events events[3];
+
+	api = weston_windowed_output_get_api(compositor);
+	assert(api);
+
+	a = create_output(compositor, api, "layout-a", 0);
+	b = create_output(compositor, api, "layout-b", 64);
+	c = create_output(compositor, api, "layout-c", 128);
+
+	event_recorder_init(&recorder, compositor);
+	event_recorder_bind(&recorder, output_head(a), &events[0]);
+	event_recorder_bind(&recorder, output_head(b), &events[1]);
+	event_recorder_bind(&recorder, output_head(c), &events[2]);
+	signal_counter_init(&counter, compositor);
+
+	weston_compositor_begin_output_layout(compositor);
+
+	weston_output_destroy(a);
+	events[0].resource = NULL;
+	weston_output_move(b, layout_pos(0));
+	weston_output_move(c, layout_pos(64));
+	d = create_output(compositor, api, "layout-d", 128);
+	weston_output_move(b, layout_pos(192));
+
+	/* geometry is current, everything else waits for the commit */
+	assert(b->x == 192);
+	assert(c->x == 64);
+	assert(compositor->output_layout_views_dirty);
+	assert(d->layout_pending != 0);
+	event_recorder_collect(&recorder, events, ARRAY_LENGTH(events));
+	assert(events[1].total == 0);
+	assert(events[2].total == 0);
+	assert(counter.moved == 0);
+
+	weston_compositor_commit_output_layout(compositor);
+
+	assert(!compositor->output_layout_views_dirty);
+	assert(b->layout_pending == 0);
+	assert(d->layout_pending == 0);
+
+	/* one moved signal per output that ended up elsewhere, with the
+	 * whole distance */
+	assert(counter.moved == 2);
+	assert(counter.resized == 0);
+	assert(b->move_x == 192 - 64);
+	assert(c->move_x == 64 - 128);
+
+	/* and a single round of events for each */
+	event_recorder_collect(&recorder, events, ARRAY_LENGTH(events));
+	assert(events[1].geometry == 1);
+	assert(events[1].done == 1);
+	assert(events[1].total == 2);
+	assert(events[2].geometry == 1);
+	assert(events[2].done == 1);
+	assert(events[2].total == 2);
+
+	/* Without a transaction, every step goes out on its own. */
+	counter.moved = 0;
+	weston_output_move(b, layout_pos(0));
+	weston_output_move(b, layout_pos(192));
+	assert(counter.moved == 2);
+	event_recorder_collect(&recorder, events, ARRAY_LENGTH(events));
+	assert(events[1].geometry == 2);
+	assert(events[1].done == 2);
+
+	signal_counter_fini(&counter);
+	event_recorder_fini(&recorder);
+
+	weston_output_destroy(b);
+	weston_output_destroy(c);
+	weston_output_destroy(d);
+}
+
+PLUGIN_TEST(output_layout_nested_and_no_op)
+{
+	const struct weston_windowed_output_api *api;
+	struct weston_output *output;
+	struct event_recorder recorder;
+	struct signal_counter counter;
+	struct output_events events;
+
+	api = weston_windowed_output_get_api(compositor);
+	assert(api);
+
+	output = create_output(compositor, api, "layout-nested", 0);
+	event_recorder_init(&recorder, compositor);
+	event_recorder_bind(&recorder, output_head(output), &events);
+	signal_counter_init(&counter, compositor);
+
+	/* Moving away and back again is nothing to tell about. */
+	weston_compositor_begin_output_layout(compositor);
+	weston_output_move(output, layout_pos(500));
+	weston_output_move(output, layout_pos(0));
+	weston_compositor_commit_output_layout(compositor);
+
+	assert(counter.moved == 0);
+	event_recorder_collect(&recorder, &events, 1);
+	assert(events.total == 0);
+
+	/* Only the outermost commit applies the changes. */
+	weston_compositor_begin_output_layout(compositor);
+	weston_compositor_begin_output_layout(compositor);
+	weston_output_move(output, layout_pos(500));
+	weston_compositor_commit_output_layout(compositor);
+
+	assert(counter.moved == 0);
+	event_recorder_collect(&recorder, &events, 1);
+	assert(events.total == 0);
+
+	weston_compositor_commit_output_layout(compositor);
+
+	assert(counter.moved == 1);
+	assert(output->move_x == 500);
+	event_recorder_collect(&recorder, &events, 1);
+	assert(events.geometry == 1);
+	assert(events.done == 1);
+
+	signal_counter_fini(&counter);
+	event_recorder_fini(&recorder);
+
+	weston_output_destroy(output);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "backend.h"
+#include "shared/helpers.h"
+#include "compositor/weston.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct output_config {
+	uint32_t transform;
+	int32_t scale;
+};
+
+static const struct output_config output_configs[] = {
+	{ WL_OUTPUT_TRANSFORM_NORMAL, 1 },
+	{ WL_OUTPUT_TRANSFORM_NORMAL, 2 },
+	{ WL_OUTPUT_TRANSFORM_NORMAL, 3 },
+	{ WL_OUTPUT_TRANSFORM_90, 1 },
+	{ WL_OUTPUT_TRANSFORM_FLIPPED_180, 2 },
+};
+
+/* The integer fast path must give exactly what the matrix gives */
+PLUGIN_TEST(global_to_output_matches_matrix)
+{
+	struct weston_output output = { 0 };
+	pixman_region32_t global, expected, result;
+	unsigned int i;
+
+	wl_list_init(&output.paint_node_list);
+	output.x = -300;
+	output.y = 120;
+	output.width = 640;
+	output.height = 480;
+
+	pixman_region32_init_rect(&global, -290, 130, 50, 40);
+	pixman_region32_union_rect(&global, &global, 0, 200, 300, 10);
+	pixman_region32_union_rect(&global, &global, 100, 590, 7, 9);
+	pixman_region32_init(&expected);
+	pixman_region32_init(&result);
+
+	for (i = 0; i < ARRAY_LENGTH(output_configs); i++) {
+		output.transform = output_configs[i].transform;
+		output.current_scale = output_configs[i].scale;
+		weston_output_update_matrix(&output);
+
+		weston_matrix_transform_region(&expected, &output.matrix,
+					       &global);
+		weston_region_global_to_output(&result, &output, &global);
+		assert(pixman_region32_equal(&result, &expected));
+
+		/* in place, like most callers */
+		pixman_region32_copy(&result, &global);
+		weston_region_global_to_output(&result, &output, &result);
+		assert(pixman_region32_equal(&result, &expected));
+	}
+
+	pixman_region32_fini(&global);
+	pixman_region32_fini(&expected);
+	pixman_region32_fini(&result);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libweston/libweston.h>
+#include <libweston/windowed-output-api.h>
+#include "shared/helpers.h"
+#include "output-helper.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+#define MANY_OUTPUTS 128
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+PLUGIN_TEST(output_set_operations)
+{
+	struct weston_output_set a = { 0 };
+	struct weston_output_set b = { 0 };
+	uint32_t id;
+
+	assert(weston_output_set_is_empty(&a));
+	assert(weston_output_set_first_free(&a) == 0);
+
+	weston_output_set_add(&a, 3);
+	assert(weston_output_set_has(&a, 3));
+	assert(weston_output_set_is_single(&a, 3));
+	assert(!weston_output_set_is_single(&a, 4));
+	assert(a.extra == NULL);
+
+	weston_output_set_add(&a, 100);
+	assert(weston_output_set_has(&a, 100));
+	assert(!weston_output_set_has(&a, 99));
+	assert(!weston_output_set_has(&a, 1000));
+	assert(!weston_output_set_is_single(&a, 3));
+
+	weston_output_set_remove(&a, 3);
+	assert(weston_output_set_is_single(&a, 100));
+	assert(!weston_output_set_is_empty(&a));
+
+	/* A set with unused storage equals one without */
+	weston_output_set_remove(&a, 100);
+	assert(weston_output_set_is_empty(&a));
+	assert(weston_output_set_equal(&a, &b));
+	assert(weston_output_set_equal(&b, &a));
+
+	for (id = 0; id < MANY_OUTPUTS; id++) {
+		assert(weston_output_set_first_free(&a) == id);
+		weston_output_set_add(&a, id);
+	}
+	weston_output_set_remove(&a, 70);
+	assert(weston_output_set_first_free(&a) == 70);
+
+	weston_output_set_add(&b, 5);
+	weston_output_set_union(&b, &a);
+	assert(weston_output_set_has(&b, 5));
+	assert(weston_output_set_has(&b, 127));
+	assert(!weston_output_set_has(&b, 70));
+	assert(weston_output_set_equal(&a, &b));
+
+	weston_output_set_copy(&b, &a);
+	assert(weston_output_set_equal(&a, &b));
+
+	weston_output_set_clear(&a);
+	assert(weston_output_set_is_empty(&a));
+	assert(!weston_output_set_equal(&a, &b));
+
+	weston_output_set_fini(&a);
+	weston_output_set_fini(&b);
+}
+
+static struct weston_output *
+create_output(struct weston_compositor *compositor,
+	      const struct weston_windowed_output_api *api, unsigned int i)
+{
+	char name[32];
+
+	snprintf(name, sizeof name, "many-%u", i);
+
+	return create_test_output(compositor, api, name, NULL);
+}
+
+/* Outputs past the 32nd get unique IDs, and freed IDs get reused */
+PLUGIN_TEST(hotplug_many_outputs)
+{
+	const struct weston_windowed_output_api *api;
+	struct weston_output *outputs[MANY_OUTPUTS];
+	struct weston_output_set seen = { 0 };
+	unsigned int i;
+	uint32_t id;
+
+	api = weston_windowed_output_get_api(compositor);
+	assert(api);
+
+	for (i = 0; i < MANY_OUTPUTS; i++) {
+		outputs[i] = create_output(compositor, api, i);
+		assert(!weston_output_set_has(&seen, outputs[i]->id));
+		weston_output_set_add(&seen, outputs[i]->id);
+	}
+
+	/* Unplug every other output, lowest ID first gets reused */
+	for (i = 0; i < MANY_OUTPUTS; i += 2) {
+		id = outputs[i]->id;
+		weston_output_destroy(outputs[i]);
+		assert(!weston_output_set_has(&compositor->output_id_pool, id));
+	}
+
+	for (i = 0; i < MANY_OUTPUTS; i += 2) {
+		id = weston_output_set_first_free(&compositor->output_id_pool);
+		outputs[i] = create_output(compositor, api, i);
+		assert(outputs[i]->id == id);
+	}
+
+	for (i = 0; i < MANY_OUTPUTS; i++)
+		weston_output_destroy(outputs[i]);
+
+	weston_output_set_fini(&seen);
+}
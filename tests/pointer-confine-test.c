@@ -0,0 +1,256 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* The smallest step a confined motion stops short of a right or bottom
+ * border, see clamp_to_border() */
+#define EPSILON (1.0 / 256.0)
+
+static const pixman_box32_t constraint_rects[] = {
+	/* full-width top band */
+	{ 0, 0, 100, 20 },
+	/* two columns around a hole at 40,20 - 60,60 */
+	{ 0, 20, 40, 60 },
+	{ 60, 20, 100, 60 },
+	/* full-width band below the hole */
+	{ 0, 60, 100, 80 },
+	/* narrower step */
+	{ 20, 80, 80, 100 },
+	/* comb of teeth hanging off the step */
+	{ 20, 100, 25, 120 },
+	{ 30, 100, 35, 120 },
+	{ 40, 100, 45, 120 },
+	{ 50, 100, 55, 120 },
+	{ 60, 100, 65, 120 },
+	{ 70, 100, 75, 120 },
+	/* detached island */
+	{ 110, 0, 130, 40 },
+};
+
+static void
+build_regions(pixman_region32_t *input, pixman_region32_t *constraint,
+	      pixman_region32_t *effective)
+{
+	unsigned int i;
+
+	/* the input region cuts off the right edge of everything */
+	pixman_region32_init_rect(input, 0, 0, 120, 130);
+
+	pixman_region32_init(constraint);
+	for (i = 0; i < ARRAY_LENGTH(constraint_rects); i++) {
+		const pixman_box32_t *r = &constraint_rects[i];
+
+		pixman_region32_union_rect(constraint, constraint,
+					   r->x1, r->y1,
+					   r->x2 - r->x1, r->y2 - r->y1);
+	}
+
+	pixman_region32_init(effective);
+	pixman_region32_intersect(effective, input, constraint);
+}
+
+static bool
+inside(pixman_region32_t *region, int x, int y)
+{
+	return pixman_region32_contains_point(region, x, y, NULL);
+}
+
+/* Walk the pixels from the start towards the target and stop at the
+ * first one outside the region. */
+static double
+expected_clamp(pixman_region32_t *region, int start, double target,
+	       int other, bool horizontal)
+{
+	int p;
+
+	if (target > start + 0.5) {
+		for (p = start + 1; p <= floor(target); p++) {
+			if (horizontal ? !inside(region, p, other) :
+					 !inside(region, other, p))
+				return p - EPSILON;
+		}
+	} else {
+		for (p = start - 1; p >= ceil(target - 1.0); p--) {
+			if (horizontal ? !inside(region, p, other) :
+					 !inside(region, other, p))
+				return p + 1;
+		}
+	}
+
+	return target;
+}
+
+static const double targets[] = {
+	-10.0, 0.0, 7.0, 19.5, 20.0, 39.0, 40.0, 41.5, 60.0, 77.0,
+	99.5, 100.0, 115.0, 120.0, 150.0,
+};
+
+PLUGIN_TEST(confine_axis_aligned_motion)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_confine_region confine;
+	pixman_region32_t input, constraint, effective;
+	struct weston_coord from, to, got;
+	double expected;
+	unsigned int i;
+	int a, b;
+
+	build_regions(&input, &constraint, &effective);
+
+	weston_confine_region_init(&confine);
+	weston_confine_region_update(&confine, &input, &constraint);
+	assert(pixman_region32_equal(&confine.region, &effective));
+
+	/* every start pixel inside the region, every target, both axes */
+	for (b = 0; b < 130; b++) {
+		for (a = 0; a < 130; a++) {
+			if (!inside(&effective, a, b))
+				continue;
+
+			for (i = 0; i < ARRAY_LENGTH(targets); i++) {
+				from = weston_coord(a + 0.5, b + 0.5);
+
+				to = weston_coord(targets[i], b + 0.5);
+				got = weston_confine_region_clamp_motion(&confine,
+									 from, to);
+				expected = expected_clamp(&effective, a,
+							  targets[i], b, true);
+				assert(fabs(got.x - expected) < 1e-9);
+				assert(got.y == to.y);
+
+				to = weston_coord(a + 0.5, targets[i]);
+				got = weston_confine_region_clamp_motion(&confine,
+									 from, to);
+				expected = expected_clamp(&effective, b,
+							  targets[i], a, false);
+				assert(got.x == to.x);
+				assert(fabs(got.y - expected) < 1e-9);
+			}
+		}
+	}
+
+	weston_confine_region_fini(&confine);
+	pixman_region32_fini(&effective);
+	pixman_region32_fini(&constraint);
+	pixman_region32_fini(&input);
+}
+
+PLUGIN_TEST(confine_diagonal_motion)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_confine_region confine;
+	pixman_region32_t input, constraint, effective;
+	struct weston_coord got;
+
+	build_regions(&input, &constraint, &effective);
+
+	weston_confine_region_init(&confine);
+	weston_confine_region_update(&confine, &input, &constraint);
+
+	/* into the left edge of the hole, then slide down along it */
+	got = weston_confine_region_clamp_motion(&confine,
+						 weston_coord(30.5, 12.5),
+						 weston_coord(50.5, 32.5));
+	assert(fabs(got.x - (40.0 - EPSILON)) < 1e-9);
+	assert(got.y == 32.5);
+
+	/* out of the bottom of a tooth, stopped by its bottom edge */
+	got = weston_confine_region_clamp_motion(&confine,
+						 weston_coord(21.5, 110.5),
+						 weston_coord(23.5, 140.5));
+	assert(fabs(got.y - (120.0 - EPSILON)) < 1e-9);
+	assert(inside(&effective, floor(got.x), floor(got.y)));
+
+	/* motion staying inside is untouched */
+	got = weston_confine_region_clamp_motion(&confine,
+						 weston_coord(5.5, 5.5),
+						 weston_coord(35.5, 75.5));
+	assert(got.x == 35.5 && got.y == 75.5);
+
+	weston_confine_region_fini(&confine);
+	pixman_region32_fini(&effective);
+	pixman_region32_fini(&constraint);
+	pixman_region32_fini(&input);
+}
+
+PLUGIN_TEST(confine_region_rebuild)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_confine_region confine;
+	pixman_region32_t input, constraint, effective;
+	struct weston_coord got;
+
+	build_regions(&input, &constraint, &effective);
+
+	weston_confine_region_init(&confine);
+	weston_confine_region_update(&confine, &input, &constraint);
+
+	/* the island is cut at the input region's right edge */
+	got = weston_confine_region_clamp_motion(&confine,
+						 weston_coord(112.5, 10.5),
+						 weston_coord(140.5, 10.5));
+	assert(fabs(got.x - (120.0 - EPSILON)) < 1e-9);
+
+	/* a shrunk input region takes effect after the update */
+	pixman_region32_fini(&input);
+	pixman_region32_init_rect(&input, 0, 0, 50, 130);
+	weston_confine_region_update(&confine, &input, &constraint);
+	got = weston_confine_region_clamp_motion(&confine,
+						 weston_coord(10.5, 10.5),
+						 weston_coord(90.5, 10.5));
+	assert(fabs(got.x - (50.0 - EPSILON)) < 1e-9);
+
+	/* an empty area has no borders and does not clamp */
+	pixman_region32_clear(&input);
+	weston_confine_region_update(&confine, &input, &constraint);
+	assert(confine.horizontal.size == 0 && confine.vertical.size == 0);
+
+	weston_confine_region_fini(&confine);
+	pixman_region32_fini(&effective);
+	pixman_region32_fini(&constraint);
+	pixman_region32_fini(&input);
+}
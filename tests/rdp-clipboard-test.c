@@ -0,0 +1,261 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "libweston/backend-rdp/rdpclip-transcode.h"
+
+/* Large enough to span many transcoder chunks and pipe buffers. */
+#define PAYLOAD_CODEPOINTS (3 * 1024 * 1024)
+
+struct payload {
+	struct wl_array utf8;
+	struct wl_array utf16;
+};
+
+static void
+append(struct wl_array *array, const void *data, size_t size)
+{
+	void *p;
+
+	p = wl_array_add(array, size);
+	assert(p);
+	memcpy(p, data, size);
+}
+
+/* A mix of 1 to 4 byte UTF-8 sequences, including surrogate pairs on the
+ * UTF-16 side, with the expected transcoding built alongside. */
+static void
+payload_init(struct payload *payload)
+{
+	static const uint32_t samples[] = {
+		'a', '\n', 0x7f, 0xe9, 0x7ff, 0x800, 0x20ac, 0xfeff,
+		0xffff, 0x10000, 0x1f600, 0x10ffff,
+	};
+	unsigned int i;
+
+	wl_array_init(&payload->utf8);
+	wl_array_init(&payload->utf16);
+
+	for (i = 0; i < PAYLOAD_CODEPOINTS; i++) {
+		uint32_t c = samples[(i * 7 + i / 5) % ARRAY_LENGTH(samples)];
+		uint8_t u8[4];
+		uint8_t u16[4];
+		size_t n8, n16;
+
+		if (c < 0x80) {
+			u8[0] = c;
+			n8 = 1;
+		} else if (c < 0x800) {
+			u8[0] = 0xc0 | (c >> 6);
+			u8[1] = 0x80 | (c & 0x3f);
+			n8 = 2;
+		} else if (c < 0x10000) {
+			u8[0] = 0xe0 | (c >> 12);
+			u8[1] = 0x80 | ((c >> 6) & 0x3f);
+			u8[2] = 0x80 | (c & 0x3f);
+			n8 = 3;
+		} else {
+			u8[0] = 0xf0 | (c >> 18);
+			u8[1] = 0x80 | ((c >> 12) & 0x3f);
+			u8[2] = 0x80 | ((c >> 6) & 0x3f);
+			u8[3] = 0x80 | (c & 0x3f);
+			n8 = 4;
+		}
+
+		if (c < 0x10000) {
+			u16[0] = c & 0xff;
+			u16[1] = c >> 8;
+			n16 = 2;
+		} else {
+			uint32_t high = 0xd800 | ((c - 0x10000) >> 10);
+			uint32_t low = 0xdc00 | ((c - 0x10000) & 0x3ff);
+
+			u16[0] = high & 0xff;
+			u16[1] = high >> 8;
+			u16[2] = low & 0xff;
+			u16[3] = low >> 8;
+			n16 = 4;
+		}
+
+		append(&payload->utf8, u8, n8);
+		append(&payload->utf16, u16, n16);
+	}
+
+	assert(payload->utf8.size > 4 * 1024 * 1024);
+}
+
+static void
+payload_fini(struct payload *payload)
+{
+	wl_array_release(&payload->utf8);
+	wl_array_release(&payload->utf16);
+}
+
+static void
+assert_array_eq(const struct wl_array *a, const struct wl_array *b)
+{
+	assert(a->size == b->size);
+	assert(memcmp(a->data, b->data, a->size) == 0);
+}
+
+/* Feed @in split at irregular points, so sequences straddle chunks. */
+static void
+transcode_in_pieces(enum rdp_clipboard_transcode_direction direction,
+		    const struct wl_array *in, struct wl_array *out)
+{
+	static const size_t pieces[] = { 1, 2, 3, 4093, 5, 65537, 7, 1 << 20 };
+	struct rdp_clipboard_transcoder transcoder;
+	const uint8_t *data = in->data;
+	size_t remaining = in->size;
+	unsigned int i = 0;
+
+	rdp_clipboard_transcoder_init(&transcoder, direction);
+	while (remaining) {
+		size_t size = pieces[i++ % ARRAY_LENGTH(pieces)];
+
+		size = MIN(size, remaining);
+		assert(rdp_clipboard_transcoder_feed(&transcoder, data, size, out));
+		data += size;
+		remaining -= size;
+	}
+	assert(rdp_clipboard_transcoder_finish(&transcoder, out));
+}
+
+TEST(transcode_large_utf8_to_utf16)
+{
+	struct payload payload;
+	struct wl_array out;
+
+	payload_init(&payload);
+
+	wl_array_init(&out);
+	assert(rdp_clipboard_transcode(RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+				       payload.utf8.data, payload.utf8.size,
+				       &out));
+	assert_array_eq(&out, &payload.utf16);
+	wl_array_release(&out);
+
+	wl_array_init(&out);
+	transcode_in_pieces(RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+			    &payload.utf8, &out);
+	assert_array_eq(&out, &payload.utf16);
+	wl_array_release(&out);
+
+	payload_fini(&payload);
+}
+
+TEST(transcode_large_utf16_to_utf8)
+{
+	struct payload payload;
+	struct wl_array out;
+
+	payload_init(&payload);
+
+	wl_array_init(&out);
+	assert(rdp_clipboard_transcode(RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+				       payload.utf16.data, payload.utf16.size,
+				       &out));
+	assert_array_eq(&out, &payload.utf8);
+	wl_array_release(&out);
+
+	wl_array_init(&out);
+	transcode_in_pieces(RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+			    &payload.utf16, &out);
+	assert_array_eq(&out, &payload.utf8);
+	wl_array_release(&out);
+
+	payload_fini(&payload);
+}
+
+struct malformed_test_data {
+	enum rdp_clipboard_transcode_direction direction;
+	const char *in;
+	size_t in_size;
+	const char *out;
+	size_t out_size;
+};
+
+static const struct malformed_test_data malformed_test_data[] = {
+	/* truncated sequence followed by ASCII */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+	  "\xe2\x82" "a", 3, "\xfd\xff" "a\0", 4 },
+	/* truncated sequence at the end */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+	  "a\xf0\x9f\x98", 4, "a\0" "\xfd\xff", 4 },
+	/* overlong encoding */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+	  "\xe0\x80\xaf", 3, "\xfd\xff", 2 },
+	/* encoded surrogate */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+	  "\xed\xa0\x80", 3, "\xfd\xff", 2 },
+	/* stray continuation and invalid lead bytes */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF8_TO_UTF16,
+	  "\x80\xc0\xff", 3, "\xfd\xff\xfd\xff\xfd\xff", 6 },
+	/* lone low surrogate */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+	  "\x00\xdc" "a\0", 4, "\xef\xbf\xbd" "a", 4 },
+	/* high surrogate without low surrogate */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+	  "\x3d\xd8" "a\0", 4, "\xef\xbf\xbd" "a", 4 },
+	/* high surrogate at the end */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+	  "a\0" "\x3d\xd8", 4, "a" "\xef\xbf\xbd", 4 },
+	/* odd number of bytes */
+	{ RDP_CLIPBOARD_TRANSCODE_UTF16_TO_UTF8,
+	  "a\0" "b", 3, "a" "\xef\xbf\xbd", 4 },
+};
+
+TEST_P(transcode_malformed, malformed_test_data)
+{
+	const struct malformed_test_data *test = data;
+	struct wl_array in;
+	struct wl_array out;
+
+	wl_array_init(&out);
+	assert(rdp_clipboard_transcode(test->direction,
+				       test->in, test->in_size, &out));
+	assert(out.size == test->out_size);
+	assert(memcmp(out.data, test->out, out.size) == 0);
+	wl_array_release(&out);
+
+	/* same result when fed in pieces */
+	wl_array_init(&in);
+	append(&in, test->in, test->in_size);
+	wl_array_init(&out);
+	transcode_in_pieces(test->direction, &in, &out);
+	assert(out.size == test->out_size);
+	assert(memcmp(out.data, test->out, out.size) == 0);
+	wl_array_release(&out);
+	wl_array_release(&in);
+}
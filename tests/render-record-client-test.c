@@ -0,0 +1,126 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_NOOP;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.virtual_clock = WESTON_VIRTUAL_CLOCK_MANUAL;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Long enough for any scheduled repaint and its frame completion. */
+#define SETTLE_NSEC 1000000000
+
+static void
+advance_clock(struct client *client, int64_t nsec)
+{
+	struct timespec duration;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_from_nsec(&duration, nsec);
+	timespec_to_proto(&duration, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_advance_clock(client->test->weston_test,
+				  tv_sec_hi, tv_sec_lo, tv_nsec);
+	client_roundtrip(client);
+}
+
+static void
+commit_and_repaint(struct client *client, int x, int y, int w, int h)
+{
+	struct surface *surface = client->surface;
+
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, x, y, w, h);
+	wl_surface_commit(surface->wl_surface);
+
+	/* Let the repaint loop start before advancing the clock. */
+	client_roundtrip(client);
+	client_roundtrip(client);
+
+	client->test->n_repaints_recorded = 0;
+	advance_clock(client, SETTLE_NSEC);
+}
+
+TEST(repaint_records_nodes_and_uploads)
+{
+	struct client *client;
+	struct surface *surface;
+
+	client = create_client();
+	surface = create_test_surface(client);
+	client->surface = surface;
+
+	surface->width = 100;
+	surface->height = 100;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, surface->width,
+						     surface->height);
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, 10, 10);
+
+	/* Let the initial full repaint go by unrecorded. */
+	advance_clock(client, SETTLE_NSEC);
+	weston_test_record_repaints(client->test->weston_test);
+
+	/* Mapping damages the whole surface: the blended surface and the
+	 * background beneath it are both drawn over 100x100, and the
+	 * whole 32-bit buffer is uploaded. */
+	commit_and_repaint(client, 0, 0, 100, 100);
+	assert(client->test->n_repaints_recorded == 1);
+	assert(client->test->recorded_repaint.nodes == 2);
+	assert(client->test->recorded_repaint.pixels == 2 * 100 * 100);
+	assert(client->test->recorded_repaint.upload_bytes == 100 * 100 * 4);
+
+	/* Partial damage only redraws and uploads that part. */
+	commit_and_repaint(client, 0, 0, 10, 10);
+	assert(client->test->n_repaints_recorded == 1);
+	assert(client->test->recorded_repaint.nodes == 2);
+	assert(client->test->recorded_repaint.pixels == 2 * 10 * 10);
+	assert(client->test->recorded_repaint.upload_bytes == 10 * 10 * 4);
+
+	/* Nothing to repaint, nothing recorded. */
+	client->test->n_repaints_recorded = 0;
+	advance_clock(client, SETTLE_NSEC);
+	assert(client->test->n_repaints_recorded == 0);
+
+	client_destroy(client);
+}
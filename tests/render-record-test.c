@@ -0,0 +1,126 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum weston_renderer_type renderer;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.renderer = WESTON_RENDERER_NOOP,
+		.meta.name = "noop",
+	},
+	{
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.meta.name = "pixman",
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = arg->renderer;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+static void
+record_nothing(const struct weston_render_record *record, void *data)
+{
+}
+
+PLUGIN_TEST(recorder_needs_noop_renderer)
+{
+	/* struct weston_compositor *compositor; */
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	int expected = args->renderer == WESTON_RENDERER_NOOP ? 0 : -1;
+
+	assert(noop_renderer_set_recorder(compositor,
+					  record_nothing, NULL) == expected);
+	assert(noop_renderer_set_recorder(compositor, NULL, NULL) == expected);
+}
+
+static void
+add_node(struct weston_render_record *record, uint64_t pixels,
+	 bool blend, bool needs_filtering)
+{
+	struct weston_render_record_node *node;
+
+	node = wl_array_add(&record->nodes, sizeof *node);
+	assert(node);
+	*node = (struct weston_render_record_node) {
+		.pixels = pixels,
+		.blend = blend,
+		.needs_filtering = needs_filtering,
+	};
+}
+
+PLUGIN_TEST(cost_model_estimate)
+{
+	/* struct weston_compositor *compositor; */
+	const struct weston_render_cost_model model = {
+		.nsec_per_node = 1000.0,
+		.nsec_per_pixel = 1.0,
+		.nsec_per_blended_pixel = 2.0,
+		.nsec_per_filtered_pixel = 4.0,
+		.nsec_per_upload_byte = 0.5,
+	};
+	struct weston_render_record record = {
+		.upload_bytes = 4000000,
+	};
+	double msec;
+
+	wl_array_init(&record.nodes);
+	wl_array_init(&record.uploads);
+
+	/* opaque 1920x1080 background */
+	add_node(&record, 1920 * 1080, false, false);
+	/* blended, scaled 100x100 window */
+	add_node(&record, 100 * 100, true, true);
+
+	msec = weston_render_record_estimate_msec(&record, &model);
+
+	/* 2 nodes + opaque pixels + (1 + 2 + 4) per window pixel + uploads */
+	assert(fabs(msec - (2000.0 + 1920 * 1080 + 7.0 * 100 * 100 +
+			    2000000.0) / 1e6) < 1e-9);
+
+	wl_array_release(&record.nodes);
+}
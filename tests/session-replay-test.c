@@ -0,0 +1,406 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared/helpers.h"
+#include "shared/session-record.h"
+#include "shared/string-helpers.h"
+#include "shared/xalloc.h"
+#include "test-config.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define BUFFER_SIZE 16
+
+static char *recording_path;
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+	const char *dir = getenv("WESTON_TEST_OUTPUT_PATH");
+
+	str_printf(&recording_path, "%s/session-replay.rec", dir ? dir : ".");
+	assert(recording_path);
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_NOOP;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.record_session = recording_path;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct recording {
+	char *data;
+	size_t size;
+};
+
+struct record {
+	const struct session_record_header *header;
+	const uint32_t *payload;
+	size_t offset;		/* of the header in the recording */
+};
+
+static void
+recording_read(struct recording *rec, const char *path)
+{
+	FILE *fp;
+	long size;
+
+	fp = fopen(path, "re");
+	assert(fp);
+	assert(fseek(fp, 0, SEEK_END) == 0);
+	size = ftell(fp);
+	assert(size >= 0);
+	rewind(fp);
+
+	rec->size = size;
+	rec->data = xzalloc(rec->size + 1);
+	assert(fread(rec->data, 1, rec->size, fp) == rec->size);
+	fclose(fp);
+}
+
+static void
+recording_write(const struct recording *rec, size_t size, const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "we");
+	assert(fp);
+	assert(fwrite(rec->data, 1, size, fp) == size);
+	fclose(fp);
+}
+
+/* Iterate the complete records; the recorder may still be in the middle
+ * of writing the last one. */
+static bool
+record_next(const struct recording *rec, struct record *r)
+{
+	size_t offset = sizeof(struct session_record_file_header);
+	const struct session_record_header *header;
+
+	if (r->header)
+		offset = r->offset + sizeof *r->header + r->header->size;
+
+	if (offset > rec->size || rec->size - offset < sizeof *header)
+		return false;
+	header = (const void *) (rec->data + offset);
+	if (rec->size - offset - sizeof *header < header->size)
+		return false;
+
+	r->header = header;
+	r->payload = (const void *) (header + 1);
+	r->offset = offset;
+	return true;
+}
+
+static bool
+record_is_request(const struct record *r, const char *interface,
+		  uint32_t opcode)
+{
+	const uint32_t *p = r->payload;
+
+	return r->header->type == SESSION_RECORD_REQUEST &&
+	       p[1] == opcode && p[2] == strlen(interface) + 1 &&
+	       strcmp((const char *) &p[3], interface) == 0;
+}
+
+/* Returns the arguments of a request record: argument count, then type
+ * and value pairs. */
+static const uint32_t *
+request_args(const struct record *r)
+{
+	const uint32_t *p = r->payload;
+
+	return &p[3 + (p[2] + 3) / 4];
+}
+
+/* Runs weston-session-replay on the file, returning its exit status and
+ * everything it printed. */
+static int
+run_replay(const char *path, char **output)
+{
+	const char *argv[] = { WESTON_SESSION_REPLAY_PATH, "--fast",
+			       path, NULL };
+	FILE *out;
+	size_t size;
+	char buf[256];
+	ssize_t len;
+	int fds[2];
+	int status;
+	pid_t pid;
+
+	assert(pipe2(fds, O_CLOEXEC) == 0);
+
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		if (dup2(fds[1], STDOUT_FILENO) < 0 ||
+		    dup2(fds[1], STDERR_FILENO) < 0)
+			_exit(127);
+		execv(argv[0], (char * const *) argv);
+		_exit(127);
+	}
+	close(fds[1]);
+
+	out = open_memstream(output, &size);
+	assert(out);
+	while ((len = read(fds[0], buf, sizeof buf)) > 0)
+		fwrite(buf, 1, len, out);
+	fclose(out);
+	close(fds[0]);
+
+	assert(waitpid(pid, &status, 0) == pid);
+	testlog("weston-session-replay %s:\n%s", path, *output);
+	assert(WIFEXITED(status));
+
+	return WEXITSTATUS(status);
+}
+
+static void
+assert_replay_fails(const struct recording *rec, const char *path,
+		    const char *error)
+{
+	char *output;
+
+	recording_write(rec, rec->size, path);
+	assert(run_replay(path, &output) == 1);
+	assert(strstr(output, error));
+	free(output);
+}
+
+static void
+record_session(void)
+{
+	struct client *client;
+	struct surface *surface;
+	uint32_t *pixels;
+	int stride;
+	int frame;
+	int x, y;
+
+	client = create_client();
+	surface = create_test_surface(client);
+	client->surface = surface;
+
+	surface->width = BUFFER_SIZE;
+	surface->height = BUFFER_SIZE;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, BUFFER_SIZE,
+						     BUFFER_SIZE);
+	pixels = pixman_image_get_data(surface->buffer->image);
+	stride = pixman_image_get_stride(surface->buffer->image) / 4;
+	for (y = 0; y < BUFFER_SIZE; y++)
+		for (x = 0; x < BUFFER_SIZE; x++)
+			pixels[y * stride + x] = 0xff000000 | (y << 8) | x;
+
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, 10, 10);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0, BUFFER_SIZE, BUFFER_SIZE);
+	frame_callback_set(surface->wl_surface, &frame);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &frame);
+
+	client_destroy(client);
+}
+
+/* Finds the client that attached the buffer, and waits until the
+ * recorder has flushed everything up to its disconnection. Returns the
+ * offset just past its CLIENT_DESTROYED record. */
+static size_t
+wait_for_recording(struct recording *rec, uint32_t *client_number)
+{
+	struct client *other;
+	struct record r;
+	int i;
+
+	other = create_client();
+
+	for (i = 0; i < 1000; i++) {
+		*client_number = 0;
+		recording_read(rec, recording_path);
+
+		r.header = NULL;
+		while (record_next(rec, &r)) {
+			if (r.header->type == SESSION_RECORD_BUFFER_CONTENTS)
+				*client_number = r.header->client;
+			if (*client_number &&
+			    r.header->client == *client_number &&
+			    r.header->type == SESSION_RECORD_CLIENT_DESTROYED) {
+				client_destroy(other);
+				return r.offset + sizeof *r.header;
+			}
+		}
+
+		free(rec->data);
+		client_roundtrip(other);
+	}
+
+	assert(!"the client's disconnection was never recorded");
+	return 0;
+}
+
+TEST(record_and_replay_session)
+{
+	struct recording rec, snapshot;
+	const struct session_record_file_header *file_header;
+	struct record r, prev = { 0 };
+	uint32_t client_number;
+	unsigned int n_requests = 0;
+	bool got_registry = false;
+	bool got_attach = false;
+	bool got_commit = false;
+	bool got_destroyed = false;
+	char *snapshot_path;
+	char *path;
+	char *output;
+	char *expected;
+	size_t end;
+	size_t prev_offset = 0;
+	size_t attach_offset = 0;
+	size_t contents_offset = 0;
+	int x, y;
+
+	record_session();
+	end = wait_for_recording(&rec, &client_number);
+
+	file_header = (const void *) rec.data;
+	assert(memcmp(file_header->magic, SESSION_RECORD_MAGIC,
+		      sizeof file_header->magic) == 0);
+	assert(file_header->version == SESSION_RECORD_VERSION);
+
+	/* Keep only the recorded client, so the snapshot replays exactly
+	 * one session. */
+	snapshot.data = xzalloc(end);
+	snapshot.size = sizeof *file_header;
+	memcpy(snapshot.data, rec.data, sizeof *file_header);
+
+	r.header = NULL;
+	while (record_next(&rec, &r) && r.offset < end) {
+		size_t size = sizeof *r.header + r.header->size;
+
+		if (r.header->client != client_number)
+			continue;
+
+		if (snapshot.size == sizeof *file_header)
+			assert(r.header->type == SESSION_RECORD_CLIENT_CREATED);
+
+		if (r.header->type == SESSION_RECORD_REQUEST)
+			n_requests++;
+		if (record_is_request(&r, "wl_display", 1))
+			got_registry = true;
+		if (r.header->type == SESSION_RECORD_OBJECT_DESTROYED)
+			got_destroyed = true;
+		if (got_attach && record_is_request(&r, "wl_surface", 6))
+			got_commit = true;
+
+		/* The buffer contents come right before the attach that
+		 * uses them. */
+		if (record_is_request(&r, "wl_surface", 1)) {
+			const uint32_t *args = request_args(&r);
+			const uint32_t *contents = prev.payload;
+			const uint32_t *pixels = &contents[2];
+
+			assert(prev.header);
+			assert(prev.header->type ==
+			       SESSION_RECORD_BUFFER_CONTENTS);
+			assert(args[0] == 3);
+			assert(args[1] == 'o');
+			assert(args[2] == contents[0]);
+			assert(contents[1] == BUFFER_SIZE * BUFFER_SIZE * 4);
+			for (y = 0; y < BUFFER_SIZE; y++)
+				for (x = 0; x < BUFFER_SIZE; x++)
+					assert(pixels[y * BUFFER_SIZE + x] ==
+					       (0xff000000 | (y << 8) | x));
+
+			got_attach = true;
+			contents_offset = prev_offset;
+			attach_offset = snapshot.size;
+		}
+
+		prev = r;
+		prev_offset = snapshot.size;
+		memcpy(snapshot.data + snapshot.size, r.header, size);
+		snapshot.size += size;
+	}
+	assert(prev.header->type == SESSION_RECORD_CLIENT_DESTROYED);
+	assert(got_registry);
+	assert(got_attach);
+	assert(got_commit);
+	assert(got_destroyed);
+	free(rec.data);
+
+	str_printf(&snapshot_path, "%s.snapshot", recording_path);
+	assert(snapshot_path);
+	recording_write(&snapshot, snapshot.size, snapshot_path);
+
+	/* Requests on globals the replay does not know, like weston_test,
+	 * are counted but skipped. */
+	assert(run_replay(snapshot_path, &output) == 0);
+	str_printf(&expected, "replayed %u requests (", n_requests);
+	assert(expected);
+	assert(strstr(output, expected));
+	assert(!strstr(output, "(0 skipped)"));
+	free(expected);
+	free(output);
+
+	str_printf(&path, "%s.broken", recording_path);
+	assert(path);
+
+	/* Cut off in the middle of the buffer contents. */
+	rec = snapshot;
+	rec.size = contents_offset + sizeof(struct session_record_header) + 64;
+	assert_replay_fails(&rec, path, "truncated or corrupt");
+
+	rec = snapshot;
+	rec.data = xzalloc(snapshot.size);
+	memcpy(rec.data, snapshot.data, snapshot.size);
+	rec.data[0] = 'X';
+	assert_replay_fails(&rec, path, "is not a session recording");
+	rec.data[0] = snapshot.data[0];
+
+	/* An impossible argument count for the attach. */
+	r.header = (const void *) (rec.data + attach_offset);
+	r.payload = (const void *) (r.header + 1);
+	*(uint32_t *) request_args(&r) = UINT32_MAX;
+	assert_replay_fails(&rec, path, "truncated or corrupt");
+
+	free(rec.data);
+	free(snapshot.data);
+	free(snapshot_path);
+	free(path);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "compositor/weston.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+#define N_CURTAINS 5000
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+PLUGIN_TEST(solid_buffers_are_shared_by_color)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_buffer_reference *black[2];
+	struct weston_buffer_reference *grey;
+
+	black[0] = weston_buffer_create_solid_rgba(compositor,
+						   0.0, 0.0, 0.0, 1.0);
+	black[1] = weston_buffer_create_solid_rgba(compositor,
+						   0.0, 0.0, 0.0, 1.0);
+	grey = weston_buffer_create_solid_rgba(compositor,
+					       0.5, 0.5, 0.5, 1.0);
+	assert(black[0] && black[1] && grey);
+
+	assert(black[0] != black[1]);
+	assert(black[0]->buffer == black[1]->buffer);
+	assert(black[0]->buffer->busy_count == 2);
+	assert(grey->buffer != black[0]->buffer);
+	assert(grey->buffer->busy_count == 1);
+
+	weston_buffer_destroy_solid(black[0]);
+	assert(black[1]->buffer->busy_count == 1);
+	weston_buffer_destroy_solid(black[1]);
+	weston_buffer_destroy_solid(grey);
+
+	/* all gone, a new one must be usable */
+	black[0] = weston_buffer_create_solid_rgba(compositor,
+						   0.0, 0.0, 0.0, 1.0);
+	assert(black[0]);
+	assert(black[0]->buffer->busy_count == 1);
+	assert(black[0]->buffer->solid.a == 1.0);
+	weston_buffer_destroy_solid(black[0]);
+}
+
+PLUGIN_TEST(many_curtains)
+{
+	/* struct weston_compositor *compositor; */
+	static struct weston_surface *surfaces[N_CURTAINS];
+	static struct weston_buffer_reference *refs[N_CURTAINS];
+	struct weston_buffer *buffer;
+	struct timespec start, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < N_CURTAINS; i++) {
+		surfaces[i] = weston_surface_create(compositor);
+		assert(surfaces[i]);
+		refs[i] = weston_buffer_create_solid_rgba(compositor,
+							  0.0, 0.0, 0.0, 0.75);
+		assert(refs[i]);
+		weston_surface_attach_solid(surfaces[i], refs[i], 100, 100);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	testlog("created %d curtains in %.3f ms\n", N_CURTAINS,
+		timespec_sub_to_nsec(&end, &start) / 1e6);
+
+	/* one buffer for all of them */
+	buffer = refs[0]->buffer;
+	for (i = 0; i < N_CURTAINS; i++)
+		assert(refs[i]->buffer == buffer);
+	assert(buffer->busy_count >= N_CURTAINS);
+
+	for (i = 0; i < N_CURTAINS; i++) {
+		weston_surface_unref(surfaces[i]);
+		weston_buffer_destroy_solid(refs[i]);
+	}
+}
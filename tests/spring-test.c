@@ -0,0 +1,157 @@
+/*
+ * Copyright 2023 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "compositor/weston.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* The fixed step integrator weston_spring_update() has to agree with */
+static void
+reference_spring_update(struct weston_spring *spring,
+			const struct timespec *time)
+{
+	double force, v, current, step;
+
+	step = 0.01;
+	while (4 < timespec_sub_to_msec(time, &spring->timestamp)) {
+		current = spring->current;
+		v = current - spring->previous;
+		force = spring->k * (spring->target - current) / 10.0 +
+			(spring->previous - current) - v * spring->friction;
+
+		spring->current =
+			current + (current - spring->previous) +
+			force * step * step;
+		spring->previous = current;
+
+		switch (spring->clip) {
+		case WESTON_SPRING_OVERSHOOT:
+			break;
+		case WESTON_SPRING_CLAMP:
+			if (spring->current > spring->max) {
+				spring->current = spring->max;
+				spring->previous = spring->max;
+			} else if (spring->current < 0.0) {
+				spring->current = spring->min;
+				spring->previous = spring->min;
+			}
+			break;
+		case WESTON_SPRING_BOUNCE:
+			if (spring->current > spring->max) {
+				spring->current =
+					2 * spring->max - spring->current;
+				spring->previous =
+					2 * spring->max - spring->previous;
+			} else if (spring->current < spring->min) {
+				spring->current =
+					2 * spring->min - spring->current;
+				spring->previous =
+					2 * spring->min - spring->previous;
+			}
+			break;
+		}
+
+		timespec_add_msec(&spring->timestamp, &spring->timestamp, 4);
+	}
+}
+
+struct spring_config {
+	double k, friction;
+	double start, previous, target;
+	uint32_t clip;
+};
+
+/* The animations in animation.c, zoom.c and a clamped one */
+static const struct spring_config spring_configs[] = {
+	{ 300.0, 1400.0, 0.5, 0.485, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 1000.0, 400.0, 0.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 400.0, 400.0, 1.0, 1.0, 0.0, WESTON_SPRING_OVERSHOOT },
+	{ 250.0, 400.0, 0.0, 0.0, 0.8, WESTON_SPRING_OVERSHOOT },
+	{ 400.0, 400.0, 0.0, 0.0, 1.0, WESTON_SPRING_BOUNCE },
+	{ 300.0, 1400.0, 0.2, 0.2, 0.9, WESTON_SPRING_CLAMP },
+};
+
+/* Frame intervals in ms, including stalls */
+static const int frame_intervals[] = { 16, 16, 7, 17, 33, 16, 250, 3, 16, 600 };
+
+PLUGIN_TEST(spring_matches_integrator)
+{
+	/* struct weston_compositor *compositor; */
+	const struct spring_config *config;
+	struct weston_spring spring, reference;
+	struct timespec time;
+	unsigned int i, j;
+
+	for (i = 0; i < ARRAY_LENGTH(spring_configs); i++) {
+		config = &spring_configs[i];
+
+		weston_spring_init(&spring, config->k,
+				   config->start, config->target);
+		spring.friction = config->friction;
+		spring.previous = config->previous;
+		spring.clip = config->clip;
+		spring.timestamp = (struct timespec) { 10, 0 };
+		reference = spring;
+		time = spring.timestamp;
+
+		for (j = 0; j < 4 * ARRAY_LENGTH(frame_intervals); j++) {
+			timespec_add_msec(&time, &time, frame_intervals[j %
+					  ARRAY_LENGTH(frame_intervals)]);
+			weston_spring_update(&spring, &time);
+			reference_spring_update(&reference, &time);
+
+			assert(fabs(spring.current - reference.current) < 1e-9);
+			assert(fabs(spring.previous - reference.previous) < 1e-9);
+			assert(timespec_eq(&spring.timestamp,
+					   &reference.timestamp));
+			assert(weston_spring_done(&spring) ==
+			       weston_spring_done(&reference));
+		}
+
+		assert(weston_spring_done(&spring));
+	}
+}
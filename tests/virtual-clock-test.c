@@ -0,0 +1,305 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "presentation-time-client-protocol.h"
+#include "weston-test-fixture-compositor.h"
+
+/* The headless backend runs at 60 Hz. */
+#define REFRESH_NSEC 16666666
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.virtual_clock = WESTON_VIRTUAL_CLOCK_MANUAL;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct feedback {
+	struct wp_presentation_feedback *obj;
+	bool presented;
+	struct timespec time;
+	uint32_t refresh_nsec;
+};
+
+static void
+feedback_sync_output(void *data,
+		     struct wp_presentation_feedback *presentation_feedback,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data,
+		   struct wp_presentation_feedback *presentation_feedback,
+		   uint32_t tv_sec_hi,
+		   uint32_t tv_sec_lo,
+		   uint32_t tv_nsec,
+		   uint32_t refresh_nsec,
+		   uint32_t seq_hi,
+		   uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct feedback *fb = data;
+
+	fb->presented = true;
+	timespec_from_proto(&fb->time, tv_sec_hi, tv_sec_lo, tv_nsec);
+	fb->refresh_nsec = refresh_nsec;
+}
+
+static void
+feedback_discarded(void *data,
+		   struct wp_presentation_feedback *presentation_feedback)
+{
+	assert(0 && "feedback discarded");
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static struct wp_presentation *
+get_presentation(struct client *client)
+{
+	struct global *g;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, wp_presentation_interface.name) == 0)
+			return wl_registry_bind(client->wl_registry, g->name,
+						&wp_presentation_interface, 1);
+	}
+
+	assert(0 && "no presentation found");
+	return NULL;
+}
+
+static void
+advance_clock(struct client *client, int64_t nsec)
+{
+	struct timespec duration;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_from_nsec(&duration, nsec);
+	timespec_to_proto(&duration, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_advance_clock(client->test->weston_test,
+				  tv_sec_hi, tv_sec_lo, tv_nsec);
+	client_roundtrip(client);
+}
+
+/* Like create_client_and_test_surface(), but without waiting for a frame
+ * callback which would never come with a manual clock. */
+static struct client *
+create_client_with_surface(void)
+{
+	struct client *client;
+	struct surface *surface;
+
+	client = create_client();
+	surface = create_test_surface(client);
+	client->surface = surface;
+
+	surface->width = 100;
+	surface->height = 100;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, surface->width,
+						     surface->height);
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, 10, 10);
+
+	/* Let any repaint left over from earlier tests run its course. */
+	advance_clock(client, 1000000000);
+
+	return client;
+}
+
+static void
+commit_with_feedback(struct client *client, struct wp_presentation *pres,
+		     struct feedback *fb)
+{
+	struct surface *surface = client->surface;
+
+	*fb = (struct feedback) { };
+	fb->obj = wp_presentation_feedback(pres, surface->wl_surface);
+	wp_presentation_feedback_add_listener(fb->obj, &feedback_listener, fb);
+
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0, 100, 100);
+	wl_surface_commit(surface->wl_surface);
+
+	/* Make sure the repaint loop has been started before advancing. */
+	client_roundtrip(client);
+	client_roundtrip(client);
+}
+
+TEST(manual_clock_stands_still)
+{
+	struct client *client;
+	struct wp_presentation *pres;
+	struct feedback fb;
+
+	client = create_client_with_surface();
+	pres = get_presentation(client);
+
+	commit_with_feedback(client, pres, &fb);
+	assert(!fb.presented);
+
+	/* 1 ms is not enough for the repaint and the frame completion
+	 * that sends the presentation feedback. */
+	advance_clock(client, 1000000);
+	assert(!fb.presented);
+
+	advance_clock(client, 2 * REFRESH_NSEC);
+	assert(fb.presented);
+	assert(fb.refresh_nsec == REFRESH_NSEC);
+
+	wp_presentation_feedback_destroy(fb.obj);
+	wp_presentation_destroy(pres);
+	client_destroy(client);
+}
+
+TEST(manual_clock_is_deterministic)
+{
+	struct client *client;
+	struct wp_presentation *pres;
+	struct feedback fb[2];
+	int64_t delta;
+
+	client = create_client_with_surface();
+	pres = get_presentation(client);
+
+	commit_with_feedback(client, pres, &fb[0]);
+	advance_clock(client, 100000000);
+	assert(fb[0].presented);
+
+	commit_with_feedback(client, pres, &fb[1]);
+	advance_clock(client, 100000000);
+	assert(fb[1].presented);
+
+	/* Both frames were committed while the output was idle and exactly
+	 * 100 ms of virtual time apart, so their presentation must be too. */
+	delta = timespec_sub_to_nsec(&fb[1].time, &fb[0].time);
+	testlog("presentation delta %" PRId64 " ns\n", delta);
+	assert(delta == 100000000);
+
+	wp_presentation_feedback_destroy(fb[0].obj);
+	wp_presentation_feedback_destroy(fb[1].obj);
+	wp_presentation_destroy(pres);
+	client_destroy(client);
+}
+
+#define N_SURFACES 32
+
+struct frame {
+	struct wl_callback *callback;
+	bool done;
+	uint32_t time;
+};
+
+static void
+frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct frame *frame = data;
+
+	frame->done = true;
+	frame->time = time;
+	wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	frame_done
+};
+
+TEST(frame_callbacks_of_a_client_arrive_together)
+{
+	struct client *client;
+	struct surface *surfaces[N_SURFACES];
+	struct frame frames[N_SURFACES] = { };
+	int i;
+
+	client = create_client_with_surface();
+
+	for (i = 0; i < N_SURFACES; i++) {
+		surfaces[i] = create_test_surface(client);
+		surfaces[i]->buffer = create_shm_buffer_a8r8g8b8(client, 10, 10);
+		weston_test_move_surface(client->test->weston_test,
+					 surfaces[i]->wl_surface,
+					 10 * i, 200);
+
+		frames[i].callback = wl_surface_frame(surfaces[i]->wl_surface);
+		wl_callback_add_listener(frames[i].callback,
+					 &frame_listener, &frames[i]);
+		wl_surface_attach(surfaces[i]->wl_surface,
+				  surfaces[i]->buffer->proxy, 0, 0);
+		wl_surface_damage(surfaces[i]->wl_surface, 0, 0, 10, 10);
+		wl_surface_commit(surfaces[i]->wl_surface);
+	}
+	client_roundtrip(client);
+
+	for (i = 0; i < N_SURFACES; i++)
+		assert(!frames[i].done);
+
+	/* One repaint, one batch, one timestamp. */
+	advance_clock(client, 2 * REFRESH_NSEC);
+	for (i = 0; i < N_SURFACES; i++) {
+		assert(frames[i].done);
+		assert(frames[i].time == frames[0].time);
+	}
+
+	for (i = 0; i < N_SURFACES; i++)
+		surface_destroy(surfaces[i]);
+	client_destroy(client);
+}
+
+TEST(out_of_range_advance_is_a_protocol_error)
+{
+	struct client *client;
+
+	client = create_client_with_surface();
+
+	weston_test_advance_clock(client->test->weston_test,
+				  UINT32_MAX, 0, 0);
+	expect_protocol_error(client, &weston_test_interface,
+			      WESTON_TEST_ERROR_INVALID_DURATION);
+
+	client_destroy(client);
+}
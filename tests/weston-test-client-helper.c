@@ -569,8 +569,25 @@ test_handle_pointer_position(void *data, struct weston_test *weston_test,
 		test->pointer_x, test->pointer_y);
 }
 
+static void
+test_handle_repaint_recorded(void *data, struct weston_test *weston_test,
+			     uint32_t nodes, uint32_t pixels,
+			     uint32_t upload_bytes)
+{
+	struct test *test = data;
+
+	test->n_repaints_recorded++;
+	test->recorded_repaint.nodes = nodes;
+	test->recorded_repaint.pixels = pixels;
+	test->recorded_repaint.upload_bytes = upload_bytes;
+
+	testlog("test-client: repaint recorded, %u nodes, %u pixels, "
+		"%u bytes uploaded\n", nodes, pixels, upload_bytes);
+}
+
 static const struct weston_test_listener test_listener = {
 	test_handle_pointer_position,
+	test_handle_repaint_recorded,
 };
 
 static void
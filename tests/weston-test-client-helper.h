@@ -80,6 +80,13 @@ struct test {
 	int pointer_x;
 	int pointer_y;
 	uint32_t n_egl_buffers;
+	/* weston_test.record_repaints, the last repaint_recorded event */
+	uint32_t n_repaints_recorded;
+	struct {
+		uint32_t nodes;
+		uint32_t pixels;
+		uint32_t upload_bytes;
+	} recorded_repaint;
 };
 
 struct input {
@@ -49,6 +49,16 @@ struct desktest_shell {
 	struct weston_curtain *background;
 	struct weston_layer layer;
 	struct weston_view *view;
+	struct desktest_resize_grab *resize_grab;
+};
+
+/* Resizes the surface from its bottom-right corner while a button is
+ * held, like an interactive resize in a real shell would. */
+struct desktest_resize_grab {
+	struct weston_pointer_grab grab;
+	struct desktest_shell *dts;
+	struct weston_desktop_surface *desktop_surface;
+	int32_t width, height;
 };
 
 static void
@@ -64,6 +74,88 @@ desktop_surface_added(struct weston_desktop_surface *desktop_surface,
 	assert(dts->view);
 }
 
+static void
+resize_grab_end(struct desktest_resize_grab *resize)
+{
+	resize->dts->resize_grab = NULL;
+	weston_pointer_end_grab(resize->grab.pointer);
+	free(resize);
+}
+
+static void
+resize_grab_focus(struct weston_pointer_grab *grab)
+{
+}
+
+static void
+resize_grab_motion(struct weston_pointer_grab *grab,
+		   const struct timespec *time,
+		   struct weston_pointer_motion_event *event)
+{
+	struct desktest_resize_grab *resize =
+		container_of(grab, struct desktest_resize_grab, grab);
+	struct weston_pointer *pointer = grab->pointer;
+	int32_t width, height;
+
+	weston_pointer_move(pointer, event);
+
+	width = resize->width + (int32_t) (pointer->pos.c.x -
+					   pointer->grab_pos.c.x);
+	height = resize->height + (int32_t) (pointer->pos.c.y -
+					     pointer->grab_pos.c.y);
+	weston_desktop_surface_set_size(resize->desktop_surface,
+					MAX(1, width), MAX(1, height));
+}
+
+static void
+resize_grab_button(struct weston_pointer_grab *grab,
+		   const struct timespec *time,
+		   uint32_t button, uint32_t state)
+{
+	struct desktest_resize_grab *resize =
+		container_of(grab, struct desktest_resize_grab, grab);
+
+	if (grab->pointer->button_count == 0 &&
+	    state == WL_POINTER_BUTTON_STATE_RELEASED)
+		resize_grab_end(resize);
+}
+
+static void
+resize_grab_axis(struct weston_pointer_grab *grab,
+		 const struct timespec *time,
+		 struct weston_pointer_axis_event *event)
+{
+}
+
+static void
+resize_grab_axis_source(struct weston_pointer_grab *grab, uint32_t source)
+{
+}
+
+static void
+resize_grab_frame(struct weston_pointer_grab *grab)
+{
+}
+
+static void
+resize_grab_cancel(struct weston_pointer_grab *grab)
+{
+	struct desktest_resize_grab *resize =
+		container_of(grab, struct desktest_resize_grab, grab);
+
+	resize_grab_end(resize);
+}
+
+static const struct weston_pointer_grab_interface resize_grab_interface = {
+	resize_grab_focus,
+	resize_grab_motion,
+	resize_grab_button,
+	resize_grab_axis,
+	resize_grab_axis_source,
+	resize_grab_frame,
+	resize_grab_cancel,
+};
+
 static void
 desktop_surface_removed(struct weston_desktop_surface *desktop_surface,
 			void *shell)
@@ -72,6 +164,10 @@ desktop_surface_removed(struct weston_desktop_surface *desktop_surface,
 
 	assert(dts->view);
 
+	if (dts->resize_grab &&
+	    dts->resize_grab->desktop_surface == desktop_surface)
+		resize_grab_end(dts->resize_grab);
+
 	weston_desktop_surface_unlink_view(dts->view);
 	weston_view_destroy(dts->view);
 	dts->view = NULL;
@@ -110,6 +206,28 @@ desktop_surface_resize(struct weston_desktop_surface *desktop_surface,
 		       struct weston_seat *seat, uint32_t serial,
 		       enum weston_desktop_surface_edge edges, void *shell)
 {
+	struct desktest_shell *dts = shell;
+	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
+	struct desktest_resize_grab *resize;
+	struct weston_geometry geometry;
+
+	if (!pointer || pointer->button_count == 0 || dts->resize_grab)
+		return;
+
+	resize = zalloc(sizeof *resize);
+	if (!resize)
+		return;
+
+	geometry = weston_desktop_surface_get_geometry(desktop_surface);
+	resize->dts = dts;
+	resize->desktop_surface = desktop_surface;
+	resize->width = geometry.width;
+	resize->height = geometry.height;
+	resize->grab.interface = &resize_grab_interface;
+	dts->resize_grab = resize;
+
+	weston_pointer_start_grab(pointer, &resize->grab);
+	weston_pointer_clear_focus(pointer);
 }
 
 static void
@@ -195,9 +195,12 @@ compositor_setup_defaults_(struct compositor_setup *setup,
 		.height = 240,
 		.scale = 1,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.output_count = 0,
 		.config_file = NULL,
 		.extra_module = NULL,
 		.logging_scopes = NULL,
+		.virtual_clock = WESTON_VIRTUAL_CLOCK_DISABLED,
+		.record_session = NULL,
 		.testset_name = testset_name,
 	};
 }
@@ -237,6 +240,7 @@ shell_to_str(enum shell_type t)
 		[SHELL_DESKTOP] = "desktop",
 		[SHELL_FULLSCREEN] = "fullscreen",
 		[SHELL_IVI] = "ivi",
+		[SHELL_KIOSK] = "kiosk",
 	};
 	assert(t >= 0 && t < ARRAY_LENGTH(names));
 	return names[t];
@@ -319,6 +323,11 @@ execute_compositor(const struct compositor_setup *setup,
 		prog_args_take(&args, tmp);
 	}
 
+	if (setup->output_count > 0) {
+		str_printf(&tmp, "--output-count=%d", setup->output_count);
+		prog_args_take(&args, tmp);
+	}
+
 	if (setup->config_file) {
 		str_printf(&tmp, "--config=%s", setup->config_file);
 		prog_args_take(&args, tmp);
@@ -341,6 +350,22 @@ execute_compositor(const struct compositor_setup *setup,
 	if (setup->xwayland)
 		prog_args_take(&args, strdup("--xwayland"));
 
+	switch (setup->virtual_clock) {
+	case WESTON_VIRTUAL_CLOCK_DISABLED:
+		break;
+	case WESTON_VIRTUAL_CLOCK_AUTO:
+		prog_args_take(&args, strdup("--virtual-clock=auto"));
+		break;
+	case WESTON_VIRTUAL_CLOCK_MANUAL:
+		prog_args_take(&args, strdup("--virtual-clock=manual"));
+		break;
+	}
+
+	if (setup->record_session) {
+		str_printf(&tmp, "--record-session=%s", setup->record_session);
+		prog_args_take(&args, tmp);
+	}
+
 	if (setenv("WESTON_MODULE_MAP", WESTON_MODULE_MAP, 0) < 0 ||
 	    setenv("WESTON_DATA_DIR", WESTON_DATA_DIR, 0) < 0) {
 		fprintf(stderr, "Error: environment setup failed.\n");
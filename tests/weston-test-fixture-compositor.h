@@ -45,7 +45,9 @@ enum shell_type {
 	/** The ivi-shell. */
 	SHELL_IVI,
 	/** The fullscreen-shell. */
-	SHELL_FULLSCREEN
+	SHELL_FULLSCREEN,
+	/** The kiosk-shell. */
+	SHELL_KIOSK
 };
 
 /** Weston compositor configuration
@@ -75,6 +77,8 @@ struct compositor_setup {
 	int scale;
 	/** Default output transform, one of WL_OUTPUT_TRANSFORM_*. */
 	enum wl_output_transform transform;
+	/** Number of outputs of the headless backend, 0 for the default. */
+	int output_count;
 	/** The absolute path to \c weston.ini to use,
 	 * or NULL for \c --no-config .
 	 * To properly fill this entry use weston_ini_setup() */
@@ -84,6 +88,10 @@ struct compositor_setup {
 	/** Debug scopes for the compositor log,
 	 * or NULL for compositor defaults. */
 	const char *logging_scopes;
+	/** Presentation clock of the headless backend. */
+	enum weston_virtual_clock_mode virtual_clock;
+	/** Path to record the client session to, or NULL for none. */
+	const char *record_session;
 	/** The name of this test program, used as a unique identifier. */
 	const char *testset_name;
 };
@@ -105,9 +113,12 @@ compositor_setup_defaults_(struct compositor_setup *setup,
  * - height: 240
  * - scale: 1
  * - transform: WL_OUTPUT_TRANSFORM_NORMAL
+ * - output_count: backend default
  * - config_file: none
  * - extra_module: none
  * - logging_scopes: compositor defaults
+ * - virtual_clock: disabled (wall time)
+ * - record_session: none
  * - testset_name: the test name from meson.build
  *
  * \ingroup testharness
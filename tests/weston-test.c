@@ -63,6 +63,9 @@ struct weston_test {
 
 	pthread_t client_thread;
 	struct wl_event_source *client_source;
+
+	/* weston_test resource that asked for record_repaints */
+	struct wl_resource *recorder_resource;
 };
 
 struct weston_test_surface {
@@ -448,6 +451,70 @@ send_touch(struct wl_client *client, struct wl_resource *resource,
 	}
 }
 
+static void
+advance_clock(struct wl_client *client, struct wl_resource *resource,
+	      uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec)
+{
+	struct weston_test *test = wl_resource_get_user_data(resource);
+	struct weston_compositor *compositor = test->compositor;
+	struct timespec duration;
+
+	if (compositor->virtual_clock.mode == WESTON_VIRTUAL_CLOCK_DISABLED) {
+		wl_resource_post_error(resource,
+				       WESTON_TEST_ERROR_NO_VIRTUAL_CLOCK,
+				       "Test protocol asked to advance a "
+				       "real presentation clock");
+		return;
+	}
+
+	/* Keep the duration representable in int64_t nanoseconds */
+	if (tv_sec_hi != 0 || tv_nsec >= NSEC_PER_SEC) {
+		wl_resource_post_error(resource,
+				       WESTON_TEST_ERROR_INVALID_DURATION,
+				       "Test protocol asked to advance the "
+				       "clock by an out of range duration");
+		return;
+	}
+
+	timespec_from_proto(&duration, tv_sec_hi, tv_sec_lo, tv_nsec);
+	weston_compositor_advance_virtual_clock(compositor,
+						timespec_to_nsec(&duration));
+}
+
+static void
+record_repaint(const struct weston_render_record *record, void *data)
+{
+	struct wl_resource *resource = data;
+	const struct weston_render_record_node *node;
+	uint32_t nodes = 0;
+	uint64_t pixels = 0;
+
+	wl_array_for_each(node, &record->nodes) {
+		nodes++;
+		pixels += node->pixels;
+	}
+
+	weston_test_send_repaint_recorded(resource, nodes, pixels,
+					  record->upload_bytes);
+}
+
+static void
+record_repaints(struct wl_client *client, struct wl_resource *resource)
+{
+	struct weston_test *test = wl_resource_get_user_data(resource);
+
+	if (noop_renderer_set_recorder(test->compositor,
+				       record_repaint, resource) < 0) {
+		wl_resource_post_error(resource,
+				       WESTON_TEST_ERROR_NO_RECORDER,
+				       "Test protocol asked to record repaints "
+				       "without the no-op renderer");
+		return;
+	}
+
+	test->recorder_resource = resource;
+}
+
 static const struct weston_test_interface test_implementation = {
 	move_surface,
 	move_pointer,
@@ -458,8 +525,22 @@ static const struct weston_test_interface test_implementation = {
 	device_release,
 	device_add,
 	send_touch,
+	advance_clock,
+	record_repaints,
 };
 
+static void
+destroy_test(struct wl_resource *resource)
+{
+	struct weston_test *test = wl_resource_get_user_data(resource);
+
+	if (test->recorder_resource != resource)
+		return;
+
+	noop_renderer_set_recorder(test->compositor, NULL, NULL);
+	test->recorder_resource = NULL;
+}
+
 static void
 bind_test(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 {
@@ -473,7 +554,8 @@ bind_test(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 	}
 
 	wl_resource_set_implementation(resource,
-				       &test_implementation, test, NULL);
+				       &test_implementation, test,
+				       destroy_test);
 
 	notify_pointer_position(test, resource);
 }
@@ -647,6 +729,9 @@ handle_compositor_destroy(struct wl_listener *listener,
 	if (test->is_seat_initialized)
 		test_seat_release(test);
 
+	if (test->recorder_resource)
+		wl_resource_set_destructor(test->recorder_resource, NULL);
+
 	wl_list_remove(&test->layer.view_list.link);
 	wl_list_remove(&test->layer.link);
 
@@ -32,6 +32,10 @@
  *		  3) Confirm that there's conforming Window Manager
  *		  4) Confirm that the window manager's name is "Weston WM"
  *		  5) Make sure we can map a window
+ *
+ *		  It also checks that an interactive resize does not send
+ *		  the X client one configure per pointer motion while
+ *		  Xwayland has not committed the previous one.
  */
 
 #include "config.h"
@@ -41,10 +45,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <poll.h>
+#include <linux/input.h>
 
 #include "weston-test-runner.h"
 #include "weston-test-fixture-compositor.h"
 #include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
 #include "weston-test-client-helper.h"
 #include "xcb-client-helper.h"
 
@@ -174,3 +181,189 @@ TEST(xwayland_client_test)
 	destroy_x11_window(window);
 	destroy_x11_connection(conn);
 }
+
+#define RESIZE_MOTIONS 20
+
+static void
+send_motion(struct client *client, int x, int y)
+{
+	struct timespec time;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	timespec_to_proto(&time, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_move_pointer(client->test->weston_test, tv_sec_hi, tv_sec_lo,
+				 tv_nsec, x, y);
+	client_roundtrip(client);
+}
+
+static void
+send_button(struct client *client, uint32_t button, uint32_t state)
+{
+	struct timespec time;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	timespec_to_proto(&time, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_send_button(client->test->weston_test, tv_sec_hi, tv_sec_lo,
+				tv_nsec, button, state);
+	client_roundtrip(client);
+}
+
+static void
+x11_sync(xcb_connection_t *conn)
+{
+	free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), NULL));
+}
+
+/* Returns the next event of the given type, dropping any other events,
+ * or NULL if none arrives within timeout_ms. */
+static xcb_generic_event_t *
+wait_for_x11_event(xcb_connection_t *conn, uint8_t type, int timeout_ms)
+{
+	struct pollfd pfd = {
+		.fd = xcb_get_file_descriptor(conn),
+		.events = POLLIN,
+	};
+	xcb_generic_event_t *ev;
+
+	xcb_flush(conn);
+	for (;;) {
+		while ((ev = xcb_poll_for_event(conn))) {
+			if (EVENT_TYPE(ev) == type)
+				return ev;
+			free(ev);
+		}
+
+		if (poll(&pfd, 1, timeout_ms) <= 0)
+			return NULL;
+	}
+}
+
+/* Drains the configures sent so far and returns how many times the size
+ * of the window changed, starting from *width x *height. */
+static int
+count_size_changes(xcb_connection_t *conn, xcb_window_t win,
+		   int *width, int *height)
+{
+	xcb_configure_notify_event_t *cn;
+	int changes = 0;
+
+	x11_sync(conn);
+	while ((cn = (xcb_configure_notify_event_t *)
+		     wait_for_x11_event(conn, XCB_CONFIGURE_NOTIFY, 200))) {
+		if (cn->window == win &&
+		    (cn->width != *width || cn->height != *height)) {
+			*width = cn->width;
+			*height = cn->height;
+			changes++;
+		}
+		free(cn);
+	}
+
+	return changes;
+}
+
+TEST(xwayland_resize_is_throttled)
+{
+	struct client *client;
+	struct window_x11 *window;
+	struct connection_x11 *conn;
+	xcb_connection_t *c;
+	xcb_generic_event_t *ev = NULL;
+	xcb_client_message_event_t msg = {};
+	pixman_color_t bg_color;
+	uint32_t mask;
+	int width = 200, height = 200;
+	int start_width;
+	int changes;
+	int i;
+
+	color_rgb888(&bg_color, 0, 255, 0);
+
+	client = create_client();
+	conn = create_x11_connection();
+	assert(conn);
+	c = conn->connection;
+
+	window = create_x11_window(width, height, 0, 0, conn, bg_color, NULL);
+	assert(window);
+	window_x11_map(window);
+	handle_events_and_check_flags(window, MAPPED);
+
+	mask = XCB_EVENT_MASK_EXPOSURE |
+	       XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+	       XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY |
+	       XCB_EVENT_MASK_PROPERTY_CHANGE |
+	       XCB_EVENT_MASK_ENTER_WINDOW |
+	       XCB_EVENT_MASK_LEAVE_WINDOW |
+	       XCB_EVENT_MASK_BUTTON_PRESS;
+	xcb_change_window_attributes(c, window->win_id,
+				     XCB_CW_EVENT_MASK, &mask);
+
+	/* The test shell maps the window at the origin; wiggle the pointer
+	 * inside it until Xwayland reports it entered. */
+	for (i = 0; !ev && i < 100; i++) {
+		send_motion(client, 100 + i % 2, 100);
+		ev = wait_for_x11_event(c, XCB_ENTER_NOTIFY, 50);
+	}
+	assert(ev);
+	free(ev);
+
+	send_button(client, BTN_LEFT, WL_POINTER_BUTTON_STATE_PRESSED);
+	ev = wait_for_x11_event(c, XCB_BUTTON_PRESS, 5000);
+	assert(ev);
+	free(ev);
+
+	msg.response_type = XCB_CLIENT_MESSAGE;
+	msg.format = 32;
+	msg.window = window->win_id;
+	msg.type = window_get_atoms(window)->net_wm_moveresize;
+	msg.data.data32[0] = 100;
+	msg.data.data32[1] = 100;
+	msg.data.data32[2] = 4; /* _NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT */
+	msg.data.data32[3] = 1;
+	msg.data.data32[4] = 1;
+	xcb_send_event(c, 0, window->root_win_id,
+		       XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY |
+		       XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT,
+		       (const char *) &msg);
+
+	/* The shell's resize grab takes the pointer focus away. */
+	ev = wait_for_x11_event(c, XCB_LEAVE_NOTIFY, 5000);
+	assert(ev);
+	free(ev);
+
+	count_size_changes(c, window->win_id, &width, &height);
+	start_width = width;
+
+	/* Freeze the X server for everyone else, so that neither the window
+	 * manager's configures reach the window nor can Xwayland commit a
+	 * response, then resize by one step per pointer motion. */
+	xcb_grab_server(c);
+	x11_sync(c);
+
+	for (i = 1; i <= RESIZE_MOTIONS; i++)
+		send_motion(client, 100 + 5 * i, 100 + 5 * i);
+	send_button(client, BTN_LEFT, WL_POINTER_BUTTON_STATE_RELEASED);
+
+	/* Give the throttled configure time to go out after a frame. */
+	testlog("waiting for the throttled configure\n");
+	usleep(200000);
+	client_roundtrip(client);
+
+	xcb_ungrab_server(c);
+	changes = count_size_changes(c, window->win_id, &width, &height);
+
+	testlog("%d motions produced %d resizes\n", RESIZE_MOTIONS, changes);
+	assert(changes >= 1);
+	assert(changes < RESIZE_MOTIONS / 2);
+	assert(width > start_width);
+
+	window_x11_unmap(window);
+	handle_events_and_check_flags(window, UNMAPPED);
+
+	destroy_x11_window(window);
+	destroy_x11_connection(conn);
+	client_destroy(client);
+}
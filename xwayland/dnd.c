@@ -98,7 +98,7 @@ data_source_send(struct weston_data_source *base,
 			      wm->atom.wl_selection,
 			      XCB_TIME_CURRENT_TIME);
 
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 
 	fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
 	wm->data_source_fd = fd;
@@ -173,7 +173,7 @@ data_source_send(struct weston_data_source *base,
 				      wm->atom.wl_selection,
 				      XCB_TIME_CURRENT_TIME);
 
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 
 		fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
 		wm->data_source_fd = fd;
@@ -459,7 +459,7 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 		/* Non-incr transfer all done. */
 		weston_wm_flush_source_data(wm);
 		weston_wm_send_selection_notify(wm, wm->selection_request.property);
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 		if (wm->property_source)
 			wl_event_source_remove(wm->property_source);
 		wm->property_source = NULL;
@@ -479,7 +479,7 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 				wm->source_data.size);
 			weston_wm_flush_source_data(wm);
 		}
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 		if (wm->property_source)
 			wl_event_source_remove(wm->property_source);
 		wm->property_source = NULL;
@@ -670,7 +670,7 @@ weston_wm_handle_xfixes_selection_notify(struct weston_wm *wm,
 			      wm->atom.wl_selection,
 			      xfixes_selection_notify->timestamp);
 
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 
 	return 1;
 }
@@ -723,7 +723,7 @@ weston_wm_set_selection(struct wl_listener *listener, void *data)
 				wm->atom.clipboard,
 				XCB_TIME_CURRENT_TIME);
 
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 }
 
 static void
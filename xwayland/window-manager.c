@@ -48,6 +48,7 @@
 #include "shared/cairo-util.h"
 #include "shared/hash.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "shared/xcb-xwayland.h"
 #include "xwayland-shell-v1-server-protocol.h"
 
@@ -148,8 +149,12 @@ struct weston_wm_window {
 	struct weston_surface *surface;
 	struct weston_desktop_xwayland_surface *shsurf;
 	struct wl_listener surface_destroy_listener;
+	struct wl_listener surface_commit_listener;
 	struct wl_event_source *repaint_source;
 	struct wl_event_source *configure_source;
+	struct wl_event_source *configure_throttle_timer;
+	bool configure_in_flight;
+	bool configure_throttled;
 	int properties_dirty;
 	int pid;
 	char *machine;
@@ -206,6 +211,12 @@ weston_wm_set_net_active_window(struct weston_wm *wm, xcb_window_t window);
 static void
 weston_wm_window_schedule_repaint(struct weston_wm_window *window);
 
+static void
+weston_wm_window_configure(void *data);
+
+static void
+weston_wm_window_schedule_configure(struct weston_wm_window *window);
+
 static int
 legacy_fullscreen(struct weston_wm *wm,
 		  struct weston_wm_window *window,
@@ -866,6 +877,68 @@ weston_wm_handle_configure_request(struct weston_wm *wm, xcb_generic_event_t *ev
 	weston_wm_window_configure_frame(window);
 	weston_wm_window_send_configure_notify(window);
 	weston_wm_window_schedule_repaint(window);
+
+	window->configure_in_flight = window->surface != NULL;
+}
+
+static int
+weston_wm_window_configure_throttle_timeout(void *data)
+{
+	struct weston_wm_window *window = data;
+
+	window->configure_in_flight = false;
+	weston_wm_window_schedule_configure(window);
+
+	return 0;
+}
+
+/* While the client has not committed since the last configure, further
+ * resizes are merged into one configure, sent on the next commit or after
+ * one output frame at the latest, so that interactive resizing does not
+ * bury slow clients under ConfigureNotify events. */
+static void
+weston_wm_window_schedule_configure(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_output *output;
+	int msec = 16;
+
+	if (window->configure_source)
+		return;
+
+	if (!window->configure_in_flight) {
+		window->configure_throttled = false;
+		if (window->configure_throttle_timer)
+			wl_event_source_timer_update(window->configure_throttle_timer, 0);
+
+		window->configure_source =
+			wl_event_loop_add_idle(wm->server->loop,
+					       weston_wm_window_configure, window);
+		return;
+	}
+
+	if (window->configure_throttled)
+		return;
+
+	if (!window->configure_throttle_timer) {
+		window->configure_throttle_timer =
+			wl_event_loop_add_timer(wm->server->loop,
+						weston_wm_window_configure_throttle_timeout,
+						window);
+		if (!window->configure_throttle_timer) {
+			window->configure_in_flight = false;
+			weston_wm_window_schedule_configure(window);
+			return;
+		}
+	}
+
+	output = window->surface ? window->surface->output : NULL;
+	if (output && output->current_mode && output->current_mode->refresh > 0)
+		msec = (millihz_to_nsec(output->current_mode->refresh) +
+			999999) / 1000000;
+
+	window->configure_throttled = true;
+	wl_event_source_timer_update(window->configure_throttle_timer, msec);
 }
 
 static int
@@ -1029,7 +1102,7 @@ weston_wm_window_activate(struct wl_listener *listener, void *data)
 		weston_wm_window_schedule_repaint(wm->focus_window);
 	}
 
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 
 }
 
@@ -1065,7 +1138,7 @@ weston_wm_window_set_allow_commits(struct weston_wm_window *window, bool allow)
 			    XCB_ATOM_CARDINAL,
 			    32, /* format */
 			    1, property);
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 }
 
 #define ICCCM_WITHDRAWN_STATE	0
@@ -1352,9 +1425,12 @@ weston_wm_handle_unmap_notify(struct weston_wm *wm, xcb_generic_event_t *event)
 	}
 	if (wm->focus_window == window)
 		wm->focus_window = NULL;
-	if (window->surface)
+	if (window->surface) {
 		wl_list_remove(&window->surface_destroy_listener.link);
+		wl_list_remove(&window->surface_commit_listener.link);
+	}
 	window->surface = NULL;
+	window->configure_in_flight = false;
 	window->shsurf = NULL;
 
 	weston_wm_window_set_wm_state(window, ICCCM_WITHDRAWN_STATE);
@@ -1397,7 +1473,7 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 
 	cairo_destroy(cr);
 	cairo_surface_flush(window->cairo_surface);
-	xcb_flush(window->wm->conn);
+	weston_wm_schedule_flush(window->wm);
 }
 
 static void
@@ -1656,6 +1732,8 @@ weston_wm_window_destroy(struct weston_wm_window *window)
 
 	if (window->configure_source)
 		wl_event_source_remove(window->configure_source);
+	if (window->configure_throttle_timer)
+		wl_event_source_remove(window->configure_throttle_timer);
 	if (window->repaint_source)
 		wl_event_source_remove(window->repaint_source);
 	if (window->cairo_surface)
@@ -1675,8 +1753,10 @@ weston_wm_window_destroy(struct weston_wm_window *window)
 
 	wl_list_remove(&window->link);
 
-	if (window->surface)
+	if (window->surface) {
 		wl_list_remove(&window->surface_destroy_listener.link);
+		wl_list_remove(&window->surface_commit_listener.link);
+	}
 
 	free(window->class);
 	free(window->name);
@@ -1862,9 +1942,6 @@ update_state(int action, int *state)
 	return changed;
 }
 
-static void
-weston_wm_window_configure(void *data);
-
 static void
 weston_wm_window_set_toplevel(struct weston_wm_window *window)
 {
@@ -1972,10 +2049,25 @@ surface_destroy(struct wl_listener *listener, void *data)
 
 	wm_printf(window->wm, "surface for xid %d destroyed\n", window->id);
 
+	wl_list_remove(&window->surface_commit_listener.link);
+
 	/* This should have been freed by the shell.
 	 * Don't try to use it later. */
 	window->shsurf = NULL;
 	window->surface = NULL;
+	window->configure_in_flight = false;
+}
+
+static void
+surface_commit(struct wl_listener *listener, void *data)
+{
+	struct weston_wm_window *window =
+		container_of(listener,
+			     struct weston_wm_window, surface_commit_listener);
+
+	window->configure_in_flight = false;
+	if (window->configure_throttled)
+		weston_wm_window_schedule_configure(window);
 }
 
 static void
@@ -2235,7 +2327,7 @@ weston_wm_window_set_cursor(struct weston_wm *wm, xcb_window_t window_id,
 	cursor_value_list = wm->cursors[cursor];
 	xcb_change_window_attributes (wm->conn, window_id,
 				      XCB_CW_CURSOR, &cursor_value_list);
-	xcb_flush(wm->conn);
+	weston_wm_schedule_flush(wm);
 }
 
 static void
@@ -2456,6 +2548,35 @@ weston_wm_handle_focus_in(struct weston_wm *wm, xcb_generic_event_t *event)
 		weston_wm_send_focus_window(wm, wm->focus_window);
 }
 
+static void
+weston_wm_flush_idle(void *data)
+{
+	struct weston_wm *wm = data;
+
+	wm->flush_idle = NULL;
+	xcb_flush(wm->conn);
+}
+
+/** Flush the X connection once the current event loop dispatch is done
+ *
+ * Handling one event, on either the Wayland or the X side, usually issues
+ * several X requests from different places. Rather than writing each batch
+ * to the socket right away, they all go out together from an idle source,
+ * which runs before the event loop goes back to sleep. Requests waiting
+ * for a reply do not need this, xcb flushes before waiting.
+ */
+void
+weston_wm_schedule_flush(struct weston_wm *wm)
+{
+	if (wm->flush_idle)
+		return;
+
+	wm->flush_idle = wl_event_loop_add_idle(wm->server->loop,
+						weston_wm_flush_idle, wm);
+	if (!wm->flush_idle)
+		xcb_flush(wm->conn);
+}
+
 static int
 weston_wm_handle_event(int fd, uint32_t mask, void *data)
 {
@@ -2533,7 +2654,7 @@ weston_wm_handle_event(int fd, uint32_t mask, void *data)
 	}
 
 	if (count != 0)
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 
 	return count;
 }
@@ -2946,6 +3067,8 @@ weston_wm_destroy(struct weston_wm *wm)
 	hash_table_destroy(wm->window_hash);
 	weston_wm_destroy_cursors(wm);
 	theme_destroy(wm->theme);
+	if (wm->flush_idle)
+		wl_event_source_remove(wm->flush_idle);
 	xcb_disconnect(wm->conn);
 	wl_event_source_remove(wm->source);
 	wl_list_remove(&wm->seat_create_listener.link);
@@ -3011,10 +3134,12 @@ weston_wm_window_configure(void *data)
 				   XCB_CONFIG_WINDOW_WIDTH |
 				   XCB_CONFIG_WINDOW_HEIGHT,
 				   values);
+	window->configure_in_flight = window->surface != NULL;
 
 	weston_wm_window_configure_frame(window);
 	weston_wm_window_send_configure_notify(window);
 	weston_wm_window_schedule_repaint(window);
+	weston_wm_schedule_flush(wm);
 }
 
 static void
@@ -3090,12 +3215,7 @@ send_configure(struct weston_surface *surface, int32_t width, int32_t height)
 		}
 	}
 
-	if (window->configure_source)
-		return;
-
-	window->configure_source =
-		wl_event_loop_add_idle(wm->server->loop,
-				       weston_wm_window_configure, window);
+	weston_wm_window_schedule_configure(window);
 }
 
 static void
@@ -3105,7 +3225,7 @@ send_close(struct weston_surface *surface)
 	if (!window || !window->wm)
 		return;
 	weston_wm_window_close(window, XCB_CURRENT_TIME);
-	xcb_flush(window->wm->conn);
+	weston_wm_schedule_flush(window->wm);
 }
 
 static void
@@ -3132,7 +3252,7 @@ send_position(struct weston_surface *surface, int32_t x, int32_t y)
 
 		weston_wm_configure_window(wm, window->frame_id, mask, values);
 		weston_wm_window_send_configure_notify(window);
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 	}
 }
 
@@ -3239,13 +3359,18 @@ xserver_map_shell_surface(struct weston_wm_window *window,
 	/* A weston_wm_window may have many different surfaces assigned
 	 * throughout its life, so we must make sure to remove the listener
 	 * from the old surface signal list. */
-	if (window->surface)
+	if (window->surface) {
 		wl_list_remove(&window->surface_destroy_listener.link);
+		wl_list_remove(&window->surface_commit_listener.link);
+	}
 
 	window->surface = surface;
 	window->surface_destroy_listener.notify = surface_destroy;
 	wl_signal_add(&window->surface->destroy_signal,
 		      &window->surface_destroy_listener);
+	window->surface_commit_listener.notify = surface_commit;
+	wl_signal_add(&window->surface->commit_signal,
+		      &window->surface_commit_listener);
 
 	if (!xwayland_interface)
 		return;
@@ -3315,7 +3440,7 @@ xserver_map_shell_surface(struct weston_wm_window *window,
 	} else {
 		weston_wm_window_set_pending_state(window);
 		weston_wm_window_set_allow_commits(window, true);
-		xcb_flush(wm->conn);
+		weston_wm_schedule_flush(wm);
 	}
 }
 
@@ -58,6 +58,7 @@ struct weston_wm {
 	xcb_connection_t *conn;
 	const xcb_query_extension_reply_t *xfixes;
 	struct wl_event_source *source;
+	struct wl_event_source *flush_idle;
 	xcb_screen_t *screen;
 	struct hash_table *window_hash;
 	struct weston_xserver *server;
@@ -111,6 +112,9 @@ int
 weston_wm_handle_selection_event(struct weston_wm *wm,
 				 xcb_generic_event_t *event);
 
+void
+weston_wm_schedule_flush(struct weston_wm *wm);
+
 struct weston_wm *
 weston_wm_create(struct weston_xserver *wxs, int fd);
 void